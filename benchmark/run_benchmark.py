@@ -0,0 +1,181 @@
+# -*- coding: utf-8 -*-
+"""Scaling benchmark for the sgdsim simulator.
+
+Runs sgdsim over a grid of (numRacks, rackSize, update size, placement),
+records the wall time, events processed, peak memory and simulated
+iteration time of every configuration, and compares them against a
+stored baseline.
+
+Run from inside an ns-3 tree where scratch/sgdsim is built:
+
+  python3 run_benchmark.py --ns3-dir ~/ns-3.29 --update-baseline
+  python3 run_benchmark.py --ns3-dir ~/ns-3.29
+
+The second invocation exits with status 1 if any configuration got
+slower or bigger than the baseline by more than --tolerance.
+"""
+
+import argparse
+import itertools
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DELAY_DIR = os.path.join(HERE, os.pardir, 'sgddelays')
+DELAY_FILES = ['gradient_delay_data.txt', 'aggregation_delay_data.txt']
+
+GRIDS = {
+  'quick': {
+    'num_racks': [2, 4],
+    'rack_size': [4],
+    'update_size': [97490],
+    'placement': ['colocate', 'stride', 'random'],
+  },
+  'full': {
+    'num_racks': [2, 4, 8, 16],
+    'rack_size': [4, 8, 16],
+    'update_size': [97490, 974900],
+    'placement': ['colocate', 'cluster', 'stride', 'random'],
+  },
+}
+
+# Metrics where a higher value is a performance regression.
+COST_METRICS = ['wall_time', 'events', 'peak_rss_kb']
+# Metrics that only change when the simulated behaviour changes.
+MODEL_METRICS = ['iterations', 'mean_iteration_time']
+
+
+def expand(grid):
+  keys = ['num_racks', 'rack_size', 'update_size', 'placement']
+  for values in itertools.product(*[grid[k] for k in keys]):
+    config = dict(zip(keys, values))
+    # The cluster placement puts one server per host of the first rack.
+    if config['placement'] == 'cluster' and config['num_racks'] != config['rack_size']:
+      continue
+    yield config
+
+
+def config_key(config):
+  return 'racks={num_racks},size={rack_size},update={update_size},placement={placement}'.format(**config)
+
+
+def run_sgdsim(sim_args, binary=None, ns3_dir='.', name='sgdsim', collect=None):
+  """Run sgdsim in a scratch directory and return its JSON summary.
+
+  If collect is given, it is called with the output prefix before the
+  scratch directory is removed, and (summary, collect(prefix)) is returned.
+  """
+  rundir = tempfile.mkdtemp(prefix='sgdrun-')
+  try:
+    for delay_file in DELAY_FILES:
+      shutil.copy(os.path.join(DELAY_DIR, delay_file), rundir)
+
+    prefix = os.path.join(rundir, 'run')
+    sim_args = list(sim_args) + ['--summary=true', '--outputPrefix=%s' % prefix]
+    if binary:
+      command = [binary] + sim_args
+      cwd = rundir
+    else:
+      command = ['./waf', '--run', ' '.join(['sgdsim'] + sim_args), '--cwd=' + rundir]
+      cwd = ns3_dir
+
+    with open(os.devnull, 'w') as devnull:
+      status = subprocess.call(command, cwd=cwd, stdout=devnull, stderr=devnull)
+    if status != 0:
+      raise RuntimeError('%s failed with status %d' % (name, status))
+
+    with open(prefix + '-summary.json') as f:
+      summary = json.load(f)
+    return (summary, collect(prefix)) if collect else summary
+  finally:
+    shutil.rmtree(rundir)
+
+
+def run_one(args, config):
+  sim_args = [
+    '--numRacks=%d' % config['num_racks'],
+    '--rackSize=%d' % config['rack_size'],
+    '--updateSize=%d' % config['update_size'],
+    '--placement=%s' % config['placement'],
+    '--stopTime=%g' % args.stop_time,
+    '--RngRun=%d' % args.run,
+    '--profile=true',
+  ]
+  summary = run_sgdsim(sim_args, args.binary, args.ns3_dir, config_key(config))
+  return dict((metric, summary.get(metric, 0)) for metric in COST_METRICS + MODEL_METRICS)
+
+
+def compare(results, baseline, tolerance):
+  regressions = 0
+  for key in sorted(results):
+    if key not in baseline:
+      print('%s: no baseline' % key)
+      continue
+    new, old = results[key], baseline[key]
+    notes = []
+    for metric in COST_METRICS:
+      if not old.get(metric):
+        continue
+      ratio = float(new[metric]) / old[metric]
+      if ratio > 1 + tolerance:
+        notes.append('%s regressed %.1f%%' % (metric, 100 * (ratio - 1)))
+        regressions += 1
+      elif ratio < 1 - tolerance:
+        notes.append('%s improved %.1f%%' % (metric, 100 * (1 - ratio)))
+    for metric in MODEL_METRICS:
+      if new[metric] != old[metric]:
+        notes.append('%s changed %s -> %s' % (metric, old[metric], new[metric]))
+    print('%s: %s' % (key, '; '.join(notes) if notes else 'ok'))
+  return regressions
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--ns3-dir', default='.', help='top of the ns-3 tree (runs through ./waf)')
+  parser.add_argument('--binary', help='run this sgdsim binary directly instead of through waf')
+  parser.add_argument('--grid', choices=sorted(GRIDS), default='quick')
+  parser.add_argument('--stop-time', type=float, default=10.0, help='simulated seconds per run')
+  parser.add_argument('--run', type=int, default=1, help='ns-3 RngRun of every run')
+  parser.add_argument('--baseline', default=os.path.join(HERE, 'baseline.json'))
+  parser.add_argument('--update-baseline', action='store_true', help='store the results as the new baseline')
+  parser.add_argument('--output', help='also write the results to this file')
+  parser.add_argument('--tolerance', type=float, default=0.15,
+                      help='relative increase of a cost metric reported as a regression')
+  args = parser.parse_args()
+
+  results = {}
+  for config in expand(GRIDS[args.grid]):
+    key = config_key(config)
+    results[key] = run_one(args, config)
+    print('%s: %s' % (key, json.dumps(results[key], sort_keys=True)))
+    sys.stdout.flush()
+
+  document = {'grid': args.grid, 'stop_time': args.stop_time, 'run': args.run, 'results': results}
+  if args.output:
+    with open(args.output, 'w') as f:
+      json.dump(document, f, indent=2, sort_keys=True)
+
+  if args.update_baseline:
+    with open(args.baseline, 'w') as f:
+      json.dump(document, f, indent=2, sort_keys=True)
+    print('baseline written to %s' % args.baseline)
+    return 0
+
+  if not os.path.exists(args.baseline):
+    print('no baseline at %s; run with --update-baseline first' % args.baseline)
+    return 0
+  with open(args.baseline) as f:
+    baseline = json.load(f)
+  if baseline.get('stop_time') != args.stop_time or baseline.get('run') != args.run:
+    print('warning: baseline was recorded with stop time %s and run %s' % (baseline.get('stop_time'), baseline.get('run')))
+  regressions = compare(results, baseline['results'], args.tolerance)
+  print('%d regression(s)' % regressions)
+  return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,178 @@
+# -*- coding: utf-8 -*-
+"""Parameter sweeps of the sgdsim simulator.
+
+Expands a grid of sgdsim flags times a number of seeds, runs the
+instances on a local pool of processes and stores every run's summary in
+a SQLite database.  A sweep is described by a JSON file:
+
+  {
+    "name": "placement",
+    "scenario": "../scenarios/random-8x8.txt",
+    "grid": {"placement": ["colocate", "stride", "random"], "numRacks": [4, 8]},
+    "seeds": 10
+  }
+
+"scenario" (relative to the sweep file) and "name" are optional; "seeds"
+is a count or a list of RngRun values.  Grid values can also be given
+on the command line:
+
+  python3 sweep.py placement.json --ns3-dir ~/ns-3.29
+  python3 sweep.py --name quick --grid placement=stride,random --seeds 3 --binary ./sgdsim
+
+Runs already stored for the same sweep and flags are skipped, so an
+interrupted sweep continues where it stopped.  Each run has one row in
+`runs`, its flags in `params` and its summary in `metrics`, e.g.
+
+  SELECT p.value AS placement, avg(m.value), count(*)
+  FROM runs r
+  JOIN params p ON p.run_id = r.id AND p.name = 'placement'
+  JOIN metrics m ON m.run_id = r.id AND m.name = 'mean_iteration_time'
+  WHERE r.sweep = 'placement' AND r.status = 'ok'
+  GROUP BY placement;
+"""
+
+import argparse
+import itertools
+import json
+import multiprocessing
+import multiprocessing.pool
+import os
+import sqlite3
+import sys
+import time
+
+from run_benchmark import run_sgdsim
+
+SCHEMA = '''
+CREATE TABLE IF NOT EXISTS runs (
+  id INTEGER PRIMARY KEY,
+  sweep TEXT NOT NULL,
+  config TEXT NOT NULL,
+  seed INTEGER NOT NULL,
+  status TEXT NOT NULL,
+  error TEXT,
+  finished REAL,
+  UNIQUE (sweep, config)
+);
+CREATE TABLE IF NOT EXISTS params (run_id INTEGER NOT NULL, name TEXT NOT NULL, value TEXT);
+CREATE TABLE IF NOT EXISTS metrics (run_id INTEGER NOT NULL, name TEXT NOT NULL, value);
+CREATE INDEX IF NOT EXISTS params_by_run ON params (run_id, name);
+CREATE INDEX IF NOT EXISTS metrics_by_run ON metrics (run_id, name);
+'''
+
+
+def parse_value(text):
+  for kind in (int, float):
+    try:
+      return kind(text)
+    except ValueError:
+      pass
+  return text
+
+
+def load_sweep(args):
+  sweep = {'name': 'sweep', 'grid': {}, 'seeds': 1}
+  if args.sweep:
+    with open(args.sweep) as f:
+      sweep.update(json.load(f))
+    if sweep.get('scenario'):
+      sweep['scenario'] = os.path.join(os.path.dirname(os.path.abspath(args.sweep)), sweep['scenario'])
+  if args.name:
+    sweep['name'] = args.name
+  if args.scenario:
+    sweep['scenario'] = os.path.abspath(args.scenario)
+  for item in args.grid:
+    name, _, values = item.partition('=')
+    sweep['grid'][name] = [parse_value(v) for v in values.split(',')]
+  if args.seeds is not None:
+    sweep['seeds'] = args.seeds
+  if isinstance(sweep['seeds'], int):
+    sweep['seeds'] = list(range(1, sweep['seeds'] + 1))
+  return sweep
+
+
+def expand(sweep):
+  names = sorted(sweep['grid'])
+  for values in itertools.product(*[sweep['grid'][n] for n in names]):
+    for seed in sweep['seeds']:
+      params = dict(zip(names, values))
+      if sweep.get('scenario'):
+        params['scenario'] = sweep['scenario']
+      yield params, seed
+
+
+def config_key(params, seed):
+  return json.dumps(dict(params, RngRun=seed), sort_keys=True)
+
+
+def run(job):
+  params, seed, args = job
+  sim_args = ['--%s=%s' % (name, value) for name, value in sorted(params.items())]
+  sim_args.append('--RngRun=%d' % seed)
+  try:
+    return params, seed, run_sgdsim(sim_args, args.binary, args.ns3_dir, config_key(params, seed)), None
+  except Exception as e:
+    return params, seed, None, str(e)
+
+
+def store(db, sweep, params, seed, summary, error):
+  cursor = db.execute(
+    'INSERT OR REPLACE INTO runs (sweep, config, seed, status, error, finished) VALUES (?, ?, ?, ?, ?, ?)',
+    (sweep, config_key(params, seed), seed, 'failed' if error else 'ok', error, time.time()))
+  run_id = cursor.lastrowid
+  db.executemany('INSERT INTO params VALUES (?, ?, ?)',
+                 [(run_id, name, str(value)) for name, value in sorted(params.items())])
+  if summary:
+    db.executemany('INSERT INTO metrics VALUES (?, ?, ?)',
+                   [(run_id, name, value) for name, value in sorted(summary.items())])
+  db.commit()
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0], epilog=__doc__,
+                                   formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('sweep', nargs='?', help='JSON file describing the sweep')
+  parser.add_argument('--name', help='name of the sweep in the database')
+  parser.add_argument('--scenario', help='scenario file passed to every run')
+  parser.add_argument('--grid', action='append', default=[], metavar='FLAG=V1,V2',
+                      help='values of an sgdsim flag to sweep over')
+  parser.add_argument('--seeds', type=int, help='number of seeds (RngRun 1..N) per grid point')
+  parser.add_argument('--db', default='sweeps.sqlite', help='SQLite database of the results')
+  parser.add_argument('--jobs', type=int, default=multiprocessing.cpu_count(), help='runs at the same time')
+  parser.add_argument('--ns3-dir', default='.', help='top of the ns-3 tree (runs through ./waf)')
+  parser.add_argument('--binary', help='run this sgdsim binary directly instead of through waf')
+  parser.add_argument('--rerun-failed', action='store_true', help='run failed runs again')
+  args = parser.parse_args()
+
+  sweep = load_sweep(args)
+  db = sqlite3.connect(args.db)
+  db.executescript(SCHEMA)
+
+  done = set()
+  query = 'SELECT config FROM runs WHERE sweep = ?' + (" AND status = 'ok'" if args.rerun_failed else '')
+  for (config,) in db.execute(query, (sweep['name'],)):
+    done.add(config)
+  for (run_id,) in db.execute("SELECT id FROM runs WHERE sweep = ? AND status = 'failed'", (sweep['name'],)).fetchall():
+    if args.rerun_failed:
+      db.execute('DELETE FROM params WHERE run_id = ?', (run_id,))
+      db.execute('DELETE FROM metrics WHERE run_id = ?', (run_id,))
+
+  jobs = [(params, seed, args) for params, seed in expand(sweep) if config_key(params, seed) not in done]
+  print('%s: %d runs, %d already done' % (sweep['name'], len(jobs) + len(done), len(done)))
+
+  # The work happens in the sgdsim processes, so threads are enough here.
+  pool = multiprocessing.pool.ThreadPool(max(1, args.jobs))
+  failed = 0
+  for i, (params, seed, summary, error) in enumerate(pool.imap_unordered(run, jobs)):
+    store(db, sweep['name'], params, seed, summary, error)
+    failed += 1 if error else 0
+    print('[%d/%d] %s' % (i + 1, len(jobs), error or config_key(params, seed)))
+    sys.stdout.flush()
+  pool.close()
+  pool.join()
+  print('%d run(s) failed' % failed)
+  return 1 if failed else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
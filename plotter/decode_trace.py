@@ -0,0 +1,104 @@
+# -*- coding: utf-8 -*-
+"""Decoder for the binary event traces written by sgdsim --trace=true.
+
+  python3 decode_trace.py sgdsim-events.bin > events.csv
+  python3 decode_trace.py --log sgdsim-events.bin > random_tail.out
+
+The default output is CSV with one row per record.  --log instead prints
+the "Server #N broadcasts parameter update" lines that sgdsim logs when
+tracing is off, so parse_log in plotcdf.py works on either.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = b'SGDTRACE'
+HEADER = struct.Struct('=8sII')
+RECORD = struct.Struct('=qIHHQ')
+
+EVENTS = [
+  None,
+  'server_connect_request',
+  'server_accept',
+  'server_broadcast',
+  'server_parameter_send',
+  'server_parameter_sent',
+  'server_gradient_recv',
+  'server_gradient_received',
+  'server_aggregate',
+  'client_connect_request',
+  'client_connected',
+  'client_parameter_recv',
+  'client_parameter_received',
+  'client_push_start',
+  'client_gradient_send',
+  'client_push_sent',
+]
+
+# Events whose payload packs the iteration and a worker index.
+WORKER_EVENTS = set(['server_parameter_sent', 'server_gradient_received'])
+BYTE_EVENTS = set(['server_parameter_send', 'server_gradient_recv',
+                   'client_parameter_recv', 'client_gradient_send'])
+ITERATION_EVENTS = set(['server_broadcast', 'server_aggregate',
+                        'client_parameter_received', 'client_push_start',
+                        'client_push_sent'])
+
+
+def read_records(fname):
+  with open(fname, 'rb') as f:
+    magic, version, size = HEADER.unpack(f.read(HEADER.size))
+    if magic != MAGIC:
+      raise ValueError('%s is not an sgdsim event trace' % fname)
+    if version != 1 or size != RECORD.size:
+      raise ValueError('unsupported trace version %d, record size %d' % (version, size))
+    while True:
+      block = f.read(RECORD.size * 4096)
+      if not block:
+        break
+      for offset in range(0, len(block) - len(block) % RECORD.size, RECORD.size):
+        yield RECORD.unpack_from(block, offset)
+
+
+def decode(record):
+  time, app, event_type, _, payload = record
+  event = EVENTS[event_type] if event_type < len(EVENTS) else 'unknown_%d' % event_type
+  if app & 0x80000000:
+    server, client = (app >> 16) & 0x7fff, app & 0xffff
+  else:
+    server, client = app, ''
+  iteration, worker, size = '', '', ''
+  if event in WORKER_EVENTS:
+    iteration, worker = payload >> 32, payload & 0xffffffff
+  elif event in BYTE_EVENTS:
+    size = payload
+  elif event in ITERATION_EVENTS:
+    iteration = payload
+  elif event == 'server_accept':
+    worker = payload - 1
+  return [time / 1e9, server, client, event, iteration, worker, size]
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument('trace', help='binary trace file')
+  parser.add_argument('--log', action='store_true',
+                      help='print broadcast log lines instead of CSV')
+  args = parser.parse_args()
+
+  if args.log:
+    for record in read_records(args.trace):
+      time, server, _, event = decode(record)[:4]
+      if event == 'server_broadcast':
+        sys.stdout.write('%g: Server #%d broadcasts parameter update\n' % (time, server))
+    return
+
+  writer = csv.writer(sys.stdout)
+  writer.writerow(['time', 'server', 'client', 'event', 'iteration', 'worker', 'bytes'])
+  for record in read_records(args.trace):
+    writer.writerow(decode(record))
+
+
+if __name__ == '__main__':
+  main()
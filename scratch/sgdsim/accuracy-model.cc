@@ -0,0 +1,229 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "accuracy-model.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("AccuracyModel");
+
+NS_OBJECT_ENSURE_REGISTERED (AccuracyModel);
+
+TypeId
+AccuracyModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AccuracyModel")
+    .SetParent<Object> ()
+    .AddConstructor<AccuracyModel> ()
+    .AddAttribute ("TargetIterations",
+                   "Synchronous iterations of ReferenceBatch samples to the target accuracy",
+                   DoubleValue (10000.0),
+                   MakeDoubleAccessor (&AccuracyModel::m_targetIterations),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("BatchSize",
+                   "Samples a GPU computes in a step",
+                   UintegerValue (32),
+                   MakeUintegerAccessor (&AccuracyModel::m_batchSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ReferenceBatch",
+                   "Samples of a step of the reference iterations",
+                   DoubleValue (256.0),
+                   MakeDoubleAccessor (&AccuracyModel::m_referenceBatch),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("NoiseScale",
+                   "Gradient noise scale in samples, the batch beyond which larger batches "
+                   "stop saving steps",
+                   DoubleValue (1024.0),
+                   MakeDoubleAccessor (&AccuracyModel::m_noiseScale),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("StalenessPenalty",
+                   "Loss of statistical efficiency per local step beyond the first",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&AccuracyModel::m_stalenessPenalty),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("CompressionNoise",
+                   "Growth of the noise scale per unit of gradient compression ratio beyond 1",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&AccuracyModel::m_compressionNoise),
+                   MakeDoubleChecker<double> (0.0))
+  ;
+  return tid;
+}
+
+AccuracyModel::AccuracyModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+AccuracyModel::~AccuracyModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+AccuracyModel::AddPush (uint32_t serverNum, uint32_t steps, uint32_t gpus)
+{
+  Server& server = m_servers[serverNum];
+  server.pushes++;
+  server.pushSteps += steps;
+  server.pushGpus += gpus;
+}
+
+void
+AccuracyModel::AddIteration (uint32_t serverNum, Time broadcast, uint32_t gradients,
+                             uint32_t dropped, double compression)
+{
+  NS_LOG_FUNCTION (this << serverNum << broadcast << gradients << dropped << compression);
+  Server& server = m_servers[serverNum];
+  if (server.iterations == 0)
+    {
+      server.first = broadcast;
+    }
+  server.last = Simulator::Now ();
+  server.iterations++;
+  server.gradients += gradients;
+  server.dropped += dropped;
+
+  // Pushes of workers that were dropped only count towards the means.
+  double steps = server.pushes > 0 ? (double) server.pushSteps / server.pushes : 1.0;
+  double gpus = server.pushes > 0 ? (double) server.pushGpus / server.pushes : 1.0;
+  double batch = gradients * gpus * m_batchSize;
+  server.batch += batch;
+  server.steps += steps;
+  server.pushes = 0;
+  server.pushSteps = 0;
+  server.pushGpus = 0;
+
+  if (gradients > 0)
+    {
+      server.progress += GetProgress (batch, steps, compression);
+    }
+  if (server.reached == Seconds (0) && server.progress >= m_targetIterations)
+    {
+      server.reached = Simulator::Now ();
+    }
+}
+
+double
+AccuracyModel::GetProgress (double batch, double steps, double compression) const
+{
+  double noise = m_noiseScale * (1.0 + m_compressionNoise * std::max (compression - 1.0, 0.0));
+  double perStep = (1.0 + m_noiseScale / m_referenceBatch) / (1.0 + noise / batch);
+  return steps * perStep / (1.0 + m_stalenessPenalty * (steps - 1.0));
+}
+
+double
+AccuracyModel::GetIterationRate (const Server& server) const
+{
+  double elapsed = (server.last - server.first).GetSeconds ();
+  return elapsed > 0 ? server.iterations / elapsed : 0.0;
+}
+
+double
+AccuracyModel::GetTimeToAccuracy (const Server& server) const
+{
+  if (server.reached > Seconds (0))
+    {
+      return (server.reached - server.first).GetSeconds ();
+    }
+  double elapsed = (server.last - server.first).GetSeconds ();
+  if (server.progress <= 0 || elapsed <= 0)
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+  return elapsed * m_targetIterations / server.progress;
+}
+
+void
+AccuracyModel::Report (std::string prefix) const
+{
+  std::string filename = prefix + "-accuracy.csv";
+  std::ofstream output (filename.c_str ());
+  output << "server,iterations,iterations_per_second,mean_batch,mean_local_steps,gradients,dropped,"
+         << "progress,progress_per_iteration,time_to_accuracy,reached" << std::endl;
+  for (std::map<uint32_t, Server>::const_iterator it = m_servers.begin (); it != m_servers.end (); ++it)
+    {
+      const Server& server = it->second;
+      uint32_t iterations = std::max<uint32_t> (server.iterations, 1);
+      output << it->first << "," << server.iterations << "," << GetIterationRate (server) << ","
+             << server.batch / iterations << "," << server.steps / iterations << ","
+             << server.gradients << "," << server.dropped << "," << server.progress << ","
+             << server.progress / iterations << "," << GetTimeToAccuracy (server) << ","
+             << (server.reached > Seconds (0) ? 1 : 0) << std::endl;
+    }
+
+  std::cout << "Time to accuracy: " << GetIterationRate () << " iterations/s at "
+            << GetProgressPerIteration () << " reference iterations each, "
+            << GetTimeToAccuracy () << "s to " << m_targetIterations << " reference iterations ("
+            << GetReachedCount () << " of " << m_servers.size () << " servers reached, the others extrapolated)"
+            << std::endl;
+}
+
+double
+AccuracyModel::GetIterationRate (void) const
+{
+  double sum = 0.0;
+  for (std::map<uint32_t, Server>::const_iterator it = m_servers.begin (); it != m_servers.end (); ++it)
+    {
+      sum += GetIterationRate (it->second);
+    }
+  return m_servers.empty () ? 0.0 : sum / m_servers.size ();
+}
+
+double
+AccuracyModel::GetTimeToAccuracy (void) const
+{
+  double sum = 0.0;
+  for (std::map<uint32_t, Server>::const_iterator it = m_servers.begin (); it != m_servers.end (); ++it)
+    {
+      sum += GetTimeToAccuracy (it->second);
+    }
+  return m_servers.empty () ? 0.0 : sum / m_servers.size ();
+}
+
+double
+AccuracyModel::GetProgressPerIteration (void) const
+{
+  double progress = 0.0;
+  uint64_t iterations = 0;
+  for (std::map<uint32_t, Server>::const_iterator it = m_servers.begin (); it != m_servers.end (); ++it)
+    {
+      progress += it->second.progress;
+      iterations += it->second.iterations;
+    }
+  return iterations > 0 ? progress / iterations : 0.0;
+}
+
+uint32_t
+AccuracyModel::GetReachedCount (void) const
+{
+  uint32_t reached = 0;
+  for (std::map<uint32_t, Server>::const_iterator it = m_servers.begin (); it != m_servers.end (); ++it)
+    {
+      reached += it->second.reached > Seconds (0) ? 1 : 0;
+    }
+  return reached;
+}
+
+} // namespace ns3
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ACCURACY_MODEL_H
+#define ACCURACY_MODEL_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief Estimates the time to a target accuracy from the statistical
+ *        efficiency of every iteration.
+ *
+ * Faster iterations are no win if each of them does less for the model.
+ * Every ParameterServer reports its aggregated iterations, with the
+ * gradients in them, the gradients dropped with workers presumed failed
+ * or gone, and the compression of the pushes (ParameterUpdateSize over
+ * GradientUpdateSize).  Every ParameterClient reports the local steps
+ * and the GPUs behind its pushes.  From them the model computes the
+ * progress of an iteration in reference iterations, synchronous steps
+ * of ReferenceBatch samples, and the time at which a server's progress
+ * reaches TargetIterations.  Each server trains its own model.
+ *
+ * The progress follows the gradient noise scale model of McCandlish et
+ * al.: a step of batch B does (1 + NoiseScale / ReferenceBatch) /
+ * (1 + noise / B) as much as a reference step, where the noise is
+ * NoiseScale grown by CompressionNoise per unit of compression ratio
+ * beyond 1, as unbiased sparsification adds variance.  Dropped gradients
+ * shrink B.  The H local steps of local SGD count as H steps, discounted
+ * by 1 + StalenessPenalty * (H - 1) for the drift of the local models.
+ * Subclasses plug in another model by overriding GetProgress.
+ */
+class AccuracyModel : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  AccuracyModel ();
+  virtual ~AccuracyModel ();
+
+  /**
+   * A worker pushes a gradient update.
+   *
+   * \param serverNum the server it pushes to
+   * \param steps local steps behind the update
+   * \param gpus GPUs of the worker, each computing BatchSize samples a step
+   */
+  void AddPush (uint32_t serverNum, uint32_t steps, uint32_t gpus);
+
+  /**
+   * A server aggregated an iteration.
+   *
+   * \param serverNum the server
+   * \param broadcast start of the iteration
+   * \param gradients gradient updates aggregated
+   * \param dropped workers of the barrier removed before their update
+   * \param compression parameter update size over gradient update size
+   */
+  void AddIteration (uint32_t serverNum, Time broadcast, uint32_t gradients,
+                     uint32_t dropped, double compression);
+
+  /**
+   * \param batch samples of a step over all aggregated workers
+   * \param steps local steps of an iteration
+   * \param compression parameter update size over gradient update size
+   * \return the progress of an iteration, in reference iterations
+   */
+  virtual double GetProgress (double batch, double steps, double compression) const;
+
+  /**
+   * Print and write "<prefix>-accuracy.csv", one line per server.
+   */
+  void Report (std::string prefix) const;
+
+  /**
+   * \return the mean over the servers of the iterations per second
+   */
+  double GetIterationRate (void) const;
+
+  /**
+   * \return the mean over the servers of the time from their first
+   *         broadcast to the target, extrapolated from the progress rate
+   *         for those that did not reach it
+   */
+  double GetTimeToAccuracy (void) const;
+
+  /**
+   * \return the mean progress of an iteration, in reference iterations
+   */
+  double GetProgressPerIteration (void) const;
+
+  /**
+   * \return the number of servers that reached the target
+   */
+  uint32_t GetReachedCount (void) const;
+
+private:
+  struct Server
+  {
+    Time first;         //!< Start of the first iteration
+    Time last;          //!< End of the last iteration
+    Time reached;       //!< When the target was reached, zero if not yet
+    uint32_t iterations;
+    double progress;    //!< Reference iterations so far
+    uint64_t gradients; //!< Gradient updates aggregated
+    uint64_t dropped;   //!< Gradient updates dropped
+    double batch;       //!< Sum of the batches of the iterations
+    double steps;       //!< Sum of the local steps of the iterations
+    uint32_t pushes;    //!< Pushes of the current iteration
+    uint64_t pushSteps; //!< Local steps of these pushes
+    uint64_t pushGpus;  //!< GPUs of these pushes
+  };
+
+  /// \return the iterations per second of a server
+  double GetIterationRate (const Server& server) const;
+
+  /// \return the estimated time to the target of a server, in seconds
+  double GetTimeToAccuracy (const Server& server) const;
+
+  double m_targetIterations;
+  uint32_t m_batchSize;
+  double m_referenceBatch;
+  double m_noiseScale;
+  double m_stalenessPenalty;
+  double m_compressionNoise;
+
+  std::map<uint32_t, Server> m_servers;
+};
+
+} // namespace ns3
+
+#endif /* ACCURACY_MODEL_H */
@@ -0,0 +1,236 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/config.h"
+#include "ns3/string.h"
+#include "branch-runner.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BranchRunner");
+
+static std::string
+Trim (std::string s)
+{
+  size_t begin = s.find_first_not_of (" \t\n");
+  size_t end = s.find_last_not_of (" \t\n");
+  return begin == std::string::npos ? "" : s.substr (begin, end - begin + 1);
+}
+
+BranchRunner::BranchRunner (std::string spec, uint32_t jobs)
+  : m_jobs (jobs > 0 ? jobs : 1),
+    m_resultFd (-1)
+{
+  std::istringstream branches (spec);
+  std::string text;
+  while (std::getline (branches, text, ';'))
+    {
+      text = Trim (text);
+      if (text.empty ())
+        {
+          continue;
+        }
+      size_t colon = text.find (':');
+      Branch branch;
+      branch.name = Trim (text.substr (0, colon));
+      if (branch.name.empty ())
+        {
+          NS_FATAL_ERROR ("Branch without a name: " << text);
+        }
+
+      std::istringstream settings (colon == std::string::npos ? "" : text.substr (colon + 1));
+      std::string setting;
+      while (std::getline (settings, setting, ','))
+        {
+          setting = Trim (setting);
+          if (setting.empty ())
+            {
+              continue;
+            }
+          size_t equals = setting.rfind ('=');
+          if (equals == std::string::npos)
+            {
+              NS_FATAL_ERROR ("Setting without a value in branch " << branch.name << ": " << setting);
+            }
+          std::string path = Trim (setting.substr (0, equals));
+          if (path[0] != '/')
+            {
+              size_t separator = path.find ("::");
+              if (separator == std::string::npos)
+                {
+                  NS_FATAL_ERROR ("Expected Type::Attribute or a Config path: " << path);
+                }
+              std::string type = path.substr (0, separator);
+              std::string list = type.size () > 7 && type.compare (type.size () - 7, 7, "Channel") == 0
+                ? "/ChannelList/*/$ns3::" : "/NodeList/*/ApplicationList/*/$ns3::";
+              path = list + type + "/" + path.substr (separator + 2);
+            }
+          branch.settings.push_back (std::make_pair (path, Trim (setting.substr (equals + 1))));
+        }
+      m_branches.push_back (branch);
+    }
+  m_results.resize (m_branches.size ());
+}
+
+int
+BranchRunner::Fork ()
+{
+  for (size_t i = 0; i != m_branches.size (); i++)
+    {
+      while (m_children.size () >= m_jobs)
+        {
+          Reap ();
+        }
+
+      int fds[2];
+      if (pipe (fds) != 0)
+        {
+          NS_FATAL_ERROR ("Failed to create a pipe for branch " << m_branches[i].name);
+        }
+      // Buffered output would otherwise be written once by every child.
+      std::fflush (0);
+      std::cout.flush ();
+      std::cerr.flush ();
+
+      pid_t pid = fork ();
+      if (pid < 0)
+        {
+          NS_FATAL_ERROR ("Failed to fork branch " << m_branches[i].name);
+        }
+      if (pid == 0)
+        {
+          close (fds[0]);
+          for (size_t j = 0; j != m_children.size (); j++)
+            {
+              close (m_children[j].fd);
+            }
+          m_children.clear ();
+          m_resultFd = fds[1];
+          return i;
+        }
+
+      close (fds[1]);
+      Child child;
+      child.pid = pid;
+      child.fd = fds[0];
+      child.branch = i;
+      m_children.push_back (child);
+    }
+
+  while (!m_children.empty ())
+    {
+      Reap ();
+    }
+  return -1;
+}
+
+void
+BranchRunner::Reap ()
+{
+  int status;
+  pid_t pid = wait (&status);
+  if (pid < 0)
+    {
+      NS_FATAL_ERROR ("Lost track of the branch processes");
+    }
+
+  for (size_t i = 0; i != m_children.size (); i++)
+    {
+      if (m_children[i].pid != pid)
+        {
+          continue;
+        }
+      // Results are a single short line, so the child never blocks on a
+      // full pipe and everything can be read after it exited.
+      std::string result;
+      char buffer[4096];
+      ssize_t n;
+      while ((n = read (m_children[i].fd, buffer, sizeof (buffer))) > 0)
+        {
+          result.append (buffer, n);
+        }
+      close (m_children[i].fd);
+
+      const std::string& name = m_branches[m_children[i].branch].name;
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+          std::cerr << "Branch " << name << " failed" << std::endl;
+        }
+      else
+        {
+          m_results[m_children[i].branch] = result;
+        }
+      m_children.erase (m_children.begin () + i);
+      return;
+    }
+}
+
+void
+BranchRunner::Apply (int branch) const
+{
+  const Branch& b = m_branches[branch];
+  for (size_t i = 0; i != b.settings.size (); i++)
+    {
+      NS_LOG_INFO ("Branch " << b.name << ": " << b.settings[i].first << " = " << b.settings[i].second);
+      Config::Set (b.settings[i].first, StringValue (b.settings[i].second));
+    }
+}
+
+std::string
+BranchRunner::GetName (int branch) const
+{
+  return m_branches[branch].name;
+}
+
+void
+BranchRunner::SendResult (std::string result)
+{
+  NS_ASSERT (m_resultFd >= 0);
+  const char *data = result.c_str ();
+  size_t left = result.size ();
+  while (left > 0)
+    {
+      ssize_t n = write (m_resultFd, data, left);
+      if (n <= 0)
+        {
+          break;
+        }
+      data += n;
+      left -= n;
+    }
+  close (m_resultFd);
+  m_resultFd = -1;
+}
+
+const std::vector<std::string>&
+BranchRunner::GetResults () const
+{
+  return m_results;
+}
+
+uint32_t
+BranchRunner::GetN () const
+{
+  return m_branches.size ();
+}
+
+} // namespace ns3
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BRANCH_RUNNER_H
+#define BRANCH_RUNNER_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+namespace ns3 {
+
+/**
+ * \brief Runs several variations of a simulation from one warmed-up state.
+ *
+ * After the shared part of the simulation ran, Fork () starts one child
+ * process per branch with fork (), so every child continues from a
+ * copy-on-write copy of the same simulator state, topology and
+ * connections.  A child applies its branch's attribute settings with
+ * Config::Set, runs to the end and hands a line of results back to the
+ * parent through a pipe.  Since the random number generators are copied
+ * as well, all branches see the same random draws until their settings
+ * make them diverge.
+ *
+ * A branch is written as "name:setting,setting,..." and branches are
+ * separated by ';'.  A setting is "path=value", where path is either a
+ * Config path or "Type::Attribute", which sets the attribute of every
+ * application (or, for a type ending in Channel, every channel) of that
+ * type, e.g.
+ *
+ *   slow:ParameterClient::ComputeTimeMean=0.3;
+ *   fault:/ChannelList/3/$ns3::CsmaChannel/DataRate=1Mbps
+ */
+class BranchRunner
+{
+public:
+  /**
+   * \param spec the branches
+   * \param jobs number of branches run at the same time
+   */
+  BranchRunner (std::string spec, uint32_t jobs);
+
+  /**
+   * Fork a child for every branch and collect their results.
+   *
+   * \return the branch to run in a child; -1 in the parent, once all
+   *         children have exited
+   */
+  int Fork ();
+
+  /**
+   * Apply the settings of a branch.
+   */
+  void Apply (int branch) const;
+
+  std::string GetName (int branch) const;
+
+  /**
+   * Send the results of the branch run by this child to the parent.
+   */
+  void SendResult (std::string result);
+
+  /**
+   * \return the results sent by every branch, empty for a branch that
+   *         failed
+   */
+  const std::vector<std::string>& GetResults () const;
+
+  /**
+   * \return the number of branches
+   */
+  uint32_t GetN () const;
+
+private:
+  struct Branch
+  {
+    std::string name;
+    std::vector<std::pair<std::string, std::string> > settings;
+  };
+
+  struct Child
+  {
+    pid_t pid;
+    int fd;
+    int branch;
+  };
+
+  /// Wait for any child, collect its result and forget it.
+  void Reap ();
+
+  std::vector<Branch> m_branches;
+  uint32_t m_jobs;
+  std::vector<Child> m_children;
+  std::vector<std::string> m_results;
+  int m_resultFd;
+};
+
+} // namespace ns3
+
+#endif /* BRANCH_RUNNER_H */
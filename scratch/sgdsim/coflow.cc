@@ -0,0 +1,337 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "coflow.h"
+#include <algorithm>
+#include <iterator>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Coflow");
+
+NS_OBJECT_ENSURE_REGISTERED (CoflowTag);
+NS_OBJECT_ENSURE_REGISTERED (CoflowScheduler);
+NS_OBJECT_ENSURE_REGISTERED (CoflowQueue);
+
+TypeId
+CoflowTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CoflowTag")
+    .SetParent<Tag> ()
+    .AddConstructor<CoflowTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+CoflowTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+CoflowTag::GetSerializedSize (void) const
+{
+  return 5;
+}
+
+void
+CoflowTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_coflow);
+  i.WriteU8 (m_priority);
+}
+
+void
+CoflowTag::Deserialize (TagBuffer i)
+{
+  m_coflow = i.ReadU32 ();
+  m_priority = i.ReadU8 ();
+}
+
+void
+CoflowTag::Print (std::ostream &os) const
+{
+  os << "coflow=" << m_coflow << " priority=" << (uint32_t) m_priority;
+}
+
+CoflowTag::CoflowTag ()
+  : m_coflow (0),
+    m_priority (0)
+{
+}
+
+void
+CoflowTag::SetCoflow (uint32_t coflow)
+{
+  m_coflow = coflow;
+}
+
+uint32_t
+CoflowTag::GetCoflow (void) const
+{
+  return m_coflow;
+}
+
+void
+CoflowTag::SetPriority (uint8_t priority)
+{
+  m_priority = priority;
+}
+
+uint8_t
+CoflowTag::GetPriority (void) const
+{
+  return m_priority;
+}
+
+TypeId
+CoflowScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CoflowScheduler")
+    .SetParent<Object> ()
+    .AddConstructor<CoflowScheduler> ()
+    .AddAttribute ("Policy",
+                   "sebf (smallest effective bottleneck first) or las (least attained service)",
+                   StringValue ("sebf"),
+                   MakeStringAccessor (&CoflowScheduler::m_policy),
+                   MakeStringChecker ())
+    .AddAttribute ("Queues",
+                   "Number of priority queues of the switches",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&CoflowScheduler::m_queues),
+                   MakeUintegerChecker<uint32_t> (1, 256))
+    .AddAttribute ("FirstThreshold",
+                   "Bytes a coflow sends before it leaves the highest priority queue with the las policy",
+                   UintegerValue (100000),
+                   MakeUintegerAccessor (&CoflowScheduler::m_firstThreshold),
+                   MakeUintegerChecker<uint64_t> (1))
+    .AddAttribute ("Multiplier",
+                   "Ratio of two consecutive queue thresholds with the las policy",
+                   DoubleValue (10.0),
+                   MakeDoubleAccessor (&CoflowScheduler::m_multiplier),
+                   MakeDoubleChecker<double> (1.0))
+  ;
+  return tid;
+}
+
+CoflowScheduler::CoflowScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CoflowScheduler::~CoflowScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+CoflowScheduler::GetCoflow (uint32_t serverNum, bool push)
+{
+  return 2 * serverNum + (push ? 1 : 0);
+}
+
+void
+CoflowScheduler::Start (uint32_t coflow, uint64_t bytes)
+{
+  NS_LOG_FUNCTION (this << coflow << bytes);
+  Coflow& c = m_coflows[coflow];
+  c.left = bytes;
+  c.attained = 0;
+}
+
+void
+CoflowScheduler::Tag (Ptr<Packet> packet, uint32_t coflow)
+{
+  CoflowTag tag;
+  tag.SetCoflow (coflow);
+  tag.SetPriority (GetPriority (coflow));
+  packet->AddByteTag (tag);
+
+  std::map<uint32_t, Coflow>::iterator it = m_coflows.find (coflow);
+  if (it != m_coflows.end ())
+    {
+      it->second.left -= std::min<uint64_t> (it->second.left, packet->GetSize ());
+      it->second.attained += packet->GetSize ();
+    }
+}
+
+uint8_t
+CoflowScheduler::GetPriority (uint32_t coflow) const
+{
+  std::map<uint32_t, Coflow>::const_iterator it = m_coflows.find (coflow);
+  if (it == m_coflows.end ())
+    {
+      return 0;
+    }
+
+  uint32_t priority = 0;
+  if (m_policy == "las")
+    {
+      double threshold = m_firstThreshold;
+      while (priority + 1 < m_queues && it->second.attained >= threshold)
+        {
+          priority++;
+          threshold *= m_multiplier;
+        }
+    }
+  else
+    {
+      // Rank among the unfinished coflows by bytes left.
+      for (std::map<uint32_t, Coflow>::const_iterator other = m_coflows.begin (); other != m_coflows.end (); ++other)
+        {
+          if (other->second.left > 0 && (other->second.left < it->second.left
+                                         || (other->second.left == it->second.left && other->first < coflow)))
+            {
+              priority++;
+            }
+        }
+      priority = std::min (priority, m_queues - 1);
+    }
+  return priority;
+}
+
+TypeId
+CoflowQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CoflowQueue")
+    .SetParent<Queue<Packet> > ()
+    .AddConstructor<CoflowQueue> ()
+    .AddAttribute ("MaxSize",
+                   "The max queue size",
+                   QueueSizeValue (QueueSize ("100p")),
+                   MakeQueueSizeAccessor (&QueueBase::SetMaxSize,
+                                          &QueueBase::GetMaxSize),
+                   MakeQueueSizeChecker ())
+  ;
+  return tid;
+}
+
+CoflowQueue::CoflowQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CoflowQueue::~CoflowQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint8_t
+CoflowQueue::GetPriority (Ptr<const Packet> packet)
+{
+  CoflowTag tag;
+  return packet->FindFirstMatchingByteTag (tag) ? tag.GetPriority () : 0;
+}
+
+Queue<Packet>::ConstIterator
+CoflowQueue::GetPosition (uint8_t priority) const
+{
+  uint32_t before = 0;
+  for (uint32_t i = 0; i <= priority && i < m_priorityPackets.size (); i++)
+    {
+      before += m_priorityPackets[i];
+    }
+  ConstIterator position = Head ();
+  std::advance (position, before);
+  return position;
+}
+
+bool
+CoflowQueue::Enqueue (Ptr<Packet> item)
+{
+  NS_LOG_FUNCTION (this << item);
+  uint8_t priority = GetPriority (item);
+  if (m_priorityPackets.size () <= priority)
+    {
+      m_priorityPackets.resize (priority + 1, 0);
+    }
+
+  // Push out the last packet of the lowest priority queued.  DoRemove
+  // drops it, which fires the DropAfterDequeue trace source; the device
+  // only reports packets the queue refuses as MacTxDrop.
+  if (GetCurrentSize () + item > GetMaxSize ())
+    {
+      uint32_t lowest = m_priorityPackets.size () - 1;
+      while (lowest > priority && m_priorityPackets[lowest] == 0)
+        {
+          lowest--;
+        }
+      if (lowest > priority)
+        {
+          ConstIterator last = Tail ();
+          DoRemove (--last);
+          m_priorityPackets[lowest]--;
+        }
+    }
+
+  if (!DoEnqueue (GetPosition (priority), item))
+    {
+      return false;
+    }
+  m_priorityPackets[priority]++;
+  return true;
+}
+
+void
+CoflowQueue::Removed (void)
+{
+  for (size_t i = 0; i != m_priorityPackets.size (); i++)
+    {
+      if (m_priorityPackets[i] > 0)
+        {
+          m_priorityPackets[i]--;
+          return;
+        }
+    }
+}
+
+Ptr<Packet>
+CoflowQueue::Dequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<Packet> item = DoDequeue (Head ());
+  if (item != 0)
+    {
+      Removed ();
+    }
+  return item;
+}
+
+Ptr<Packet>
+CoflowQueue::Remove (void)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<Packet> item = DoRemove (Head ());
+  if (item != 0)
+    {
+      Removed ();
+    }
+  return item;
+}
+
+Ptr<const Packet>
+CoflowQueue::Peek (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return DoPeek (Head ());
+}
+
+} // namespace ns3
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef COFLOW_H
+#define COFLOW_H
+
+#include "ns3/object.h"
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Byte tag with the coflow and the priority of application bytes.
+ *
+ * Byte tags stay with the bytes through TCP segmentation, so every
+ * segment carries the priority its bytes were written with.
+ */
+class CoflowTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  CoflowTag ();
+
+  void SetCoflow (uint32_t coflow);
+  uint32_t GetCoflow (void) const;
+  void SetPriority (uint8_t priority);
+
+  /**
+   * \return the priority, 0 being the highest
+   */
+  uint8_t GetPriority (void) const;
+
+private:
+  uint32_t m_coflow;
+  uint8_t m_priority;
+};
+
+/**
+ * \brief Coordinator of coflow priorities, as in Varys and Aalo.
+ *
+ * A coflow is one phase of an iteration of a parameter server: the
+ * broadcast of the parameters to its workers, or the pushes of their
+ * gradients, which all have to finish before the server can go on.  The
+ * server starts both coflows of an iteration with their total size when
+ * it broadcasts, and the applications report every write.
+ *
+ * With the sebf policy (smallest effective bottleneck first, Varys), the
+ * coflow with the fewest bytes left gets the highest priority, then the
+ * next one, and so on.  All bytes of a coflow cross its server's link,
+ * and all links have the same rate, so the bytes left stand for the
+ * bottleneck's completion time.  With the las policy (least attained
+ * service, Aalo), a coflow starts in the highest priority queue and
+ * moves down a queue whenever the bytes it sent exceed the next of the
+ * thresholds FirstThreshold, FirstThreshold * Multiplier, ..., which
+ * needs no knowledge of the coflow sizes.
+ */
+class CoflowScheduler : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  CoflowScheduler ();
+  virtual ~CoflowScheduler ();
+
+  /**
+   * \return the coflow of the parameter broadcast (push false) or of the
+   *         gradient pushes (push true) of a server
+   */
+  static uint32_t GetCoflow (uint32_t serverNum, bool push);
+
+  /**
+   * Start a new instance of a coflow.
+   *
+   * \param coflow the coflow
+   * \param bytes its total size
+   */
+  void Start (uint32_t coflow, uint64_t bytes);
+
+  /**
+   * Tag the bytes of a packet with the coflow's current priority and
+   * account for them as sent.
+   */
+  void Tag (Ptr<Packet> packet, uint32_t coflow);
+
+  /**
+   * \return the current priority of a coflow, 0 being the highest
+   */
+  uint8_t GetPriority (uint32_t coflow) const;
+
+private:
+  struct Coflow
+  {
+    uint64_t left;     //!< Bytes not sent yet
+    uint64_t attained; //!< Bytes sent so far
+  };
+
+  std::string m_policy; //!< sebf or las
+  uint32_t m_queues;
+  uint64_t m_firstThreshold;
+  double m_multiplier;
+
+  std::map<uint32_t, Coflow> m_coflows;
+};
+
+/**
+ * \brief Strict priority device queue on the CoflowTag of the packets.
+ *
+ * Packets are served in priority order, and in arrival order within a
+ * priority.  Packets without a tag, e.g. TCP acknowledgements, get the
+ * highest priority.  When the queue is full, an arriving packet pushes
+ * out the last packet of a lower priority, if any, and is dropped
+ * otherwise.
+ */
+class CoflowQueue : public Queue<Packet>
+{
+public:
+  static TypeId GetTypeId (void);
+
+  CoflowQueue ();
+  virtual ~CoflowQueue ();
+
+  virtual bool Enqueue (Ptr<Packet> item);
+  virtual Ptr<Packet> Dequeue (void);
+  virtual Ptr<Packet> Remove (void);
+  virtual Ptr<const Packet> Peek (void) const;
+
+private:
+  static uint8_t GetPriority (Ptr<const Packet> packet);
+
+  /// \return the iterator to the first packet of a lower priority
+  ConstIterator GetPosition (uint8_t priority) const;
+
+  /// Count a packet removed from the head.
+  void Removed (void);
+
+  std::vector<uint32_t> m_priorityPackets; //!< Packets queued per priority
+};
+
+} // namespace ns3
+
+#endif /* COFLOW_H */
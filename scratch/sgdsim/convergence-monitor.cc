@@ -0,0 +1,250 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/callback.h"
+#include "convergence-monitor.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ConvergenceMonitor");
+
+const uint32_t ConvergenceMonitor::NUM_BATCHES;
+const uint32_t ConvergenceMonitor::CHECK_INTERVAL;
+
+/**
+ * \return x such that a standard normal variable is below x with
+ *         probability p
+ */
+static double
+NormalQuantile (double p)
+{
+  double low = -10.0;
+  double high = 10.0;
+  for (int i = 0; i != 100; i++)
+    {
+      double mid = (low + high) / 2.0;
+      if (0.5 * std::erfc (-mid / std::sqrt (2.0)) < p)
+        {
+          low = mid;
+        }
+      else
+        {
+          high = mid;
+        }
+    }
+  return (low + high) / 2.0;
+}
+
+/**
+ * \return the Cornish-Fisher approximation of the p quantile of
+ *         Student's t distribution with df degrees of freedom
+ */
+static double
+StudentQuantile (double p, double df)
+{
+  double z = NormalQuantile (p);
+  double z3 = z * z * z;
+  double z5 = z3 * z * z;
+  return z + (z3 + z) / (4.0 * df) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df);
+}
+
+ConvergenceMonitor::ConvergenceMonitor (std::string prefix, uint32_t warmup, double precision,
+                                        double confidence, uint32_t minSamples)
+  : m_prefix (prefix),
+    m_warmup (warmup),
+    m_precision (precision),
+    m_confidence (confidence),
+    m_minSamples (std::max (minSamples, NUM_BATCHES)),
+    m_dropped (0),
+    m_converged (false),
+    m_mean (0.0),
+    m_meanHalfWidth (std::numeric_limits<double>::infinity ()),
+    m_p99 (0.0),
+    m_p99HalfWidth (std::numeric_limits<double>::infinity ())
+{
+}
+
+void
+ConvergenceMonitor::Connect ()
+{
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Broadcast",
+                                 MakeCallback (&ConvergenceMonitor::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::GossipWorker/Iteration",
+                                 MakeCallback (&ConvergenceMonitor::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PipelineStage/Iteration",
+                                 MakeCallback (&ConvergenceMonitor::Broadcast, this));
+}
+
+void
+ConvergenceMonitor::Restart (std::string prefix)
+{
+  m_prefix = prefix;
+  m_samples.clear ();
+  m_converged = false;
+}
+
+void
+ConvergenceMonitor::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  Time now = Simulator::Now ();
+  std::map<uint32_t, Time>::iterator it = m_lastBroadcast.find (serverNum);
+  if (it == m_lastBroadcast.end ())
+    {
+      m_lastBroadcast[serverNum] = now;
+      return;
+    }
+  Time previous = it->second;
+  it->second = now;
+  if (iteration <= m_warmup)
+    {
+      m_dropped++;
+      return;
+    }
+
+  m_samples.push_back ((now - previous).GetSeconds ());
+  if (m_converged || m_samples.size () < m_minSamples || m_samples.size () % CHECK_INTERVAL != 0)
+    {
+      return;
+    }
+
+  Update ();
+  if (m_meanHalfWidth <= m_precision * m_mean && m_p99HalfWidth <= m_precision * m_p99)
+    {
+      NS_LOG_INFO (now.GetSeconds () << ": iteration time converged after " << m_samples.size () << " iterations");
+      m_converged = true;
+      m_convergedAt = now;
+      Simulator::Stop ();
+    }
+}
+
+void
+ConvergenceMonitor::Update ()
+{
+  size_t n = m_samples.size ();
+  m_meanHalfWidth = std::numeric_limits<double>::infinity ();
+  m_p99HalfWidth = std::numeric_limits<double>::infinity ();
+  if (n == 0)
+    {
+      return;
+    }
+
+  double sum = 0.0;
+  for (size_t i = 0; i != n; i++)
+    {
+      sum += m_samples[i];
+    }
+  m_mean = sum / n;
+
+  size_t batchSize = n / NUM_BATCHES;
+  if (batchSize > 0)
+    {
+      std::vector<double> batches (NUM_BATCHES, 0.0);
+      for (size_t i = 0; i != NUM_BATCHES * batchSize; i++)
+        {
+          batches[i / batchSize] += m_samples[i] / batchSize;
+        }
+      double batchMean = 0.0;
+      for (size_t b = 0; b != NUM_BATCHES; b++)
+        {
+          batchMean += batches[b] / NUM_BATCHES;
+        }
+      double variance = 0.0;
+      for (size_t b = 0; b != NUM_BATCHES; b++)
+        {
+          variance += (batches[b] - batchMean) * (batches[b] - batchMean) / (NUM_BATCHES - 1);
+        }
+      double t = StudentQuantile ((1.0 + m_confidence) / 2.0, NUM_BATCHES - 1);
+      m_meanHalfWidth = t * std::sqrt (variance / NUM_BATCHES);
+    }
+
+  // Distribution-free interval: the ranks around n * 0.99 that bracket the
+  // p99 with the requested confidence.
+  std::vector<double> sorted (m_samples);
+  std::sort (sorted.begin (), sorted.end ());
+  double rank = 0.99 * n;
+  double spread = NormalQuantile ((1.0 + m_confidence) / 2.0) * std::sqrt (n * 0.99 * 0.01);
+  m_p99 = sorted[std::min (n - 1, (size_t) std::ceil (rank) - 1)];
+  double lowRank = std::floor (rank - spread);
+  double highRank = std::ceil (rank + spread);
+  if (lowRank >= 1.0 && highRank <= n)
+    {
+      m_p99HalfWidth = std::max (sorted[(size_t) highRank - 1] - m_p99, m_p99 - sorted[(size_t) lowRank - 1]);
+    }
+}
+
+void
+ConvergenceMonitor::Report ()
+{
+  Update ();
+
+  std::string filename = m_prefix + "-convergence.txt";
+  std::ofstream output (filename.c_str ());
+  std::ostringstream os;
+  os << (m_converged ? "Converged" : "Did not converge")
+     << " at " << (m_converged ? m_convergedAt : Simulator::Now ()).GetSeconds () << "s after "
+     << m_samples.size () << " steady-state iterations (" << m_dropped << " warmup iterations dropped)" << std::endl;
+  os << "mean iteration time " << m_mean << "s +- " << m_meanHalfWidth << "s, p99 "
+     << m_p99 << "s +- " << m_p99HalfWidth << "s at " << 100.0 * m_confidence << "% confidence" << std::endl;
+  output << os.str ();
+  std::cout << os.str ();
+}
+
+bool
+ConvergenceMonitor::IsConverged () const
+{
+  return m_converged;
+}
+
+uint32_t
+ConvergenceMonitor::GetSampleCount () const
+{
+  return m_samples.size ();
+}
+
+double
+ConvergenceMonitor::GetMean () const
+{
+  return m_mean;
+}
+
+double
+ConvergenceMonitor::GetMeanHalfWidth () const
+{
+  return m_meanHalfWidth;
+}
+
+double
+ConvergenceMonitor::GetP99 () const
+{
+  return m_p99;
+}
+
+double
+ConvergenceMonitor::GetP99HalfWidth () const
+{
+  return m_p99HalfWidth;
+}
+
+} // namespace ns3
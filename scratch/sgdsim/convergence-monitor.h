@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CONVERGENCE_MONITOR_H
+#define CONVERGENCE_MONITOR_H
+
+#include "ns3/nstime.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Stops the simulation once the iteration time is known precisely
+ *        enough.
+ *
+ * Iteration times are taken from the Broadcast trace source of every
+ * ParameterServer.  The first warmup iterations of each server, which
+ * include connection setup and TCP slow start, are dropped.  After every
+ * CheckInterval steady-state iterations the monitor computes confidence
+ * intervals on the mean (by batch means, since consecutive iterations are
+ * correlated) and on the p99 (from order statistics).  Once the half-width
+ * of both is within the target precision relative to the estimate, it
+ * calls Simulator::Stop (); the run's stop time stays the upper bound.
+ */
+class ConvergenceMonitor
+{
+public:
+  /**
+   * \param prefix prefix of the output file
+   * \param warmup iterations dropped at the start of every server
+   * \param precision target half-width of the confidence intervals,
+   *                  relative to the estimate
+   * \param confidence confidence level of the intervals
+   * \param minSamples steady-state iterations needed before stopping
+   */
+  ConvergenceMonitor (std::string prefix, uint32_t warmup, double precision,
+                      double confidence, uint32_t minSamples);
+
+  /**
+   * Connect to the Broadcast trace source of all installed
+   * ParameterServer applications, and to the Iteration trace source of
+   * all GossipWorker and PipelineStage applications, each of which
+   * counts as a server.
+   */
+  void Connect ();
+
+  /**
+   * Discard the steady-state samples so far, e.g. because the scenario
+   * changed, and write the report under a new prefix.
+   */
+  void Restart (std::string prefix);
+
+  /**
+   * Print and write "<prefix>-convergence.txt".
+   */
+  void Report ();
+
+  bool IsConverged () const;
+  uint32_t GetSampleCount () const;
+  double GetMean () const;
+  double GetMeanHalfWidth () const;
+  double GetP99 () const;
+  double GetP99HalfWidth () const;
+
+private:
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+
+  /// Recompute the estimates and intervals from the samples.
+  void Update ();
+
+  static const uint32_t NUM_BATCHES = 20;
+  static const uint32_t CHECK_INTERVAL = 10;
+
+  std::string m_prefix;
+  uint32_t m_warmup;
+  double m_precision;
+  double m_confidence;
+  uint32_t m_minSamples;
+
+  std::map<uint32_t, Time> m_lastBroadcast;
+  std::vector<double> m_samples;
+  uint64_t m_dropped;
+
+  bool m_converged;
+  Time m_convergedAt;
+  double m_mean;
+  double m_meanHalfWidth;
+  double m_p99;
+  double m_p99HalfWidth;
+};
+
+} // namespace ns3
+
+#endif /* CONVERGENCE_MONITOR_H */
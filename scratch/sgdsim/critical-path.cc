@@ -0,0 +1,297 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/callback.h"
+#include "ns3/inet-socket-address.h"
+#include "critical-path.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CriticalPathAnalyzer");
+
+CriticalPathAnalyzer::CriticalPathAnalyzer (std::string prefix)
+  : m_prefix (prefix)
+{
+  for (int p = 0; p != NUM_PHASES; p++)
+    {
+      m_phaseTime[p] = 0.0;
+    }
+}
+
+const char*
+CriticalPathAnalyzer::PhaseName (Phase phase)
+{
+  switch (phase)
+    {
+    case PULL:
+      return "pull";
+    case COMPUTE:
+      return "compute";
+    case PUSH:
+      return "push";
+    case AGGREGATE:
+      return "aggregate";
+    default:
+      return "unknown";
+    }
+}
+
+void
+CriticalPathAnalyzer::SetWorkerRack (uint32_t serverNum, uint32_t clientNum, int rack)
+{
+  m_racks[WorkerKey (serverNum, clientNum)] = rack;
+}
+
+void
+CriticalPathAnalyzer::Connect ()
+{
+  std::string filename = m_prefix + "-critical-path.csv";
+  m_output.open (filename.c_str ());
+  if (!m_output.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  m_output << "server,iteration,start,duration,worker,rack,pull,compute,push,aggregate,gating_phase,excess" << std::endl;
+
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterClient/Connected",
+                                 MakeCallback (&CriticalPathAnalyzer::Connected, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterClient/ParameterReceived",
+                                 MakeCallback (&CriticalPathAnalyzer::ParameterReceived, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterClient/PushStart",
+                                 MakeCallback (&CriticalPathAnalyzer::PushStart, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Broadcast",
+                                 MakeCallback (&CriticalPathAnalyzer::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/GradientReceived",
+                                 MakeCallback (&CriticalPathAnalyzer::GradientReceived, this));
+}
+
+CriticalPathAnalyzer::AddressKey
+CriticalPathAnalyzer::MakeAddressKey (uint32_t serverNum, const Address& address)
+{
+  InetSocketAddress inet = InetSocketAddress::ConvertFrom (address);
+  return AddressKey (serverNum, std::make_pair (inet.GetIpv4 ().Get (), inet.GetPort ()));
+}
+
+void
+CriticalPathAnalyzer::Connected (uint32_t serverNum, uint32_t clientNum, const Address& local)
+{
+  m_clientNums[MakeAddressKey (serverNum, local)] = clientNum;
+}
+
+void
+CriticalPathAnalyzer::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  ServerState& state = m_servers[serverNum];
+  Time now = Simulator::Now ();
+  if (state.started)
+    {
+      FinishIteration (serverNum, state, now);
+    }
+  state.started = true;
+  state.iteration = iteration;
+  state.broadcast = now;
+  state.workers.clear ();
+}
+
+void
+CriticalPathAnalyzer::ParameterReceived (uint32_t serverNum, uint32_t clientNum, uint32_t iteration)
+{
+  WorkerTimes& worker = m_servers[serverNum].workers[clientNum];
+  worker.received = Simulator::Now ();
+  worker.pushed = false;
+}
+
+void
+CriticalPathAnalyzer::PushStart (uint32_t serverNum, uint32_t clientNum, uint32_t iteration)
+{
+  m_servers[serverNum].workers[clientNum].pushStart = Simulator::Now ();
+}
+
+void
+CriticalPathAnalyzer::GradientReceived (uint32_t serverNum, uint32_t iteration, const Address& worker)
+{
+  std::map<AddressKey, uint32_t>::const_iterator it = m_clientNums.find (MakeAddressKey (serverNum, worker));
+  if (it == m_clientNums.end ())
+    {
+      NS_LOG_WARN ("Gradient from unknown worker " << worker << " at Server #" << serverNum);
+      return;
+    }
+
+  ServerState& state = m_servers[serverNum];
+  WorkerTimes& times = state.workers[it->second];
+  times.gradientReceived = Simulator::Now ();
+  times.pushed = true;
+  state.lastGradient = times.gradientReceived;
+}
+
+static double
+Median (std::vector<double> values)
+{
+  if (values.empty ())
+    {
+      return 0.0;
+    }
+  size_t middle = values.size () / 2;
+  std::nth_element (values.begin (), values.begin () + middle, values.end ());
+  return values[middle];
+}
+
+void
+CriticalPathAnalyzer::FinishIteration (uint32_t serverNum, ServerState& state, Time end)
+{
+  std::vector<double> phases[3];
+  uint32_t gating = 0;
+  Time latest;
+  bool found = false;
+  for (std::map<uint32_t, WorkerTimes>::const_iterator it = state.workers.begin (); it != state.workers.end (); ++it)
+    {
+      const WorkerTimes& times = it->second;
+      if (!times.pushed)
+        {
+          continue;
+        }
+      phases[PULL].push_back ((times.received - state.broadcast).GetSeconds ());
+      phases[COMPUTE].push_back ((times.pushStart - times.received).GetSeconds ());
+      phases[PUSH].push_back ((times.gradientReceived - times.pushStart).GetSeconds ());
+      if (!found || times.gradientReceived > latest)
+        {
+          found = true;
+          latest = times.gradientReceived;
+          gating = it->first;
+        }
+    }
+  if (!found)
+    {
+      return;
+    }
+
+  const WorkerTimes& critical = state.workers[gating];
+  double durations[NUM_PHASES];
+  durations[PULL] = (critical.received - state.broadcast).GetSeconds ();
+  durations[COMPUTE] = (critical.pushStart - critical.received).GetSeconds ();
+  durations[PUSH] = (critical.gradientReceived - critical.pushStart).GetSeconds ();
+  durations[AGGREGATE] = (end - critical.gradientReceived).GetSeconds ();
+
+  Phase gatingPhase = PULL;
+  double excess = durations[PULL] - Median (phases[PULL]);
+  for (int p = COMPUTE; p != AGGREGATE; p++)
+    {
+      double e = durations[p] - Median (phases[p]);
+      if (e > excess)
+        {
+          excess = e;
+          gatingPhase = (Phase) p;
+        }
+    }
+
+  for (int p = 0; p != NUM_PHASES; p++)
+    {
+      m_phaseTime[p] += durations[p];
+    }
+
+  WorkerKey key (serverNum, gating);
+  std::map<WorkerKey, WorkerSummary>::iterator summary = m_summary.find (key);
+  if (summary == m_summary.end ())
+    {
+      WorkerSummary empty = { 0, { 0, 0, 0, 0 } };
+      summary = m_summary.insert (std::make_pair (key, empty)).first;
+    }
+  summary->second.gated++;
+  summary->second.phases[gatingPhase]++;
+  m_iterations[serverNum]++;
+
+  std::map<WorkerKey, int>::const_iterator rack = m_racks.find (key);
+  m_output << serverNum << "," << state.iteration << ","
+           << state.broadcast.GetSeconds () << "," << (end - state.broadcast).GetSeconds () << ","
+           << gating << "," << (rack != m_racks.end () ? rack->second : -1) << ","
+           << durations[PULL] << "," << durations[COMPUTE] << ","
+           << durations[PUSH] << "," << durations[AGGREGATE] << ","
+           << PhaseName (gatingPhase) << "," << excess << "\n";
+}
+
+static bool
+CompareGated (const std::pair<uint32_t, std::pair<uint32_t, uint32_t> >& a,
+              const std::pair<uint32_t, std::pair<uint32_t, uint32_t> >& b)
+{
+  return a.first > b.first;
+}
+
+void
+CriticalPathAnalyzer::Report ()
+{
+  m_output.close ();
+
+  std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t> > > ranking;
+  for (std::map<WorkerKey, WorkerSummary>::const_iterator it = m_summary.begin (); it != m_summary.end (); ++it)
+    {
+      ranking.push_back (std::make_pair (it->second.gated, it->first));
+    }
+  std::sort (ranking.begin (), ranking.end (), CompareGated);
+
+  std::ostringstream os;
+  os << "Critical path attribution:" << std::endl;
+  for (size_t r = 0; r != ranking.size (); r++)
+    {
+      WorkerKey key = ranking[r].second;
+      const WorkerSummary& summary = m_summary[key];
+      double total = m_iterations[key.first];
+
+      os << "  server " << key.first << ": worker " << key.second;
+      std::map<WorkerKey, int>::const_iterator rack = m_racks.find (key);
+      if (rack != m_racks.end ())
+        {
+          os << " in rack " << rack->second;
+        }
+      os << " gated " << 100.0 * summary.gated / total << "% of iterations (";
+      for (int p = 0; p != AGGREGATE; p++)
+        {
+          if (p != 0)
+            {
+              os << ", ";
+            }
+          os << 100.0 * summary.phases[p] / summary.gated << "% in " << PhaseName ((Phase) p);
+        }
+      os << ")" << std::endl;
+    }
+
+  double total = 0.0;
+  for (int p = 0; p != NUM_PHASES; p++)
+    {
+      total += m_phaseTime[p];
+    }
+  if (total > 0)
+    {
+      os << "  critical path time:";
+      for (int p = 0; p != NUM_PHASES; p++)
+        {
+          os << " " << PhaseName ((Phase) p) << " " << 100.0 * m_phaseTime[p] / total << "%";
+        }
+      os << std::endl;
+    }
+
+  std::string filename = m_prefix + "-critical-path.txt";
+  std::ofstream summary (filename.c_str ());
+  summary << os.str ();
+  std::cout << os.str ();
+}
+
+} // namespace ns3
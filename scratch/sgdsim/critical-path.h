@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CRITICAL_PATH_H
+#define CRITICAL_PATH_H
+
+#include "ns3/nstime.h"
+#include "ns3/address.h"
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Attributes the duration of every parameter server iteration to
+ *        the worker and phase that gated it.
+ *
+ * An iteration of server s starts with its broadcast and ends with the
+ * next one.  For every worker the analyzer records when the parameters
+ * arrived, when the gradient push started and when the server had the
+ * full gradient, which splits the worker's path into pull, compute and
+ * push.  The worker whose gradient arrived last is on the critical path;
+ * its gating phase is the one that exceeds the median of the other
+ * workers by the largest amount.  The remaining time until the next
+ * broadcast is the server's aggregation.
+ *
+ * One line per iteration is written to "<prefix>-critical-path.csv" when
+ * the iteration completes, so memory does not grow with the run length.
+ */
+class CriticalPathAnalyzer
+{
+public:
+  enum Phase
+  {
+    PULL,
+    COMPUTE,
+    PUSH,
+    AGGREGATE,
+    NUM_PHASES
+  };
+
+  /**
+   * \param prefix prefix of the output files
+   */
+  CriticalPathAnalyzer (std::string prefix);
+
+  /**
+   * Record the rack of a worker so the summary can name it.
+   *
+   * \param serverNum the server the worker pushes to
+   * \param clientNum the number of the worker
+   * \param rack the rack hosting the worker
+   */
+  void SetWorkerRack (uint32_t serverNum, uint32_t clientNum, int rack);
+
+  /**
+   * Connect to the trace sources of all installed ParameterServer and
+   * ParameterClient applications.
+   */
+  void Connect ();
+
+  /**
+   * Print and write the per-worker gating summary.
+   */
+  void Report ();
+
+  static const char* PhaseName (Phase phase);
+
+private:
+  struct WorkerTimes
+  {
+    Time received;
+    Time pushStart;
+    Time gradientReceived;
+    bool pushed;
+  };
+
+  struct ServerState
+  {
+    uint32_t iteration;
+    bool started;
+    Time broadcast;
+    Time lastGradient;
+    std::map<uint32_t, WorkerTimes> workers;
+  };
+
+  struct WorkerSummary
+  {
+    uint32_t gated;
+    uint32_t phases[NUM_PHASES];
+  };
+
+  typedef std::pair<uint32_t, uint32_t> WorkerKey;
+  typedef std::pair<uint32_t, std::pair<uint32_t, uint16_t> > AddressKey;
+
+  static AddressKey MakeAddressKey (uint32_t serverNum, const Address& address);
+
+  void Connected (uint32_t serverNum, uint32_t clientNum, const Address& local);
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+  void ParameterReceived (uint32_t serverNum, uint32_t clientNum, uint32_t iteration);
+  void PushStart (uint32_t serverNum, uint32_t clientNum, uint32_t iteration);
+  void GradientReceived (uint32_t serverNum, uint32_t iteration, const Address& worker);
+
+  void FinishIteration (uint32_t serverNum, ServerState& state, Time end);
+
+  std::string m_prefix;
+  std::ofstream m_output;
+
+  std::map<AddressKey, uint32_t> m_clientNums;
+  std::map<WorkerKey, int> m_racks;
+  std::map<uint32_t, ServerState> m_servers;
+  std::map<WorkerKey, WorkerSummary> m_summary;
+  std::map<uint32_t, uint32_t> m_iterations;
+  double m_phaseTime[NUM_PHASES];
+};
+
+} // namespace ns3
+
+#endif /* CRITICAL_PATH_H */
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "delay-trace.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DelayTrace");
+
+DelayTrace::DelayTrace ()
+  : m_delays (0),
+    m_warmup (0),
+    m_block (0),
+    m_played (0),
+    m_next (0)
+{
+}
+
+void
+DelayTrace::Load (std::string filename, uint32_t warmup)
+{
+  static std::map<std::string, std::vector<double> > traces;
+
+  std::map<std::string, std::vector<double> >::iterator it = traces.find (filename);
+  if (it == traces.end ())
+    {
+      std::ifstream input (filename.c_str ());
+      if (!input.is_open ())
+        {
+          NS_FATAL_ERROR ("Failed to open delay trace " << filename);
+        }
+      std::vector<double> delays;
+      double delay;
+      while (input >> delay)
+        {
+          delays.push_back (delay);
+        }
+      if (!input.eof ())
+        {
+          NS_FATAL_ERROR ("Delay trace " << filename << " has a malformed line after " << delays.size () << " delays");
+        }
+      it = traces.insert (std::make_pair (filename, delays)).first;
+    }
+  if (it->second.size () <= warmup)
+    {
+      NS_FATAL_ERROR ("Delay trace " << filename << " has no delays after its " << warmup << " warmup delays");
+    }
+  m_delays = &it->second;
+  m_warmup = warmup;
+}
+
+void
+DelayTrace::Start (double offset, uint32_t block, Ptr<UniformRandomVariable> position)
+{
+  NS_ASSERT (IsLoaded ());
+  NS_ASSERT (block == 0 || position != 0);
+  uint32_t steady = m_delays->size () - m_warmup;
+  m_next = std::min<uint32_t> (std::floor ((offset - std::floor (offset)) * steady), steady - 1);
+  m_block = block;
+  m_position = position;
+  m_played = 0;
+}
+
+double
+DelayTrace::Next (void)
+{
+  NS_ASSERT (IsLoaded ());
+  if (m_played < m_warmup)
+    {
+      return (*m_delays)[m_played++];
+    }
+
+  uint32_t steady = m_delays->size () - m_warmup;
+  // A new block starts anywhere in the steady part.
+  if (m_block > 0 && m_played > m_warmup && (m_played - m_warmup) % m_block == 0)
+    {
+      m_next = m_position->GetInteger (0, steady - 1);
+    }
+  double delay = (*m_delays)[m_warmup + m_next];
+  m_next = (m_next + 1) % steady;
+  m_played++;
+  return delay;
+}
+
+bool
+DelayTrace::IsLoaded (void) const
+{
+  return m_delays != 0;
+}
+
+double
+DelayTrace::GetOffset (uint32_t k)
+{
+  double offset = k * 0.6180339887498949;
+  return offset - std::floor (offset);
+}
+
+} // namespace ns3
@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DELAY_TRACE_H
+#define DELAY_TRACE_H
+
+#include "ns3/ptr.h"
+#include "ns3/random-variable-stream.h"
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Replays a recorded per-iteration time series of delays in order.
+ *
+ * The file holds one delay in seconds per iteration, e.g.
+ * sgddelays/gradient_delay_data.txt.  Its first warmup delays are played
+ * once at the start, then the steady part from an offset on, wrapping
+ * around at its end.  Playing in order keeps the autocorrelation of the
+ * recording, so a worker that was slow for a while stays slow for a
+ * while.  Giving every replay its own offset keeps the workers from
+ * being slow in lockstep.
+ *
+ * With a block length, the steady part is resampled by a circular block
+ * bootstrap instead: after every block of that many delays the replay
+ * jumps to a uniformly drawn position.  This yields new series that keep
+ * the correlation within a block.
+ */
+class DelayTrace
+{
+public:
+  DelayTrace ();
+
+  /**
+   * Read a trace, failing if it cannot be read.  Every file is read
+   * once and shared by all replays.
+   *
+   * \param filename the file
+   * \param warmup number of leading delays played once
+   */
+  void Load (std::string filename, uint32_t warmup);
+
+  /**
+   * \param offset start of the steady part, as a fraction of its length
+   * \param block bootstrap block length, 0 to replay in order
+   * \param position random variable drawing the block starts, needed
+   *                 with a block length
+   */
+  void Start (double offset, uint32_t block, Ptr<UniformRandomVariable> position);
+
+  /**
+   * \return the next delay, in seconds
+   */
+  double Next (void);
+
+  bool IsLoaded (void) const;
+
+  /**
+   * Multiples of the golden ratio spread any number of replays evenly
+   * over a trace, so replays started later need not know how many there
+   * will be.
+   *
+   * \param k number of the replay
+   * \return offset of the k-th replay, for Start
+   */
+  static double GetOffset (uint32_t k);
+
+private:
+  const std::vector<double>* m_delays;
+  uint32_t m_warmup;
+  uint32_t m_block;
+  Ptr<UniformRandomVariable> m_position;
+  uint64_t m_played; //!< Delays played so far
+  uint32_t m_next; //!< Index of the next steady delay
+};
+
+} // namespace ns3
+
+#endif /* DELAY_TRACE_H */
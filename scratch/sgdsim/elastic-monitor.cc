@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/callback.h"
+#include "elastic-monitor.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ElasticMonitor");
+
+ElasticMonitor::ElasticMonitor (std::string prefix, Time window)
+  : m_prefix (prefix),
+    m_window (window)
+{
+}
+
+void
+ElasticMonitor::Connect ()
+{
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/GradientReceived",
+                                 MakeCallback (&ElasticMonitor::GradientReceived, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Broadcast",
+                                 MakeCallback (&ElasticMonitor::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Membership",
+                                 MakeCallback (&ElasticMonitor::Membership, this));
+}
+
+void
+ElasticMonitor::AddEvent (std::string change, const std::set<uint32_t>& servers)
+{
+  NS_LOG_FUNCTION (this << change);
+  Event event;
+  event.at = Simulator::Now ();
+  event.change = change;
+  for (std::set<uint32_t>::const_iterator it = servers.begin (); it != servers.end (); ++it)
+    {
+      event.broadcasts[*it] = -1;
+    }
+  event.membersBefore = GetTotalMembers ();
+  event.membersAfter = event.membersBefore;
+  event.recovered = Seconds (0);
+  m_events.push_back (event);
+}
+
+void
+ElasticMonitor::GradientReceived (uint32_t serverNum, uint32_t iteration, const Address& worker)
+{
+  m_gradients.push_back (Simulator::Now ());
+}
+
+void
+ElasticMonitor::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  for (size_t i = 0; i != m_events.size (); i++)
+    {
+      Event& event = m_events[i];
+      std::map<uint32_t, int>::iterator server = event.broadcasts.find (serverNum);
+      if (event.recovered > Seconds (0) || server == event.broadcasts.end () || server->second < 0)
+        {
+          continue;
+        }
+      server->second++;
+
+      bool recovered = true;
+      for (server = event.broadcasts.begin (); server != event.broadcasts.end (); ++server)
+        {
+          recovered = recovered && server->second >= 2;
+        }
+      if (recovered)
+        {
+          event.recovered = Simulator::Now ();
+          event.membersAfter = GetTotalMembers ();
+        }
+    }
+}
+
+void
+ElasticMonitor::Membership (uint32_t serverNum, uint32_t members)
+{
+  m_members[serverNum] = members;
+  for (size_t i = 0; i != m_events.size (); i++)
+    {
+      std::map<uint32_t, int>::iterator server = m_events[i].broadcasts.find (serverNum);
+      if (server != m_events[i].broadcasts.end () && server->second < 0)
+        {
+          server->second = 0;
+        }
+    }
+}
+
+uint32_t
+ElasticMonitor::GetTotalMembers () const
+{
+  uint32_t total = 0;
+  for (std::map<uint32_t, uint32_t>::const_iterator it = m_members.begin (); it != m_members.end (); ++it)
+    {
+      total += it->second;
+    }
+  return total;
+}
+
+double
+ElasticMonitor::GetThroughput (Time start, Time end) const
+{
+  end = std::min (end, Simulator::Now ());
+  if (end <= start)
+    {
+      return 0.0;
+    }
+  std::vector<Time>::const_iterator first = std::lower_bound (m_gradients.begin (), m_gradients.end (), start);
+  std::vector<Time>::const_iterator last = std::lower_bound (m_gradients.begin (), m_gradients.end (), end);
+  return (last - first) / (end - start).GetSeconds ();
+}
+
+void
+ElasticMonitor::Report ()
+{
+  std::string filename = m_prefix + "-rescale.csv";
+  std::ofstream output (filename.c_str ());
+  output << "time,change,servers,members_before,members_after,throughput_before,throughput_during,"
+         << "throughput_after,recovery_time" << std::endl;
+  for (size_t i = 0; i != m_events.size (); i++)
+    {
+      const Event& event = m_events[i];
+      bool recovered = event.recovered > Seconds (0);
+      Time end = recovered ? event.recovered : Simulator::Now ();
+      double before = GetThroughput (std::max (event.at - m_window, Seconds (0)), event.at);
+      double during = GetThroughput (event.at, end);
+      double after = recovered ? GetThroughput (end, end + m_window) : 0.0;
+
+      output << event.at.GetSeconds () << "," << event.change << "," << event.broadcasts.size () << ","
+             << event.membersBefore << "," << event.membersAfter << "," << before << "," << during << ",";
+      if (recovered)
+        {
+          output << after << "," << (end - event.at).GetSeconds ();
+        }
+      else
+        {
+          output << ",";
+        }
+      output << std::endl;
+
+      std::cout << "Rescale " << event.change << " at " << event.at.GetSeconds () << "s: "
+                << before << " gradient updates/s before, " << during << " until ";
+      if (recovered)
+        {
+          std::cout << "recovery after " << (end - event.at).GetSeconds () << "s, " << after << " after";
+        }
+      else
+        {
+          std::cout << "the end without recovering";
+        }
+      std::cout << std::endl;
+    }
+}
+
+uint32_t
+ElasticMonitor::GetEventCount () const
+{
+  return m_events.size ();
+}
+
+double
+ElasticMonitor::GetMeanRecoveryTime () const
+{
+  double sum = 0.0;
+  uint32_t count = 0;
+  for (size_t i = 0; i != m_events.size (); i++)
+    {
+      if (m_events[i].recovered > Seconds (0))
+        {
+          sum += (m_events[i].recovered - m_events[i].at).GetSeconds ();
+          count++;
+        }
+    }
+  return count > 0 ? sum / count : 0.0;
+}
+
+double
+ElasticMonitor::GetMeanThroughputDip () const
+{
+  double sum = 0.0;
+  uint32_t count = 0;
+  for (size_t i = 0; i != m_events.size (); i++)
+    {
+      const Event& event = m_events[i];
+      double before = GetThroughput (std::max (event.at - m_window, Seconds (0)), event.at);
+      if (before <= 0)
+        {
+          continue;
+        }
+      Time end = event.recovered > Seconds (0) ? event.recovered : Simulator::Now ();
+      sum += 1.0 - GetThroughput (event.at, end) / before;
+      count++;
+    }
+  return count > 0 ? sum / count : 0.0;
+}
+
+} // namespace ns3
@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ELASTIC_MONITOR_H
+#define ELASTIC_MONITOR_H
+
+#include "ns3/nstime.h"
+#include "ns3/address.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Measures what every rescale event of an elastic run costs.
+ *
+ * Gradient updates are counted from the GradientReceived trace source
+ * of every ParameterServer, as a measure of training throughput.  A
+ * server affected by an event has recovered once the membership change
+ * reached it (the worker connected, closed its connection or timed
+ * out) and the first iteration on the new membership completed, i.e.
+ * at its second broadcast after the change.  For every event the
+ * monitor reports the throughput in the window before it, until all
+ * affected servers recovered, and in the window after that.
+ */
+class ElasticMonitor
+{
+public:
+  /**
+   * \param prefix prefix of the output file
+   * \param window length of the throughput windows before and after
+   *               an event
+   */
+  ElasticMonitor (std::string prefix, Time window);
+
+  /**
+   * Connect to the GradientReceived, Broadcast and Membership trace
+   * sources of all installed ParameterServer applications.
+   */
+  void Connect ();
+
+  /**
+   * Record a rescale event that starts now.
+   *
+   * \param change description of the event, e.g. +2
+   * \param servers the servers whose membership it changes
+   */
+  void AddEvent (std::string change, const std::set<uint32_t>& servers);
+
+  /**
+   * Print a line per event and write "<prefix>-rescale.csv".
+   */
+  void Report ();
+
+  uint32_t GetEventCount () const;
+
+  /**
+   * \return mean time from an event to the recovery of all its
+   *         servers, over the events that recovered
+   */
+  double GetMeanRecoveryTime () const;
+
+  /**
+   * \return mean relative drop of the throughput until recovery,
+   *         compared to the window before the event
+   */
+  double GetMeanThroughputDip () const;
+
+private:
+  struct Event
+  {
+    Time at;
+    std::string change;
+    std::map<uint32_t, int> broadcasts; //!< Per server: broadcasts since the change reached it, -1 before
+    uint32_t membersBefore;
+    uint32_t membersAfter;
+    Time recovered; //!< Zero until all servers recovered
+  };
+
+  void GradientReceived (uint32_t serverNum, uint32_t iteration, const Address& worker);
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+  void Membership (uint32_t serverNum, uint32_t members);
+
+  uint32_t GetTotalMembers () const;
+
+  /// Gradient updates per second in [start, end), clipped to now.
+  double GetThroughput (Time start, Time end) const;
+
+  std::string m_prefix;
+  Time m_window;
+  std::vector<Time> m_gradients; //!< Times of all gradient updates, in order
+  std::map<uint32_t, uint32_t> m_members;
+  std::vector<Event> m_events;
+};
+
+} // namespace ns3
+
+#endif /* ELASTIC_MONITOR_H */
@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "event-trace.h"
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EventTrace");
+
+EventTrace *EventTrace::s_trace = 0;
+
+static const uint32_t TRACE_VERSION = 1;
+
+void
+EventTrace::Enable (std::string filename, uint32_t capacity, bool overwrite)
+{
+  NS_ASSERT_MSG (s_trace == 0, "Event trace already enabled");
+  NS_ASSERT (capacity > 0);
+
+  std::FILE *file = std::fopen (filename.c_str (), "wb");
+  if (file == 0)
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+
+  char magic[8];
+  std::memcpy (magic, "SGDTRACE", 8);
+  uint32_t header[2] = { TRACE_VERSION, sizeof (EventRecord) };
+  std::fwrite (magic, 1, sizeof (magic), file);
+  std::fwrite (header, sizeof (uint32_t), 2, file);
+
+  s_trace = new EventTrace (file, capacity, overwrite);
+}
+
+void
+EventTrace::Disable (void)
+{
+  if (s_trace != 0)
+    {
+      delete s_trace;
+      s_trace = 0;
+    }
+}
+
+EventTrace::EventTrace (std::FILE *file, uint32_t capacity, bool overwrite)
+  : m_file (file),
+    m_records (capacity),
+    m_next (0),
+    m_overwrite (overwrite),
+    m_wrapped (false)
+{
+}
+
+EventTrace::~EventTrace ()
+{
+  Flush ();
+  std::fclose (m_file);
+}
+
+void
+EventTrace::Wrap (void)
+{
+  if (m_overwrite)
+    {
+      m_next = 0;
+      m_wrapped = true;
+    }
+  else
+    {
+      Flush ();
+    }
+}
+
+void
+EventTrace::Flush (void)
+{
+  if (m_wrapped)
+    {
+      // Oldest records first: the tail after the write position, then the head.
+      std::fwrite (&m_records[m_next], sizeof (EventRecord), m_records.size () - m_next, m_file);
+      m_wrapped = false;
+    }
+  std::fwrite (&m_records[0], sizeof (EventRecord), m_next, m_file);
+  m_next = 0;
+}
+
+} // namespace ns3
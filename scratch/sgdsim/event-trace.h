@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include "ns3/simulator.h"
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Fixed-size binary trace record.
+ *
+ * The file written by EventTrace is an 16 byte header ("SGDTRACE", the
+ * format version and the record size as uint32) followed by these
+ * records in host byte order.  plotter/decode_trace.py turns it into CSV.
+ */
+struct EventRecord
+{
+  int64_t time;     //!< simulation time in nanoseconds
+  uint32_t app;     //!< EventTrace::ServerId or EventTrace::ClientId
+  uint16_t type;    //!< EventTrace::Type
+  uint16_t reserved;
+  uint64_t payload; //!< meaning depends on the type
+};
+
+/**
+ * \brief Low-overhead binary tracing of application events.
+ *
+ * Record () is a static inline test of a single pointer when tracing is
+ * disabled.  When enabled it copies a 24 byte record into a preallocated
+ * buffer; a full buffer is written to the file with one fwrite, or, in
+ * overwrite mode, wraps around so only the most recent records are kept
+ * and written when the trace is closed.
+ */
+class EventTrace
+{
+public:
+  enum Type
+  {
+    SERVER_CONNECT_REQUEST = 1, //!< payload: 0
+    SERVER_ACCEPT,              //!< payload: number of connected workers
+    SERVER_BROADCAST,           //!< payload: iteration
+    SERVER_PARAMETER_SEND,      //!< payload: bytes handed to the socket
+    SERVER_PARAMETER_SENT,      //!< payload: iteration << 32 | worker index
+    SERVER_GRADIENT_RECV,       //!< payload: bytes read from the socket
+    SERVER_GRADIENT_RECEIVED,   //!< payload: iteration << 32 | worker index
+    SERVER_AGGREGATE,           //!< payload: iteration
+    CLIENT_CONNECT_REQUEST,     //!< payload: 0
+    CLIENT_CONNECTED,           //!< payload: 0
+    CLIENT_PARAMETER_RECV,      //!< payload: bytes read from the socket
+    CLIENT_PARAMETER_RECEIVED,  //!< payload: iteration
+    CLIENT_PUSH_START,          //!< payload: iteration
+    CLIENT_GRADIENT_SEND,       //!< payload: bytes handed to the socket
+    CLIENT_PUSH_SENT            //!< payload: iteration
+  };
+
+  /**
+   * Start tracing to a file.
+   *
+   * \param filename the file to write
+   * \param capacity number of records buffered in memory
+   * \param overwrite keep only the last capacity records instead of
+   *                  flushing the buffer whenever it fills up
+   */
+  static void Enable (std::string filename, uint32_t capacity, bool overwrite);
+
+  /**
+   * Write the buffered records and close the file.
+   */
+  static void Disable (void);
+
+  static bool IsEnabled (void)
+  {
+    return s_trace != 0;
+  }
+
+  static void Record (uint32_t app, Type type, uint64_t payload)
+  {
+    if (s_trace != 0)
+      {
+        s_trace->Append (app, type, payload);
+      }
+  }
+
+  static uint32_t ServerId (uint32_t serverNum)
+  {
+    return serverNum;
+  }
+
+  static uint32_t ClientId (uint32_t serverNum, uint32_t clientNum)
+  {
+    return 0x80000000 | (serverNum << 16) | (clientNum & 0xffff);
+  }
+
+private:
+  EventTrace (std::FILE *file, uint32_t capacity, bool overwrite);
+  ~EventTrace ();
+
+  void Append (uint32_t app, Type type, uint64_t payload)
+  {
+    EventRecord& record = m_records[m_next++];
+    record.time = Simulator::Now ().GetNanoSeconds ();
+    record.app = app;
+    record.type = type;
+    record.reserved = 0;
+    record.payload = payload;
+    if (m_next == m_records.size ())
+      {
+        Wrap ();
+      }
+  }
+
+  void Wrap (void);
+  void Flush (void);
+
+  static EventTrace *s_trace;
+
+  std::FILE *m_file;
+  std::vector<EventRecord> m_records;
+  size_t m_next;
+  bool m_overwrite;
+  bool m_wrapped;
+};
+
+} // namespace ns3
+
+#endif /* EVENT_TRACE_H */
@@ -0,0 +1,411 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/csma-channel.h"
+#include "ns3/ipv4.h"
+#include "ns3/inet-socket-address.h"
+#include "fluid-network.h"
+#include <cmath>
+#include <deque>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FluidNetwork");
+
+NS_OBJECT_ENSURE_REGISTERED (FluidNetwork);
+
+TypeId
+FluidNetwork::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FluidNetwork")
+    .SetParent<Object> ()
+    .AddConstructor<FluidNetwork> ()
+    .AddAttribute ("Efficiency",
+                   "Fraction of a link's data rate available to application bytes",
+                   DoubleValue (0.84),
+                   MakeDoubleAccessor (&FluidNetwork::m_efficiency),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+  ;
+  return tid;
+}
+
+FluidNetwork::FluidNetwork ()
+  : m_flowCount (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FluidNetwork::~FluidNetwork ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FluidNetwork::AddLink (NetDeviceContainer devices)
+{
+  Ptr<CsmaChannel> channel = DynamicCast<CsmaChannel> (devices.Get (0)->GetChannel ());
+  NS_ASSERT_MSG (channel != 0, "Only CSMA links are supported");
+
+  Link link;
+  link.capacity = channel->GetDataRate ().GetBitRate () / 8.0 * m_efficiency;
+  link.delay = channel->GetDelay ();
+  link.remaining = 0.0;
+  link.unfrozen = 0;
+  uint32_t index = m_links.size ();
+  m_links.push_back (link);
+
+  for (uint32_t i = 0; i != devices.GetN (); i++)
+    {
+      for (uint32_t j = 0; j != devices.GetN (); j++)
+        {
+          if (i != j)
+            {
+              m_adjacency[devices.Get (i)->GetNode ()->GetId ()].push_back (
+                std::make_pair (devices.Get (j)->GetNode ()->GetId (), index));
+            }
+        }
+    }
+  m_hops.clear ();
+  m_routes.clear ();
+}
+
+void
+FluidNetwork::Listen (Ptr<Node> node, uint16_t port, AcceptCallback accept, RecvCallback recv)
+{
+  Listener listener;
+  listener.node = node;
+  listener.accept = accept;
+  listener.recv = recv;
+
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4 != 0, "Listening node has no IPv4 addresses");
+  for (uint32_t i = 0; i != ipv4->GetNInterfaces (); i++)
+    {
+      for (uint32_t j = 0; j != ipv4->GetNAddresses (i); j++)
+        {
+          Ipv4Address local = ipv4->GetAddress (i, j).GetLocal ();
+          m_listeners[std::make_pair (local.Get (), port)] = listener;
+        }
+    }
+}
+
+uint32_t
+FluidNetwork::Connect (Ptr<Node> node, const Address& server, uint16_t port,
+                       ConnectedCallback connected, RecvCallback recv)
+{
+  Ipv4Address address;
+  if (InetSocketAddress::IsMatchingType (server))
+    {
+      InetSocketAddress inet = InetSocketAddress::ConvertFrom (server);
+      address = inet.GetIpv4 ();
+      port = inet.GetPort ();
+    }
+  else
+    {
+      address = Ipv4Address::ConvertFrom (server);
+    }
+
+  std::pair<uint32_t, uint16_t> key = std::make_pair (address.Get (), port);
+  if (m_listeners.find (key) == m_listeners.end ())
+    {
+      NS_FATAL_ERROR ("Nobody listens on " << address << ":" << port);
+    }
+
+  uint32_t index = m_connections.size ();
+  Connection connection;
+  connection.listener = key;
+  connection.client = node;
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  Ipv4Address local = (ipv4 != 0 && ipv4->GetNInterfaces () > 1) ? ipv4->GetAddress (1, 0).GetLocal () : Ipv4Address::GetAny ();
+  connection.clientAddress = InetSocketAddress (local, 49153 + (index % 16384));
+  connection.connected = connected;
+  connection.recv = recv;
+  m_connections.push_back (connection);
+
+  // One round trip for the handshake.
+  const std::vector<uint32_t>& path = Route (node->GetId (), m_listeners[key].node->GetId (), index);
+  Simulator::Schedule (GetPathDelay (path) + GetPathDelay (path), &FluidNetwork::Accept, this, index);
+  return index;
+}
+
+Address
+FluidNetwork::GetClientAddress (uint32_t connection) const
+{
+  return m_connections[connection].clientAddress;
+}
+
+void
+FluidNetwork::Accept (uint32_t connection)
+{
+  Connection& c = m_connections[connection];
+  m_listeners[c.listener].accept (connection, c.clientAddress);
+  c.connected (connection);
+}
+
+void
+FluidNetwork::Send (uint32_t connection, bool toServer, uint64_t bytes)
+{
+  NS_LOG_FUNCTION (this << connection << toServer << bytes);
+  Connection& c = m_connections[connection];
+  uint32_t server = m_listeners[c.listener].node->GetId ();
+  uint32_t client = c.client->GetId ();
+
+  m_flowCount++;
+  Advance ();
+
+  Flow flow;
+  flow.path = toServer ? &Route (client, server, connection) : &Route (server, client, connection);
+  flow.bytes = bytes;
+  flow.rate = 0.0;
+  flow.sent = Simulator::Now ();
+  flow.connection = connection;
+  flow.toServer = toServer;
+  if (flow.path->empty () || bytes == 0)
+    {
+      Simulator::ScheduleNow (&FluidNetwork::Deliver, this, connection, toServer, flow.sent);
+      return;
+    }
+  m_flows.push_back (flow);
+
+  Allocate ();
+  ScheduleCompletion ();
+}
+
+uint64_t
+FluidNetwork::GetFlowCount (void) const
+{
+  return m_flowCount;
+}
+
+const std::vector<uint32_t>&
+FluidNetwork::Route (uint32_t from, uint32_t to, uint32_t connection)
+{
+  std::pair<std::pair<uint32_t, uint32_t>, uint32_t> key = std::make_pair (std::make_pair (from, to), connection);
+  std::map<std::pair<std::pair<uint32_t, uint32_t>, uint32_t>, std::vector<uint32_t> >::iterator it = m_routes.find (key);
+  if (it != m_routes.end ())
+    {
+      return it->second;
+    }
+
+  const std::map<uint32_t, uint32_t>& hops = GetHops (to);
+  if (hops.find (from) == hops.end ())
+    {
+      NS_FATAL_ERROR ("No path from node " << from << " to node " << to);
+    }
+
+  // Every hop goes to a neighbour one hop closer, the connection picking
+  // among the links that do.
+  std::vector<uint32_t>& path = m_routes[key];
+  for (uint32_t node = from; node != to; )
+    {
+      uint32_t left = hops.find (node)->second;
+      std::vector<std::pair<uint32_t, uint32_t> > closer;
+      const std::vector<std::pair<uint32_t, uint32_t> >& neighbours = m_adjacency[node];
+      for (size_t i = 0; i != neighbours.size (); i++)
+        {
+          std::map<uint32_t, uint32_t>::const_iterator h = hops.find (neighbours[i].first);
+          if (h != hops.end () && h->second + 1 == left)
+            {
+              closer.push_back (neighbours[i]);
+            }
+        }
+      uint32_t hash = (connection + 1) * 2654435761u ^ (node + 1) * 40503u ^ to;
+      const std::pair<uint32_t, uint32_t>& next = closer[hash % closer.size ()];
+      path.push_back (next.second);
+      node = next.first;
+    }
+  return path;
+}
+
+const std::map<uint32_t, uint32_t>&
+FluidNetwork::GetHops (uint32_t to)
+{
+  std::map<uint32_t, std::map<uint32_t, uint32_t> >::iterator it = m_hops.find (to);
+  if (it != m_hops.end ())
+    {
+      return it->second;
+    }
+
+  std::map<uint32_t, uint32_t>& hops = m_hops[to];
+  std::deque<uint32_t> queue;
+  queue.push_back (to);
+  hops[to] = 0;
+  while (!queue.empty ())
+    {
+      uint32_t node = queue.front ();
+      queue.pop_front ();
+      const std::vector<std::pair<uint32_t, uint32_t> >& neighbours = m_adjacency[node];
+      for (size_t i = 0; i != neighbours.size (); i++)
+        {
+          if (hops.find (neighbours[i].first) == hops.end ())
+            {
+              hops[neighbours[i].first] = hops[node] + 1;
+              queue.push_back (neighbours[i].first);
+            }
+        }
+    }
+  return hops;
+}
+
+Time
+FluidNetwork::GetPathDelay (const std::vector<uint32_t>& path) const
+{
+  Time delay;
+  for (size_t i = 0; i != path.size (); i++)
+    {
+      delay += m_links[path[i]].delay;
+    }
+  return delay;
+}
+
+void
+FluidNetwork::Advance (void)
+{
+  double elapsed = (Simulator::Now () - m_lastUpdate).GetSeconds ();
+  m_lastUpdate = Simulator::Now ();
+  for (std::list<Flow>::iterator it = m_flows.begin (); it != m_flows.end (); ++it)
+    {
+      it->bytes -= it->rate * elapsed;
+    }
+}
+
+void
+FluidNetwork::Allocate (void)
+{
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      m_links[i].remaining = m_links[i].capacity;
+      m_links[i].unfrozen = 0;
+    }
+  for (std::list<Flow>::iterator it = m_flows.begin (); it != m_flows.end (); ++it)
+    {
+      it->rate = -1.0;
+      for (size_t i = 0; i != it->path->size (); i++)
+        {
+          m_links[(*it->path)[i]].unfrozen++;
+        }
+    }
+
+  // Repeatedly find the smallest fair share over all links and fix the
+  // rate of every flow crossing a link that offers only that share.
+  std::vector<bool> bottleneck (m_links.size ());
+  size_t left = m_flows.size ();
+  while (left > 0)
+    {
+      double share = std::numeric_limits<double>::infinity ();
+      for (size_t i = 0; i != m_links.size (); i++)
+        {
+          if (m_links[i].unfrozen > 0)
+            {
+              share = std::min (share, m_links[i].remaining / m_links[i].unfrozen);
+            }
+        }
+      for (size_t i = 0; i != m_links.size (); i++)
+        {
+          bottleneck[i] = m_links[i].unfrozen > 0
+            && m_links[i].remaining / m_links[i].unfrozen <= share * (1.0 + 1e-9);
+        }
+      for (std::list<Flow>::iterator it = m_flows.begin (); it != m_flows.end (); ++it)
+        {
+          if (it->rate >= 0.0)
+            {
+              continue;
+            }
+          bool limited = false;
+          for (size_t i = 0; i != it->path->size () && !limited; i++)
+            {
+              limited = bottleneck[(*it->path)[i]];
+            }
+          if (limited)
+            {
+              it->rate = share;
+              left--;
+              for (size_t i = 0; i != it->path->size (); i++)
+                {
+                  Link& link = m_links[(*it->path)[i]];
+                  link.remaining = std::max (0.0, link.remaining - share);
+                  link.unfrozen--;
+                }
+            }
+        }
+    }
+}
+
+void
+FluidNetwork::ScheduleCompletion (void)
+{
+  Simulator::Cancel (m_completionEvent);
+  if (m_flows.empty ())
+    {
+      return;
+    }
+
+  double next = std::numeric_limits<double>::infinity ();
+  for (std::list<Flow>::iterator it = m_flows.begin (); it != m_flows.end (); ++it)
+    {
+      if (it->rate > 0.0)
+        {
+          next = std::min (next, std::max (0.0, it->bytes) / it->rate);
+        }
+    }
+  NS_ASSERT (next < std::numeric_limits<double>::infinity ());
+  // Round up so the flow has really finished when the event runs.
+  m_completionEvent = Simulator::Schedule (NanoSeconds ((int64_t) std::ceil (next * 1e9)),
+                                           &FluidNetwork::Complete, this);
+}
+
+void
+FluidNetwork::Complete (void)
+{
+  Advance ();
+  std::list<Flow>::iterator it = m_flows.begin ();
+  while (it != m_flows.end ())
+    {
+      // Less than a thousandth of a byte left is rounding error.
+      if (it->bytes < 1e-3)
+        {
+          Simulator::Schedule (GetPathDelay (*it->path), &FluidNetwork::Deliver, this,
+                               it->connection, it->toServer, it->sent);
+          it = m_flows.erase (it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+  Allocate ();
+  ScheduleCompletion ();
+}
+
+void
+FluidNetwork::Deliver (uint32_t connection, bool toServer, Time sent)
+{
+  Connection& c = m_connections[connection];
+  if (toServer)
+    {
+      m_listeners[c.listener].recv (connection, sent);
+    }
+  else
+    {
+      c.recv (connection, sent);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLUID_NETWORK_H
+#define FLUID_NETWORK_H
+
+#include "ns3/object.h"
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/address.h"
+#include "ns3/node.h"
+#include "ns3/net-device-container.h"
+#include <list>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Flow-level network model for ParameterServer and ParameterClient.
+ *
+ * Instead of packets, every message (a parameter or gradient update) is a
+ * flow over the path between two nodes.  Active flows share link
+ * capacity max-min fairly; rates are recomputed only when a flow starts or
+ * finishes, so the number of simulator events is proportional to the
+ * number of messages, not to the number of packets.  A message is
+ * delivered the path's propagation delay after its last byte left.
+ *
+ * Links are taken from the CSMA channels of the packet-level topology.
+ * A CSMA channel is half-duplex, so both directions share its capacity,
+ * and only Efficiency of the data rate is available to application bytes
+ * (TCP/IP/Ethernet headers and ACKs take the rest).  Paths are shortest
+ * paths; where there are several, e.g. over the parallel uplinks of a
+ * rack, every connection is hashed onto one of them hop by hop, as ECMP
+ * routers hash flows.
+ *
+ * Applications connect through Listen () and Connect () much like
+ * through sockets, except that whole messages are sent and received.
+ */
+class FluidNetwork : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  FluidNetwork ();
+  virtual ~FluidNetwork ();
+
+  /**
+   * Called on the server side for every new connection.
+   *
+   * \param connection the connection
+   * \param address the address of the client end of the connection
+   */
+  typedef Callback<void, uint32_t, const Address&> AcceptCallback;
+
+  /**
+   * Called on the client side once the connection is established.
+   */
+  typedef Callback<void, uint32_t> ConnectedCallback;
+
+  /**
+   * Called when a message has been completely received.
+   *
+   * \param connection the connection
+   * \param sent the time the message started to be sent
+   */
+  typedef Callback<void, uint32_t, Time> RecvCallback;
+
+  /**
+   * Add the channel connecting the devices as a link.
+   */
+  void AddLink (NetDeviceContainer devices);
+
+  /**
+   * Accept connections to every IPv4 address of a node on a port.
+   */
+  void Listen (Ptr<Node> node, uint16_t port, AcceptCallback accept, RecvCallback recv);
+
+  /**
+   * Connect to a listening server.
+   *
+   * \param node the client node
+   * \param server the server's Ipv4Address or InetSocketAddress
+   * \param port the server's port, ignored for an InetSocketAddress
+   * \param connected called once the connection is established
+   * \param recv called for every message received from the server
+   * \return the connection
+   */
+  uint32_t Connect (Ptr<Node> node, const Address& server, uint16_t port,
+                    ConnectedCallback connected, RecvCallback recv);
+
+  /**
+   * \return the address standing for the client end of a connection, as
+   *         a socket's local address would
+   */
+  Address GetClientAddress (uint32_t connection) const;
+
+  /**
+   * Start sending a message over a connection.
+   *
+   * \param connection the connection
+   * \param toServer the direction of the message
+   * \param bytes size of the message
+   */
+  void Send (uint32_t connection, bool toServer, uint64_t bytes);
+
+  /**
+   * \return the number of messages sent so far
+   */
+  uint64_t GetFlowCount (void) const;
+
+private:
+  struct Link
+  {
+    double capacity;  //!< application bytes per second
+    Time delay;
+    double remaining; //!< capacity not yet allocated
+    uint32_t unfrozen; //!< flows whose rate is not allocated yet
+  };
+
+  struct Flow
+  {
+    const std::vector<uint32_t> *path;
+    double bytes;     //!< bytes left to send
+    double rate;      //!< bytes per second
+    Time sent;
+    uint32_t connection;
+    bool toServer;
+  };
+
+  struct Listener
+  {
+    Ptr<Node> node;
+    AcceptCallback accept;
+    RecvCallback recv;
+  };
+
+  struct Connection
+  {
+    std::pair<uint32_t, uint16_t> listener;
+    Ptr<Node> client;
+    Address clientAddress;
+    ConnectedCallback connected;
+    RecvCallback recv;
+  };
+
+  /**
+   * \param from source node
+   * \param to destination node
+   * \param connection the connection, which picks among equal-cost paths
+   * \return the links of the path
+   */
+  const std::vector<uint32_t>& Route (uint32_t from, uint32_t to, uint32_t connection);
+  /// Hops from every node to a destination, by breadth-first search.
+  const std::map<uint32_t, uint32_t>& GetHops (uint32_t to);
+  Time GetPathDelay (const std::vector<uint32_t>& path) const;
+
+  void Accept (uint32_t connection);
+  void Deliver (uint32_t connection, bool toServer, Time sent);
+
+  /// Account for the bytes sent since the last update.
+  void Advance (void);
+  /// Max-min fair rates by progressive filling.
+  void Allocate (void);
+  /// Schedule the next flow completion.
+  void ScheduleCompletion (void);
+  void Complete (void);
+
+  double m_efficiency;
+
+  std::vector<Link> m_links;
+  std::map<uint32_t, std::vector<std::pair<uint32_t, uint32_t> > > m_adjacency; //!< node -> (neighbour, link)
+  std::map<uint32_t, std::map<uint32_t, uint32_t> > m_hops; //!< destination -> (node -> hops)
+  std::map<std::pair<std::pair<uint32_t, uint32_t>, uint32_t>, std::vector<uint32_t> > m_routes; //!< ((from, to), connection) -> links
+
+  std::map<std::pair<uint32_t, uint16_t>, Listener> m_listeners; //!< (address, port) -> listener
+  std::vector<Connection> m_connections;
+
+  std::list<Flow> m_flows;
+  Time m_lastUpdate;
+  EventId m_completionEvent;
+  uint64_t m_flowCount;
+};
+
+} // namespace ns3
+
+#endif /* FLUID_NETWORK_H */
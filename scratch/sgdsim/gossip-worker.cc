@@ -0,0 +1,455 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/trace-source-accessor.h"
+#include "gossip-worker.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GossipWorkerApplication");
+
+NS_OBJECT_ENSURE_REGISTERED (GossipWorker);
+
+TypeId
+GossipWorker::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::GossipWorker")
+    .SetParent<Application> ()
+    .SetGroupName("Applications")
+    .AddConstructor<GossipWorker> ()
+    .AddAttribute ("Port",
+                   "Port on which neighbors connect, and on which they listen",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&GossipWorker::m_port),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("WorkerNum",
+                   "WorkerNum",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&GossipWorker::m_workerNum),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MTU",
+                   "MTU",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&GossipWorker::m_mtu),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ModelSize",
+                   "Size in bytes of the model sent to every neighbor in every iteration",
+                   UintegerValue (97490),
+                   MakeUintegerAccessor (&GossipWorker::m_modelSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ComputeTimeMean",
+                   "Mean of the normally distributed compute time of an iteration, in seconds",
+                   DoubleValue (0.6383/4.0),
+                   MakeDoubleAccessor (&GossipWorker::m_computeTimeMean),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ComputeTimeStdDev",
+                   "Standard deviation of the compute time of an iteration, in seconds",
+                   DoubleValue (0.2673/4.0),
+                   MakeDoubleAccessor (&GossipWorker::m_computeTimeStdDev),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("MinComputeTime",
+                   "Lower bound on the compute time of an iteration, in seconds",
+                   DoubleValue (0.05),
+                   MakeDoubleAccessor (&GossipWorker::m_minComputeTime),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("MaxIterations",
+                   "Number of iterations after which the worker stops, 0 for no limit",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&GossipWorker::m_maxIterations),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FluidNetwork",
+                   "Flow-level network to exchange models over instead of TCP sockets",
+                   PointerValue (),
+                   MakePointerAccessor (&GossipWorker::m_fluid),
+                   MakePointerChecker<FluidNetwork> ())
+    .AddTraceSource ("Iteration",
+                     "An iteration has started",
+                     MakeTraceSourceAccessor (&GossipWorker::m_iterationTrace),
+                     "ns3::GossipWorker::IterationTracedCallback")
+    .AddTraceSource ("Finished",
+                     "The last of MaxIterations iterations has finished",
+                     MakeTraceSourceAccessor (&GossipWorker::m_finishedTrace),
+                     "ns3::GossipWorker::IterationTracedCallback")
+  ;
+  return tid;
+}
+
+GossipWorker::GossipWorker ()
+  : m_connected (0),
+    m_iteration (0),
+    m_waiting (false),
+    m_iterationTimes (200.0),
+    m_waitTimes (200.0)
+{
+  NS_LOG_FUNCTION (this);
+  m_computeTime = CreateObject<NormalRandomVariable> ();
+}
+
+GossipWorker::~GossipWorker ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+GossipWorker::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_out.clear ();
+  m_inSockets.clear ();
+  Application::DoDispose ();
+}
+
+void
+GossipWorker::AddNeighbor (Address address)
+{
+  Peer peer;
+  peer.address = address;
+  peer.connection = 0;
+  peer.bytesLeftSend = 0;
+  m_out.push_back (peer);
+}
+
+uint32_t
+GossipWorker::GetWorkerNum (void) const
+{
+  return m_workerNum;
+}
+
+uint32_t
+GossipWorker::GetNeighborCount (void) const
+{
+  return m_out.size ();
+}
+
+const TDigest&
+GossipWorker::GetIterationTimes (void) const
+{
+  return m_iterationTimes;
+}
+
+const TDigest&
+GossipWorker::GetWaitTimes (void) const
+{
+  return m_waitTimes;
+}
+
+void
+GossipWorker::StartApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_gpus = GpuHost::Get (GetNode ());
+  m_host = HostCost::Get (GetNode ());
+
+  if (m_fluid != 0)
+    {
+      m_fluid->Listen (GetNode (), m_port, MakeCallback (&GossipWorker::FluidAccept, this),
+                       MakeCallback (&GossipWorker::FluidReceive, this));
+      for (size_t i = 0; i != m_out.size (); i++)
+        {
+          m_out[i].connection = m_fluid->Connect (GetNode (), m_out[i].address, m_port,
+                                                  MakeCallback (&GossipWorker::FluidConnected, this),
+                                                  MakeNullCallback<void, uint32_t, Time> ());
+        }
+    }
+  else
+    {
+      TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
+      m_socket = Socket::CreateSocket (GetNode (), tid);
+      m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                   MakeCallback (&GossipWorker::HandleAccept, this));
+      if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port)) == -1)
+        {
+          NS_FATAL_ERROR ("Failed to bind socket");
+        }
+      m_socket->Listen ();
+
+      for (size_t i = 0; i != m_out.size (); i++)
+        {
+          Ptr<Socket> socket = Socket::CreateSocket (GetNode (), tid);
+          if (socket->Bind () == -1)
+            {
+              NS_FATAL_ERROR ("Failed to bind socket");
+            }
+          socket->SetConnectCallback (MakeCallback (&GossipWorker::ConnectionSucceeded, this),
+                                      MakeCallback (&GossipWorker::ConnectionFailed, this));
+          socket->SetSendCallback (MakeCallback (&GossipWorker::ContinueModel, this));
+          socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_out[i].address), m_port));
+          m_out[i].socket = socket;
+        }
+    }
+
+  if (m_out.empty ())
+    {
+      StartIteration ();
+    }
+}
+
+void
+GossipWorker::ConnectionSucceeded (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  PeerConnected ();
+}
+
+void
+GossipWorker::ConnectionFailed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_LOG_WARN ("Worker #" << m_workerNum << " failed to connect to a neighbor");
+}
+
+void
+GossipWorker::FluidConnected (uint32_t connection)
+{
+  NS_LOG_FUNCTION (this << connection);
+  PeerConnected ();
+}
+
+void
+GossipWorker::PeerConnected (void)
+{
+  // The first iteration starts once the models can be sent to everybody.
+  m_connected++;
+  if (m_connected == m_out.size ())
+    {
+      StartIteration ();
+    }
+}
+
+void
+GossipWorker::HandleAccept (Ptr<Socket> socket, const Address& address)
+{
+  NS_LOG_FUNCTION (this << socket << address);
+  socket->SetRecvCallback (MakeCallback (&GossipWorker::ReceiveModel, this));
+  m_inSockets.push_back (socket);
+  m_inBytes.push_back (0);
+}
+
+void
+GossipWorker::FluidAccept (uint32_t connection, const Address& address)
+{
+  NS_LOG_FUNCTION (this << connection << address);
+  m_inConnections.push_back (connection);
+  m_inBytes.push_back (0);
+}
+
+void
+GossipWorker::ReceiveModel (Ptr<Socket> socket)
+{
+  for (size_t i = 0; i != m_inSockets.size (); i++)
+    {
+      if (m_inSockets[i] == socket)
+        {
+          uint64_t bytes = 0;
+          Ptr<Packet> packet;
+          while ((packet = socket->Recv ()) && packet->GetSize () > 0)
+            {
+              bytes += packet->GetSize ();
+            }
+          // The model is there once the host CPU processed all of it.
+          Time done = m_host->Receive (bytes);
+          if (done > Simulator::Now ())
+            {
+              Simulator::Schedule (done - Simulator::Now (), &GossipWorker::ModelReceived, this, i, bytes);
+            }
+          else
+            {
+              ModelReceived (i, bytes);
+            }
+          return;
+        }
+    }
+}
+
+void
+GossipWorker::ModelReceived (size_t i, uint64_t bytes)
+{
+  m_inBytes[i] += bytes;
+  CheckNeighbors ();
+}
+
+void
+GossipWorker::FluidReceive (uint32_t connection, Time sent)
+{
+  for (size_t i = 0; i != m_inConnections.size (); i++)
+    {
+      if (m_inConnections[i] == connection)
+        {
+          m_inBytes[i] += m_modelSize;
+          CheckNeighbors ();
+          return;
+        }
+    }
+}
+
+void
+GossipWorker::StartIteration (void)
+{
+  if (m_maxIterations > 0 && m_iteration >= m_maxIterations)
+    {
+      m_finishedTrace (m_workerNum, m_iteration);
+      return;
+    }
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Worker #" << m_workerNum << " starts iteration " << m_iteration);
+  m_iterationTrace (m_workerNum, m_iteration);
+  if (m_iteration > 0)
+    {
+      m_iterationTimes.Add ((Simulator::Now () - m_iterationStart).GetSeconds ());
+    }
+  m_iterationStart = Simulator::Now ();
+
+  // Broadcast the averaged model to the GPUs of the host, wait for the
+  // slowest of them and reduce their gradients to this worker.
+  double delay = 0.0;
+  for (uint32_t g = 0; g != m_gpus->GetGpus (); g++)
+    {
+      double step = m_computeTime->GetValue (m_computeTimeMean, m_computeTimeStdDev * m_computeTimeStdDev);
+      delay = std::max (delay, std::max (step, m_minComputeTime));
+    }
+  delay += (m_gpus->Broadcast (m_modelSize) + m_gpus->Reduce (m_modelSize)).GetSeconds ();
+  m_computeEvent = Simulator::Schedule (Seconds (delay), &GossipWorker::SendModel, this);
+}
+
+void
+GossipWorker::SendModel (void)
+{
+  m_computeEnd = Simulator::Now ();
+  m_waiting = true;
+  for (size_t i = 0; i != m_out.size (); i++)
+    {
+      if (m_fluid != 0)
+        {
+          m_fluid->Send (m_out[i].connection, true, m_modelSize);
+          continue;
+        }
+      m_out[i].bytesLeftSend += m_modelSize;
+      ContinueModel (m_out[i].socket, m_out[i].socket->GetTxAvailable ());
+    }
+  CheckNeighbors ();
+}
+
+void
+GossipWorker::ContinueModel (Ptr<Socket> socket, uint32_t ready)
+{
+  for (size_t i = 0; i != m_out.size (); i++)
+    {
+      Peer& peer = m_out[i];
+      if (peer.socket != socket)
+        {
+          continue;
+        }
+      // The host CPU timer resumes the send.
+      if (peer.resumeSend.IsRunning ())
+        {
+          return;
+        }
+
+      uint32_t toSend;
+      int actual;
+      do
+        {
+          toSend = std::min<uint64_t> (m_host->GetWriteSize (m_mtu - 40), peer.bytesLeftSend);
+          toSend = std::min (toSend, ready);
+          if (toSend == 0)
+            {
+              break;
+            }
+          actual = socket->Send (Create<Packet> (toSend));
+          if (actual > 0)
+            {
+              peer.bytesLeftSend -= actual;
+              ready -= actual;
+              // Hand the next bytes to the stack once the CPU is done with these.
+              Time done = m_host->Send (actual);
+              if (done > Simulator::Now ())
+                {
+                  peer.resumeSend = Simulator::Schedule (done - Simulator::Now (), &GossipWorker::ResumeModel, this, socket);
+                  break;
+                }
+            }
+        }
+      while (actual == (int) toSend);
+      return;
+    }
+}
+
+void
+GossipWorker::ResumeModel (Ptr<Socket> socket)
+{
+  ContinueModel (socket, socket->GetTxAvailable ());
+}
+
+void
+GossipWorker::CheckNeighbors (void)
+{
+  if (!m_waiting || m_inBytes.size () < m_out.size ())
+    {
+      return;
+    }
+  // Neighbors may already have sent the model of the next iteration.
+  uint64_t needed = (uint64_t) (m_iteration + 1) * m_modelSize;
+  for (size_t i = 0; i != m_inBytes.size (); i++)
+    {
+      if (m_inBytes[i] < needed)
+        {
+          return;
+        }
+    }
+
+  m_waiting = false;
+  m_waitTimes.Add ((Simulator::Now () - m_computeEnd).GetSeconds ());
+  m_iteration++;
+  StartIteration ();
+}
+
+void
+GossipWorker::StopApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_socket != 0)
+    {
+      m_socket->Close ();
+      m_socket = 0;
+    }
+  for (size_t i = 0; i != m_inSockets.size (); i++)
+    {
+      m_inSockets[i]->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+  for (size_t i = 0; i != m_out.size (); i++)
+    {
+      if (m_out[i].socket != 0)
+        {
+          m_out[i].socket->Close ();
+        }
+      Simulator::Cancel (m_out[i].resumeSend);
+    }
+
+  Simulator::Cancel (m_computeEvent);
+}
+
+} // namespace ns3
@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GOSSIP_WORKER_H
+#define GOSSIP_WORKER_H
+
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+#include "ns3/address.h"
+#include "ns3/traced-callback.h"
+#include "ns3/random-variable-stream.h"
+#include "quantile-sketch.h"
+#include "fluid-network.h"
+#include "gpu-host.h"
+#include "host-cost.h"
+#include <vector>
+
+namespace ns3 {
+
+class Socket;
+
+/**
+ * \brief A worker of decentralized, gossip-based SGD (D-PSGD).
+ *
+ * There is no parameter server.  In every iteration a worker computes
+ * its gradient, sends its model to each of its neighbors and averages the
+ * models it receives from them; it starts the next iteration as soon as
+ * the models of all its neighbors for the current one have arrived, so it
+ * only ever waits for its neighbors, never for the whole cluster.
+ *
+ * Every worker connects to each of its neighbors and accepts one
+ * connection from each of them, so the neighbor relation must be
+ * symmetric.  A neighbor can be at most one iteration ahead, since it
+ * needs this worker's model to finish its own iteration.
+ */
+class GossipWorker : public Application
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  GossipWorker ();
+
+  virtual ~GossipWorker ();
+
+  /**
+   * TracedCallback signature for iteration events, compatible with
+   * ParameterServer::IterationTracedCallback.
+   *
+   * \param [in] workerNum the number of the worker
+   * \param [in] iteration the iteration the event belongs to
+   */
+  typedef void (* IterationTracedCallback)(uint32_t workerNum, uint32_t iteration);
+
+  /**
+   * Exchange models with the worker listening on the given address.
+   *
+   * \param address the IPv4 address of the neighbor's node
+   */
+  void AddNeighbor (Address address);
+
+  uint32_t GetWorkerNum (void) const;
+
+  uint32_t GetNeighborCount (void) const;
+
+  /**
+   * \return sketch of the time between the start of two consecutive
+   *         iterations
+   */
+  const TDigest& GetIterationTimes (void) const;
+
+  /**
+   * \return sketch of the time from the end of the gradient computation to
+   *         the arrival of the last neighbor's model
+   */
+  const TDigest& GetWaitTimes (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Peer
+  {
+    Address address;
+    Ptr<Socket> socket;
+    uint32_t connection;
+    uint64_t bytesLeftSend; //!< Outgoing bytes not yet accepted by the socket
+    EventId resumeSend; //!< Resumes sending once the host CPU is done
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void ConnectionSucceeded (Ptr<Socket> socket);
+  void ConnectionFailed (Ptr<Socket> socket);
+  void FluidConnected (uint32_t connection);
+  void PeerConnected (void);
+
+  void HandleAccept (Ptr<Socket> socket, const Address& address);
+  void FluidAccept (uint32_t connection, const Address& address);
+  void FluidReceive (uint32_t connection, Time sent);
+  void ReceiveModel (Ptr<Socket> socket);
+  /// Count bytes from the i-th neighbor once the host CPU processed them.
+  void ModelReceived (size_t i, uint64_t bytes);
+
+  void StartIteration (void);
+  void SendModel (void);
+  void ContinueModel (Ptr<Socket> socket, uint32_t ready);
+  void ResumeModel (Ptr<Socket> socket);
+
+  /// Finish the iteration if the models of all neighbors arrived.
+  void CheckNeighbors (void);
+
+  uint16_t m_port;
+  uint32_t m_workerNum;
+  uint32_t m_mtu;
+  uint32_t m_modelSize;
+  uint32_t m_maxIterations; //!< Iterations to run, 0 for no limit
+  Ptr<FluidNetwork> m_fluid; //!< Flow-level network used instead of sockets, if any
+  Ptr<GpuHost> m_gpus; //!< GPUs this worker stands for
+  Ptr<HostCost> m_host; //!< CPU cost of the network stack
+
+  Ptr<Socket> m_socket; //!< Listening socket
+  std::vector<Peer> m_out; //!< Connections to the neighbors
+  std::vector<Ptr<Socket> > m_inSockets; //!< Connections from the neighbors
+  std::vector<uint32_t> m_inConnections; //!< Fluid connections from the neighbors
+  std::vector<uint64_t> m_inBytes; //!< Bytes received from each neighbor so far
+  uint32_t m_connected;
+
+  uint32_t m_iteration; //!< Number of the current iteration
+  bool m_waiting; //!< Gradient computed, waiting for the neighbors
+  EventId m_computeEvent;
+  Time m_iterationStart;
+  Time m_computeEnd;
+
+  Ptr<NormalRandomVariable> m_computeTime; //!< Compute time of an iteration
+  double m_computeTimeMean;
+  double m_computeTimeStdDev;
+  double m_minComputeTime;
+
+  TDigest m_iterationTimes;
+  TDigest m_waitTimes;
+
+  /// Traced callback: an iteration has started.
+  TracedCallback<uint32_t, uint32_t> m_iterationTrace;
+  /// Traced callback: the last of MaxIterations iterations has finished.
+  TracedCallback<uint32_t, uint32_t> m_finishedTrace;
+};
+
+} // namespace ns3
+
+#endif /* GOSSIP_WORKER_H */
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "gpu-host.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("GpuHost");
+
+NS_OBJECT_ENSURE_REGISTERED (GpuHost);
+
+TypeId
+GpuHost::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::GpuHost")
+    .SetParent<Object> ()
+    .AddConstructor<GpuHost> ()
+    .AddAttribute ("Gpus",
+                   "Number of GPUs of the host",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&GpuHost::m_gpus),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("IntraHostBandwidth",
+                   "Bytes per second between two neighboring GPUs of the ring",
+                   DoubleValue (1.2e10),
+                   MakeDoubleAccessor (&GpuHost::m_bandwidth),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("IntraHostLatency",
+                   "Latency of one step of the ring",
+                   TimeValue (MicroSeconds (5)),
+                   MakeTimeAccessor (&GpuHost::m_latency),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+GpuHost::GpuHost ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+GpuHost::~GpuHost ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<GpuHost>
+GpuHost::Get (Ptr<Node> node)
+{
+  Ptr<GpuHost> host = node->GetObject<GpuHost> ();
+  if (host == 0)
+    {
+      host = CreateObject<GpuHost> ();
+      node->AggregateObject (host);
+    }
+  return host;
+}
+
+uint32_t
+GpuHost::GetGpus (void) const
+{
+  return m_gpus;
+}
+
+Time
+GpuHost::Reduce (uint64_t bytes)
+{
+  Time duration = GetRingTime (bytes);
+  m_localTime += duration;
+  return duration;
+}
+
+Time
+GpuHost::Broadcast (uint64_t bytes)
+{
+  Time duration = GetRingTime (bytes);
+  m_localTime += duration;
+  return duration;
+}
+
+Time
+GpuHost::GetLocalTime (void) const
+{
+  return m_localTime;
+}
+
+Time
+GpuHost::GetRingTime (uint64_t bytes) const
+{
+  if (m_gpus < 2)
+    {
+      return Seconds (0);
+    }
+  // Two passes of Gpus - 1 steps, each moving a 1/Gpus share.
+  uint32_t steps = 2 * (m_gpus - 1);
+  return Seconds (steps * (m_latency.GetSeconds () + (double) bytes / m_gpus / m_bandwidth));
+}
+
+} // namespace ns3
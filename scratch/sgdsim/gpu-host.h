@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GPU_HOST_H
+#define GPU_HOST_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/node.h"
+
+namespace ns3 {
+
+/**
+ * \brief The GPUs of a host and the interconnect between them.
+ *
+ * A worker application stands for all Gpus of its host and is the only
+ * one talking to the network.  Every GPU computes the iteration; the
+ * gradients are then reduced to the leader over the intra-host
+ * interconnect, and the parameters received by the leader are
+ * broadcast back to the GPUs.  Both run as a ring of Gpus steps moving
+ * a 1/Gpus share of the bytes each, twice (reduce-scatter and gather,
+ * scatter and all-gather).
+ *
+ * The applications of a node share one instance, aggregated to the node
+ * by Get.  With the default of one GPU the local phases take no time.
+ */
+class GpuHost : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  GpuHost ();
+  virtual ~GpuHost ();
+
+  /**
+   * \return the instance aggregated to node, created with the attribute
+   *         defaults on first use
+   */
+  static Ptr<GpuHost> Get (Ptr<Node> node);
+
+  uint32_t GetGpus (void) const;
+
+  /**
+   * Account for the reduction of bytes of gradients to the leader.
+   *
+   * \return its duration
+   */
+  Time Reduce (uint64_t bytes);
+
+  /**
+   * Account for the broadcast of bytes of parameters from the leader.
+   *
+   * \return its duration
+   */
+  Time Broadcast (uint64_t bytes);
+
+  /**
+   * \return the time spent reducing and broadcasting so far
+   */
+  Time GetLocalTime (void) const;
+
+private:
+  Time GetRingTime (uint64_t bytes) const;
+
+  uint32_t m_gpus;
+  double m_bandwidth; //!< Bytes per second of a link of the ring
+  Time m_latency; //!< Latency of a step of the ring
+
+  Time m_localTime;
+};
+
+} // namespace ns3
+
+#endif /* GPU_HOST_H */
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "host-cost.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("HostCost");
+
+NS_OBJECT_ENSURE_REGISTERED (HostCost);
+
+TypeId
+HostCost::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::HostCost")
+    .SetParent<Object> ()
+    .AddConstructor<HostCost> ()
+    .AddAttribute ("PacketCost",
+                   "CPU time of sending or receiving one packet",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&HostCost::m_packetCost),
+                   MakeTimeChecker ())
+    .AddAttribute ("SegmentSize",
+                   "Payload bytes of a packet, as ns3::TcpSocket::SegmentSize",
+                   UintegerValue (536),
+                   MakeUintegerAccessor (&HostCost::m_segmentSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Tso",
+                   "The NIC segments OffloadSize bytes at once on sending",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&HostCost::m_tso),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Gro",
+                   "The NIC merges received segments into OffloadSize bytes",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&HostCost::m_gro),
+                   MakeBooleanChecker ())
+    .AddAttribute ("OffloadSize",
+                   "Bytes handed to or from the NIC at once with Tso or Gro",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&HostCost::m_offloadSize),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+HostCost::HostCost ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+HostCost::~HostCost ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<HostCost>
+HostCost::Get (Ptr<Node> node)
+{
+  Ptr<HostCost> cost = node->GetObject<HostCost> ();
+  if (cost == 0)
+    {
+      cost = CreateObject<HostCost> ();
+      node->AggregateObject (cost);
+    }
+  return cost;
+}
+
+uint32_t
+HostCost::GetWriteSize (uint32_t mss) const
+{
+  return m_tso ? m_offloadSize : mss;
+}
+
+Time
+HostCost::Send (uint32_t bytes)
+{
+  return Charge ((double) bytes / (m_tso ? m_offloadSize : m_segmentSize));
+}
+
+Time
+HostCost::Receive (uint32_t bytes)
+{
+  return Charge ((double) bytes / (m_gro ? m_offloadSize : m_segmentSize));
+}
+
+Time
+HostCost::GetBusyTime (void) const
+{
+  return m_busyTime;
+}
+
+Time
+HostCost::Charge (double packets)
+{
+  if (m_packetCost.IsZero ())
+    {
+      return Simulator::Now ();
+    }
+  // Partial batches are charged in proportion, since the stack coalesces
+  // the bytes of consecutive writes and reads.
+  Time cost = Seconds (packets * m_packetCost.GetSeconds ());
+  m_busyUntil = std::max (m_busyUntil, Simulator::Now ()) + cost;
+  m_busyTime += cost;
+  return m_busyUntil;
+}
+
+} // namespace ns3
@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HOST_COST_H
+#define HOST_COST_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/node.h"
+
+namespace ns3 {
+
+/**
+ * \brief CPU cost of the network stack of a host.
+ *
+ * Every packet a host sends or receives costs PacketCost of CPU time,
+ * and the host processes one packet at a time.  With segmentation
+ * offload (Tso) the NIC cuts OffloadSize bytes into segments, so the CPU
+ * pays once per OffloadSize bytes sent instead of once per SegmentSize
+ * bytes; receive offload (Gro) does the same for received bytes.
+ *
+ * The applications of a node share one instance, aggregated to the node
+ * by Get.  With the default PacketCost of zero nothing is charged.
+ */
+class HostCost : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  HostCost ();
+  virtual ~HostCost ();
+
+  /**
+   * \return the instance aggregated to node, created with the attribute
+   *         defaults on first use
+   */
+  static Ptr<HostCost> Get (Ptr<Node> node);
+
+  /**
+   * \param mss bytes an application writes at once without offload
+   * \return bytes an application writes at once
+   */
+  uint32_t GetWriteSize (uint32_t mss) const;
+
+  /**
+   * Charge the CPU for sending bytes.
+   *
+   * \return the time the CPU is done with them
+   */
+  Time Send (uint32_t bytes);
+
+  /**
+   * Charge the CPU for receiving bytes.
+   *
+   * \return the time the CPU is done with them
+   */
+  Time Receive (uint32_t bytes);
+
+  /**
+   * \return the CPU time charged so far
+   */
+  Time GetBusyTime (void) const;
+
+private:
+  Time Charge (double packets);
+
+  Time m_packetCost;
+  uint32_t m_segmentSize;
+  bool m_tso;
+  bool m_gro;
+  uint32_t m_offloadSize;
+
+  Time m_busyUntil; //!< When the CPU is done with the packets so far
+  Time m_busyTime;
+};
+
+} // namespace ns3
+
+#endif /* HOST_COST_H */
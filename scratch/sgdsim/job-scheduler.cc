@@ -0,0 +1,456 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/callback.h"
+#include "ns3/application-container.h"
+#include "parameter-server-helper.h"
+#include "delay-trace.h"
+#include "run-summary.h"
+#include "job-scheduler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("JobScheduler");
+
+static const uint16_t FIRST_JOB_PORT = 1000;
+
+JobScheduler::JobScheduler (Policy policy, std::string prefix)
+  : m_policy (policy),
+    m_prefix (prefix),
+    m_summary (0),
+    m_numRacks (0),
+    m_nextServerNum (0),
+    m_nextWorkerNum (0)
+{
+}
+
+JobScheduler::Policy
+JobScheduler::ParsePolicy (std::string name)
+{
+  if (name == "packing")
+    {
+      return PACKING;
+    }
+  if (name == "spreading")
+    {
+      return SPREADING;
+    }
+  if (name == "network")
+    {
+      return NETWORK_AWARE;
+    }
+  NS_FATAL_ERROR ("Unknown scheduler policy " << name);
+  return PACKING;
+}
+
+void
+JobScheduler::AddHost (int rack, Ptr<Node> node, Ipv4Address address)
+{
+  Host host;
+  host.rack = rack;
+  host.node = node;
+  host.address = address;
+  host.busy = false;
+  m_hosts.push_back (host);
+  m_numRacks = std::max (m_numRacks, rack + 1);
+}
+
+void
+JobScheduler::SetFluidNetwork (Ptr<FluidNetwork> network)
+{
+  m_fluid = network;
+}
+
+void
+JobScheduler::SetRunSummary (RunSummary* summary)
+{
+  m_summary = summary;
+}
+
+void
+JobScheduler::LoadTrace (std::string filename)
+{
+  std::ifstream input (filename.c_str ());
+  if (!input.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open job trace " << filename);
+    }
+
+  std::string line;
+  int number = 0;
+  while (std::getline (input, line))
+    {
+      number++;
+      std::istringstream fields (line.substr (0, line.find ('#')));
+      double arrival;
+      Job job;
+      if (!(fields >> arrival))
+        {
+          continue;
+        }
+      if (!(fields >> job.servers >> job.workers >> job.iterations)
+          || job.servers == 0 || job.workers == 0 || job.iterations == 0)
+        {
+          NS_FATAL_ERROR (filename << ":" << number << ": expected arrival servers workers iterations [name]");
+        }
+      if (!(fields >> job.name))
+        {
+          std::ostringstream name;
+          name << "job" << m_jobs.size ();
+          job.name = name.str ();
+        }
+      if (job.servers * (1 + job.workers) > m_hosts.size ())
+        {
+          NS_FATAL_ERROR ("Job " << job.name << " needs more hosts than the cluster has");
+        }
+      job.arrival = Seconds (arrival);
+      job.started = false;
+      job.finished = false;
+      job.serversLeft = job.servers;
+      job.iterationsDone = 0;
+      m_jobs.push_back (job);
+      Simulator::Schedule (job.arrival, &JobScheduler::Arrive, this, m_jobs.size () - 1);
+    }
+  NS_ASSERT_MSG (m_jobs.size () < (uint32_t) (65536 - FIRST_JOB_PORT), "Too many jobs to give each a port");
+}
+
+void
+JobScheduler::Arrive (uint32_t job)
+{
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": " << m_jobs[job].name << " arrives");
+  m_queue.push_back (job);
+  Schedule ();
+}
+
+void
+JobScheduler::Schedule ()
+{
+  while (!m_queue.empty ())
+    {
+      std::vector<uint32_t> hosts;
+      if (!Place (m_jobs[m_queue.front ()], hosts))
+        {
+          return;
+        }
+      uint32_t job = m_queue.front ();
+      m_queue.pop_front ();
+      Start (job, hosts);
+    }
+}
+
+std::vector<std::vector<uint32_t> >
+JobScheduler::FreeHostsByRack () const
+{
+  std::vector<std::vector<uint32_t> > free (m_numRacks);
+  for (uint32_t i = 0; i != m_hosts.size (); i++)
+    {
+      if (!m_hosts[i].busy)
+        {
+          free[m_hosts[i].rack].push_back (i);
+        }
+    }
+  return free;
+}
+
+/**
+ * \return the rack with the most hosts left, the first one on ties
+ */
+static int
+FullestRack (const std::vector<std::vector<uint32_t> >& free)
+{
+  int best = 0;
+  for (size_t r = 1; r < free.size (); r++)
+    {
+      if (free[r].size () > free[best].size ())
+        {
+          best = r;
+        }
+    }
+  return best;
+}
+
+bool
+JobScheduler::Place (const Job& job, std::vector<uint32_t>& hosts) const
+{
+  std::vector<std::vector<uint32_t> > free = FreeHostsByRack ();
+  uint32_t available = 0;
+  for (size_t r = 0; r != free.size (); r++)
+    {
+      available += free[r].size ();
+    }
+  uint32_t groupSize = 1 + job.workers;
+  if (available < job.servers * groupSize)
+    {
+      return false;
+    }
+
+  hosts.clear ();
+  switch (m_policy)
+    {
+    case PACKING:
+      for (size_t r = 0; r != free.size () && hosts.size () < job.servers * groupSize; r++)
+        {
+          for (size_t i = 0; i != free[r].size () && hosts.size () < job.servers * groupSize; i++)
+            {
+              hosts.push_back (free[r][i]);
+            }
+        }
+      break;
+
+    case SPREADING:
+      while (hosts.size () < job.servers * groupSize)
+        {
+          std::vector<uint32_t>& rack = free[FullestRack (free)];
+          hosts.push_back (rack.front ());
+          rack.erase (rack.begin ());
+        }
+      break;
+
+    case NETWORK_AWARE:
+      for (uint32_t s = 0; s != job.servers; s++)
+        {
+          // Best fit: the rack with the fewest free hosts that still holds
+          // the whole group, or else as few of the fullest racks as possible.
+          int best = -1;
+          for (size_t r = 0; r != free.size (); r++)
+            {
+              if (free[r].size () >= groupSize && (best < 0 || free[r].size () < free[best].size ()))
+                {
+                  best = r;
+                }
+            }
+          for (uint32_t placed = 0; placed != groupSize; placed++)
+            {
+              std::vector<uint32_t>& rack = free[best >= 0 ? best : FullestRack (free)];
+              hosts.push_back (rack.front ());
+              rack.erase (rack.begin ());
+            }
+        }
+      break;
+    }
+  return true;
+}
+
+void
+JobScheduler::Start (uint32_t index, const std::vector<uint32_t>& hosts)
+{
+  Job& job = m_jobs[index];
+  job.start = Simulator::Now ();
+  job.started = true;
+  job.hosts = hosts;
+  uint16_t port = FIRST_JOB_PORT + index;
+  NS_LOG_INFO (job.start.GetSeconds () << ": " << job.name << " starts after waiting "
+               << (job.start - job.arrival).GetSeconds () << "s");
+
+  uint32_t groupSize = 1 + job.workers;
+  for (uint32_t s = 0; s != job.servers; s++)
+    {
+      uint32_t serverNum = m_nextServerNum++;
+      m_serverJobs[serverNum] = index;
+      const Host& serverHost = m_hosts[hosts[s * groupSize]];
+
+      ParameterServerHelper server (port);
+      server.SetAttribute ("NumWorkers", UintegerValue (job.workers));
+      server.SetAttribute ("ServerNum", UintegerValue (serverNum));
+      server.SetAttribute ("MaxIterations", UintegerValue (job.iterations));
+      // Replayed delay traces start at a different point for every server
+      // and worker, so that their stragglers do not line up.
+      server.SetAttribute ("TraceOffset", DoubleValue (DelayTrace::GetOffset (serverNum)));
+      if (m_fluid != 0)
+        {
+          server.SetAttribute ("FluidNetwork", PointerValue (m_fluid));
+        }
+      ApplicationContainer serverApps = server.Install (serverHost.node);
+      serverApps.Start (Seconds (0.0));
+      serverApps.Get (0)->TraceConnectWithoutContext ("Broadcast", MakeCallback (&JobScheduler::Broadcast, this));
+      serverApps.Get (0)->TraceConnectWithoutContext ("Finished", MakeCallback (&JobScheduler::Finished, this));
+      if (m_summary != 0)
+        {
+          m_summary->Connect (serverApps.Get (0));
+        }
+      m_hosts[hosts[s * groupSize]].busy = true;
+
+      for (uint32_t w = 0; w != job.workers; w++)
+        {
+          uint32_t host = hosts[s * groupSize + 1 + w];
+          ParameterClientHelper client (serverHost.address, port);
+          client.SetAttribute ("ClientNum", UintegerValue (w));
+          client.SetAttribute ("ServerNum", UintegerValue (serverNum));
+          client.SetAttribute ("TraceOffset", DoubleValue (DelayTrace::GetOffset (m_nextWorkerNum++)));
+          if (m_fluid != 0)
+            {
+              client.SetAttribute ("FluidNetwork", PointerValue (m_fluid));
+            }
+          ApplicationContainer clientApps = client.Install (m_hosts[host].node);
+          clientApps.Start (Seconds (0.0));
+          m_hosts[host].busy = true;
+        }
+    }
+}
+
+void
+JobScheduler::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  if (iteration > 0)
+    {
+      m_jobs[m_serverJobs[serverNum]].iterationsDone++;
+    }
+}
+
+void
+JobScheduler::Finished (uint32_t serverNum, uint32_t iteration)
+{
+  Job& job = m_jobs[m_serverJobs[serverNum]];
+  job.iterationsDone++;
+  if (--job.serversLeft > 0)
+    {
+      return;
+    }
+
+  job.finish = Simulator::Now ();
+  job.finished = true;
+  NS_LOG_INFO (job.finish.GetSeconds () << ": " << job.name << " finishes after "
+               << (job.finish - job.arrival).GetSeconds () << "s");
+  for (size_t i = 0; i != job.hosts.size (); i++)
+    {
+      m_hosts[job.hosts[i]].busy = false;
+    }
+  if (GetCompletedJobCount () == m_jobs.size ())
+    {
+      Simulator::Stop ();
+      return;
+    }
+  Schedule ();
+}
+
+uint32_t
+JobScheduler::GetJobCount () const
+{
+  return m_jobs.size ();
+}
+
+uint32_t
+JobScheduler::GetCompletedJobCount () const
+{
+  uint32_t completed = 0;
+  for (size_t i = 0; i != m_jobs.size (); i++)
+    {
+      completed += m_jobs[i].finished ? 1 : 0;
+    }
+  return completed;
+}
+
+double
+JobScheduler::GetMeanCompletionTime () const
+{
+  double sum = 0.0;
+  uint32_t n = 0;
+  for (size_t i = 0; i != m_jobs.size (); i++)
+    {
+      if (m_jobs[i].finished)
+        {
+          sum += (m_jobs[i].finish - m_jobs[i].arrival).GetSeconds ();
+          n++;
+        }
+    }
+  return n > 0 ? sum / n : 0.0;
+}
+
+double
+JobScheduler::GetMeanQueueingTime () const
+{
+  double sum = 0.0;
+  uint32_t n = 0;
+  for (size_t i = 0; i != m_jobs.size (); i++)
+    {
+      if (m_jobs[i].started)
+        {
+          sum += (m_jobs[i].start - m_jobs[i].arrival).GetSeconds ();
+          n++;
+        }
+    }
+  return n > 0 ? sum / n : 0.0;
+}
+
+void
+JobScheduler::Report ()
+{
+  std::string filename = m_prefix + "-jobs.csv";
+  std::ofstream output (filename.c_str ());
+  if (!output.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  output << "job,servers,workers,iterations,arrival,start,finish,queueing_time,completion_time,iterations_done,racks" << std::endl;
+
+  uint64_t iterations = 0;
+  Time makespan;
+  for (size_t i = 0; i != m_jobs.size (); i++)
+    {
+      const Job& job = m_jobs[i];
+      if (job.finished)
+        {
+          makespan = std::max (makespan, job.finish);
+        }
+      std::set<int> racks;
+      for (size_t h = 0; h != job.hosts.size (); h++)
+        {
+          racks.insert (m_hosts[job.hosts[h]].rack);
+        }
+      iterations += job.iterationsDone;
+
+      output << job.name << "," << job.servers << "," << job.workers << "," << job.iterations
+             << "," << job.arrival.GetSeconds () << ",";
+      if (job.started)
+        {
+          output << job.start.GetSeconds ();
+        }
+      output << ",";
+      if (job.finished)
+        {
+          output << job.finish.GetSeconds ();
+        }
+      output << ",";
+      if (job.started)
+        {
+          output << (job.start - job.arrival).GetSeconds ();
+        }
+      output << ",";
+      if (job.finished)
+        {
+          output << (job.finish - job.arrival).GetSeconds ();
+        }
+      output << "," << job.iterationsDone << "," << racks.size () << std::endl;
+    }
+
+  double elapsed = Simulator::Now ().GetSeconds ();
+  std::cout << GetCompletedJobCount () << " of " << m_jobs.size () << " jobs completed, mean completion time "
+            << GetMeanCompletionTime () << "s, mean queueing time " << GetMeanQueueingTime () << "s, makespan "
+            << makespan.GetSeconds () << "s, "
+            << (elapsed > 0 ? iterations / elapsed : 0.0) << " server iterations/s over the cluster" << std::endl;
+}
+
+} // namespace ns3
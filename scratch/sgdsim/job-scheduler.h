@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include "ns3/nstime.h"
+#include "ns3/node.h"
+#include "ns3/ipv4-address.h"
+#include "fluid-network.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class RunSummary;
+
+/**
+ * \brief Runs a trace of training jobs on a shared cluster.
+ *
+ * A job is a number of parameter servers, each with its own workers, that
+ * runs a fixed number of iterations.  Jobs arrive as given by the trace,
+ * wait in a FIFO queue until the policy finds free hosts for all of their
+ * applications (one application per host), run, and release their hosts
+ * once every server has aggregated its last iteration.  The applications
+ * of a job are installed when it starts and each job listens on its own
+ * port, so finished jobs leave idle applications behind but never
+ * interfere with later ones.  The simulation stops once every job of the
+ * trace finished.
+ *
+ * Policies:
+ *  - packing: first free hosts in rack order
+ *  - spreading: one host per rack in turn, racks with most free hosts first
+ *  - network: each server with its workers in the fullest rack that still
+ *    fits them, so that pushes and pulls stay below the top of rack
+ *
+ * Trace lines are "arrival servers workers iterations [name]", with the
+ * arrival in seconds and workers per server; '#' starts a comment.
+ */
+class JobScheduler
+{
+public:
+  enum Policy
+  {
+    PACKING,
+    SPREADING,
+    NETWORK_AWARE
+  };
+
+  /**
+   * \param policy the placement policy
+   * \param prefix prefix of the output files
+   */
+  JobScheduler (Policy policy, std::string prefix);
+
+  /**
+   * \param name packing, spreading or network
+   */
+  static Policy ParsePolicy (std::string name);
+
+  /**
+   * Make a host available to jobs.
+   */
+  void AddHost (int rack, Ptr<Node> node, Ipv4Address address);
+
+  /**
+   * Run the applications over a flow-level network instead of TCP.
+   */
+  void SetFluidNetwork (Ptr<FluidNetwork> network);
+
+  /**
+   * Count the iterations of every server in a summary, connected as the
+   * jobs start.
+   */
+  void SetRunSummary (RunSummary* summary);
+
+  /**
+   * Read a job trace and schedule the arrival of its jobs.
+   */
+  void LoadTrace (std::string filename);
+
+  /**
+   * Print a summary and write one line per job to "<prefix>-jobs.csv".
+   */
+  void Report ();
+
+  uint32_t GetJobCount () const;
+  uint32_t GetCompletedJobCount () const;
+  double GetMeanCompletionTime () const;
+  double GetMeanQueueingTime () const;
+
+private:
+  struct Host
+  {
+    int rack;
+    Ptr<Node> node;
+    Ipv4Address address;
+    bool busy;
+  };
+
+  struct Job
+  {
+    std::string name;
+    uint32_t servers;
+    uint32_t workers;
+    uint32_t iterations;
+    Time arrival;
+    Time start;
+    Time finish;
+    bool started;
+    bool finished;
+    uint32_t serversLeft;
+    uint64_t iterationsDone;
+    std::vector<uint32_t> hosts; //!< server first, then its workers, for every server
+  };
+
+  void Arrive (uint32_t job);
+
+  /// Start queued jobs, in order, for as long as the head of the queue fits.
+  void Schedule ();
+
+  /**
+   * \param job the job
+   * \param hosts set to the hosts of the job, in Job::hosts order
+   * \return false if the job does not fit on the free hosts
+   */
+  bool Place (const Job& job, std::vector<uint32_t>& hosts) const;
+
+  void Start (uint32_t job, const std::vector<uint32_t>& hosts);
+
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+  void Finished (uint32_t serverNum, uint32_t iteration);
+
+  std::vector<std::vector<uint32_t> > FreeHostsByRack () const;
+
+  Policy m_policy;
+  std::string m_prefix;
+  Ptr<FluidNetwork> m_fluid;
+  RunSummary* m_summary;
+
+  std::vector<Host> m_hosts;
+  int m_numRacks;
+
+  std::vector<Job> m_jobs;
+  std::deque<uint32_t> m_queue;
+  std::map<uint32_t, uint32_t> m_serverJobs; //!< server number -> job
+  uint32_t m_nextServerNum;
+  uint32_t m_nextWorkerNum; //!< Workers of all jobs so far
+};
+
+} // namespace ns3
+
+#endif /* JOB_SCHEDULER_H */
@@ -0,0 +1,264 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/queue.h"
+#include "ns3/csma-channel.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "link-monitor.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LinkMonitor");
+
+LinkMonitor::LinkMonitor (Time interval, std::string prefix, uint32_t topN)
+  : m_interval (interval),
+    m_prefix (prefix),
+    m_topN (topN),
+    m_samples (0),
+    m_serverPort (0)
+{
+}
+
+void
+LinkMonitor::AddLink (std::string name, std::string tier, NetDeviceContainer devices)
+{
+  NS_ASSERT (devices.GetN () == 2);
+
+  LinkState link;
+  link.name = name;
+  link.tier = tier;
+  link.totalBytes = 0;
+  link.peakUtilization = 0.0;
+
+  Ptr<CsmaChannel> channel = DynamicCast<CsmaChannel> (devices.Get (0)->GetChannel ());
+  NS_ASSERT_MSG (channel != 0, "LinkMonitor only supports CSMA links");
+  link.bitRate = channel->GetDataRate ().GetBitRate ();
+
+  size_t index = m_links.size ();
+  for (uint32_t i = 0; i != 2; i++)
+    {
+      DeviceState& end = link.ends[i];
+      end.device = DynamicCast<CsmaNetDevice> (devices.Get (i));
+      end.txBytes = 0;
+      end.peakQueueBytes = 0;
+      end.queueBytesSum = 0;
+
+      std::ostringstream context;
+      context << 2 * index + i;
+      end.device->TraceConnect ("PhyTxEnd", context.str (),
+                                MakeCallback (&LinkMonitor::PhyTxEnd, this));
+    }
+  m_links.push_back (link);
+}
+
+void
+LinkMonitor::EnableFlowMonitor (uint16_t serverPort)
+{
+  m_serverPort = serverPort;
+  m_flowMonitor = m_flowHelper.InstallAll ();
+}
+
+void
+LinkMonitor::Start (Time start)
+{
+  std::string filename = m_prefix + "-links.csv";
+  m_series.open (filename.c_str ());
+  if (!m_series.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  m_series << "time,link,tier,end,node,tx_bytes,utilization,queue_packets,queue_bytes" << std::endl;
+
+  m_start = start;
+  m_lastSample = start;
+  m_sampleEvent = Simulator::Schedule (start - Simulator::Now (), &LinkMonitor::Tick, this);
+}
+
+void
+LinkMonitor::Tick ()
+{
+  Sample ();
+  m_sampleEvent = Simulator::Schedule (m_interval, &LinkMonitor::Tick, this);
+}
+
+void
+LinkMonitor::PhyTxEnd (std::string context, Ptr<const Packet> packet)
+{
+  size_t index = std::strtoul (context.c_str (), 0, 10);
+  m_links[index / 2].ends[index % 2].txBytes += packet->GetSize ();
+}
+
+void
+LinkMonitor::Sample ()
+{
+  Time now = Simulator::Now ();
+  double dt = (now - m_lastSample).GetSeconds ();
+
+  if (dt > 0)
+    {
+      for (size_t i = 0; i != m_links.size (); i++)
+        {
+          LinkState& link = m_links[i];
+          uint64_t bytes = link.ends[0].txBytes + link.ends[1].txBytes;
+          double utilization = bytes * 8.0 / (link.bitRate * dt);
+          link.totalBytes += bytes;
+          link.peakUtilization = std::max (link.peakUtilization, utilization);
+
+          for (uint32_t e = 0; e != 2; e++)
+            {
+              DeviceState& end = link.ends[e];
+              Ptr<Queue<Packet> > queue = end.device->GetQueue ();
+              uint32_t queueBytes = queue->GetNBytes ();
+              end.peakQueueBytes = std::max (end.peakQueueBytes, queueBytes);
+              end.queueBytesSum += queueBytes;
+
+              m_series << now.GetSeconds () << "," << link.name << "," << link.tier << ","
+                       << e << "," << end.device->GetNode ()->GetId () << ","
+                       << end.txBytes << "," << utilization << ","
+                       << queue->GetNPackets () << "," << queueBytes << "\n";
+              end.txBytes = 0;
+            }
+        }
+      m_samples++;
+      m_lastSample = now;
+    }
+}
+
+void
+LinkMonitor::WriteFlows (std::ostream &os)
+{
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (m_flowHelper.GetClassifier ());
+  const FlowMonitor::FlowStatsContainer& stats = m_flowMonitor->GetFlowStats ();
+
+  os << "flow,kind,source,destination,tx_bytes,rx_bytes,first_tx,last_rx,completion,mean_delay,lost_packets" << std::endl;
+  for (FlowMonitor::FlowStatsContainer::const_iterator it = stats.begin (); it != stats.end (); ++it)
+    {
+      Ipv4FlowClassifier::FiveTuple tuple = classifier->FindFlow (it->first);
+      const FlowMonitor::FlowStats& flow = it->second;
+
+      const char* kind = "other";
+      if (tuple.destinationPort == m_serverPort)
+        {
+          kind = "push";
+        }
+      else if (tuple.sourcePort == m_serverPort)
+        {
+          kind = "pull";
+        }
+
+      double meanDelay = 0.0;
+      if (flow.rxPackets > 0)
+        {
+          meanDelay = flow.delaySum.GetSeconds () / flow.rxPackets;
+        }
+
+      os << it->first << "," << kind << ","
+         << tuple.sourceAddress << ":" << tuple.sourcePort << ","
+         << tuple.destinationAddress << ":" << tuple.destinationPort << ","
+         << flow.txBytes << "," << flow.rxBytes << ","
+         << flow.timeFirstTxPacket.GetSeconds () << ","
+         << flow.timeLastRxPacket.GetSeconds () << ","
+         << (flow.timeLastRxPacket - flow.timeFirstTxPacket).GetSeconds () << ","
+         << meanDelay << "," << flow.lostPackets << "\n";
+    }
+}
+
+static bool
+CompareUtilization (const std::pair<double, size_t>& a, const std::pair<double, size_t>& b)
+{
+  return a.first > b.first;
+}
+
+uint64_t
+LinkMonitor::GetTotalBytes (std::string name) const
+{
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      if (m_links[i].name == name)
+        {
+          return m_links[i].totalBytes;
+        }
+    }
+  return 0;
+}
+
+void
+LinkMonitor::Report ()
+{
+  Simulator::Cancel (m_sampleEvent);
+  Sample ();
+  m_series.close ();
+
+  if (m_flowMonitor != 0)
+    {
+      m_flowMonitor->CheckForLostPackets ();
+      std::string filename = m_prefix + "-flows.csv";
+      std::ofstream flows (filename.c_str ());
+      WriteFlows (flows);
+    }
+
+  double elapsed = (m_lastSample - m_start).GetSeconds ();
+  if (elapsed <= 0)
+    {
+      return;
+    }
+
+  std::vector<std::pair<double, size_t> > ranking;
+  std::map<std::string, std::pair<double, uint32_t> > tiers;
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      const LinkState& link = m_links[i];
+      double utilization = link.totalBytes * 8.0 / (link.bitRate * elapsed);
+      ranking.push_back (std::make_pair (utilization, i));
+      tiers[link.tier].first += utilization;
+      tiers[link.tier].second++;
+    }
+  std::sort (ranking.begin (), ranking.end (), CompareUtilization);
+
+  std::string filename = m_prefix + "-hotlinks.txt";
+  std::ofstream summary (filename.c_str ());
+  std::ostringstream os;
+  os << "Hottest links over " << elapsed << "s (" << m_samples << " samples):" << std::endl;
+  for (size_t r = 0; r != ranking.size () && r != m_topN; r++)
+    {
+      const LinkState& link = m_links[ranking[r].second];
+      uint32_t peakQueue = std::max (link.ends[0].peakQueueBytes, link.ends[1].peakQueueBytes);
+      double meanQueue = std::max (link.ends[0].queueBytesSum, link.ends[1].queueBytesSum) / (double) m_samples;
+      os << "  " << r + 1 << ". " << link.name << " (" << link.tier << ")"
+         << " mean utilization " << ranking[r].first
+         << ", peak " << link.peakUtilization
+         << ", mean queue " << meanQueue << "B"
+         << ", peak queue " << peakQueue << "B" << std::endl;
+    }
+  os << "Mean utilization per tier:" << std::endl;
+  for (std::map<std::string, std::pair<double, uint32_t> >::const_iterator it = tiers.begin (); it != tiers.end (); ++it)
+    {
+      os << "  " << it->first << ": " << it->second.first / it->second.second
+         << " over " << it->second.second << " links" << std::endl;
+    }
+
+  summary << os.str ();
+  std::cout << os.str ();
+}
+
+} // namespace ns3
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/packet.h"
+#include "ns3/net-device-container.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/flow-monitor-helper.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Samples transmitted bytes and queue depth of every registered
+ *        device at a fixed interval.
+ *
+ * Each link is a CSMA channel shared by its two devices, so the
+ * utilization of a link is the bytes put on the wire by either end
+ * divided by what the channel could carry in the interval.  Samples are
+ * streamed to "<prefix>-links.csv" as they are taken; only running
+ * aggregates are kept in memory for the final hottest-links ranking.
+ *
+ * Optionally a FlowMonitor is installed on every IP node so the
+ * per-flow completion time of the gradient pushes (destination port =
+ * server port) and parameter pulls (source port = server port) can be
+ * written to "<prefix>-flows.csv".
+ */
+class LinkMonitor
+{
+public:
+  /**
+   * \param interval time between two samples
+   * \param prefix prefix of the output files
+   * \param topN number of links listed in the hottest links summary
+   */
+  LinkMonitor (Time interval, std::string prefix, uint32_t topN);
+
+  /**
+   * Register a link.  Both devices must be CsmaNetDevices attached to
+   * the same channel.
+   *
+   * \param name name of the link used in the reports
+   * \param tier tier of the fabric the link belongs to ("host", "uplink")
+   * \param devices the devices at both ends of the link
+   */
+  void AddLink (std::string name, std::string tier, NetDeviceContainer devices);
+
+  /**
+   * Install a FlowMonitor on all nodes with an IP stack.
+   *
+   * \param serverPort port the parameter servers listen on; used to tell
+   *                   pushes from pulls
+   */
+  void EnableFlowMonitor (uint16_t serverPort);
+
+  /**
+   * Schedule the first sample.
+   *
+   * \param start time of the first sample
+   */
+  void Start (Time start);
+
+  /**
+   * Take a last sample, write the flow statistics and print the top-N
+   * hottest links.  Must be called after Simulator::Run ().
+   */
+  void Report ();
+
+  /**
+   * \param name name of a registered link
+   * \return the bytes it carried up to the last sample, 0 for an
+   *         unknown link
+   */
+  uint64_t GetTotalBytes (std::string name) const;
+
+private:
+  struct DeviceState
+  {
+    Ptr<CsmaNetDevice> device;
+    uint64_t txBytes;        //!< bytes sent since the last sample
+    uint32_t peakQueueBytes; //!< largest queue occupancy sampled
+    uint64_t queueBytesSum;  //!< sum of the sampled queue occupancies
+  };
+
+  struct LinkState
+  {
+    std::string name;
+    std::string tier;
+    uint64_t bitRate;        //!< channel capacity in bit/s
+    DeviceState ends[2];
+    uint64_t totalBytes;     //!< bytes carried over the whole run
+    double peakUtilization;  //!< largest utilization of a single interval
+  };
+
+  void Tick ();
+
+  void Sample ();
+
+  void PhyTxEnd (std::string context, Ptr<const Packet> packet);
+
+  void WriteFlows (std::ostream &os);
+
+  Time m_interval;
+  std::string m_prefix;
+  uint32_t m_topN;
+
+  std::vector<LinkState> m_links;
+  std::ofstream m_series;
+  EventId m_sampleEvent;
+  Time m_start;
+  Time m_lastSample;
+  uint64_t m_samples;
+
+  FlowMonitorHelper m_flowHelper;
+  Ptr<FlowMonitor> m_flowMonitor;
+  uint16_t m_serverPort;
+};
+
+} // namespace ns3
+
+#endif /* LINK_MONITOR_H */
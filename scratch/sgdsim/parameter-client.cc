@@ -26,16 +26,24 @@
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/tcp-socket-base.h"
+#include "ns3/node-list.h"
+#include "ns3/ipv4.h"
 #include "parameter-client.h"
+#include "parameter-server.h"
+#include "event-trace.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <fstream>
 #include <vector>
 #include <cstdlib>
 #include <iostream>
-#include <chrono>
-#include <random>
 
 
 namespace ns3 {
@@ -71,6 +79,12 @@ ParameterClient::GetTypeId (void)
                    UintegerValue (97490),
                    MakeUintegerAccessor (&ParameterClient::m_parameterUpdateSize),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("JoinTransferSize",
+                   "Size of the first parameter update, the full model, as "
+                   "ParameterServer::JoinTransferSize; 0 for ParameterUpdateSize",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterClient::m_joinTransferSize),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("GradientUpdateSize",
                    "GradientUpdateSize",
                    UintegerValue (97490),
@@ -86,6 +100,128 @@ ParameterClient::GetTypeId (void)
                   UintegerValue(0),
                   MakeUintegerAccessor(&ParameterClient::m_serverNum),
                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute ("ComputeTimeMean",
+                   "Mean of the normally distributed compute time of an iteration, in seconds",
+                   DoubleValue (0.6383/4.0),
+                   MakeDoubleAccessor (&ParameterClient::m_computeTimeMean),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ComputeTimeStdDev",
+                   "Standard deviation of the compute time of an iteration, in seconds",
+                   DoubleValue (0.2673/4.0),
+                   MakeDoubleAccessor (&ParameterClient::m_computeTimeStdDev),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("MinComputeTime",
+                   "Lower bound on the compute time of an iteration, in seconds",
+                   DoubleValue (0.05),
+                   MakeDoubleAccessor (&ParameterClient::m_minComputeTime),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ComputeModel",
+                   "Compute time model: normal (ComputeTimeMean and ComputeTimeStdDev for every GPU) "
+                   "or trace (ComputeTrace replayed in order, one step of the whole host per delay)",
+                   StringValue ("normal"),
+                   MakeStringAccessor (&ParameterClient::m_computeModel),
+                   MakeStringChecker ())
+    .AddAttribute ("ComputeTrace",
+                   "File of per-iteration compute times in seconds for the trace model",
+                   StringValue ("gradient_delay_data.txt"),
+                   MakeStringAccessor (&ParameterClient::m_computeTraceFile),
+                   MakeStringChecker ())
+    .AddAttribute ("TraceWarmup",
+                   "Leading compute times of ComputeTrace played once at the start",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&ParameterClient::m_traceWarmup),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TraceOffset",
+                   "Where the replay of ComputeTrace starts after the warmup, as a fraction of its length",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&ParameterClient::m_traceOffset),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("TraceBlock",
+                   "Block length of the circular block bootstrap of ComputeTrace, 0 to replay it in order",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterClient::m_traceBlock),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("LocalSteps",
+                   "Number of compute steps between two exchanges with the server (local SGD)",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&ParameterClient::m_localSteps),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("AdaptiveLocalSteps",
+                   "Pick the number of local steps from the observed sync time so that "
+                   "syncing takes TargetSyncShare of the time; LocalSteps is the first choice",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&ParameterClient::m_adaptiveLocalSteps),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxLocalSteps",
+                   "Upper bound on the adaptive number of local steps",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&ParameterClient::m_maxLocalSteps),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TargetSyncShare",
+                   "Share of time spent syncing with the server that adaptive local steps aim for",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&ParameterClient::m_targetSyncShare),
+                   MakeDoubleChecker<double> (0.001, 0.999))
+    .AddAttribute ("Pacing",
+                   "How gradient pushes are paced against incast at the server: none, rate "
+                   "(token bucket), slots (staggered by ClientNum) or credit (receiver-driven grants, "
+                   "which needs ParameterServer::CreditWindow > 0 and the same CreditSize and ControlSize)",
+                   StringValue ("none"),
+                   MakeStringAccessor (&ParameterClient::m_pacing),
+                   MakeStringChecker ())
+    .AddAttribute ("PacingRate",
+                   "Token bucket rate of the rate pacing",
+                   DataRateValue (DataRate ("2Mbps")),
+                   MakeDataRateAccessor (&ParameterClient::m_pacingRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("PacingBurst",
+                   "Token bucket depth of the rate pacing, in bytes",
+                   UintegerValue (14600),
+                   MakeUintegerAccessor (&ParameterClient::m_pacingBurst),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SlotDuration",
+                   "Length of a send slot; worker ClientNum starts its push no earlier than "
+                   "ClientNum slots after it received the parameter update",
+                   TimeValue (MilliSeconds (80)),
+                   MakeTimeAccessor (&ParameterClient::m_slotDuration),
+                   MakeTimeChecker ())
+    .AddAttribute ("CreditSize",
+                   "Bytes granted by one credit message of the server, as ParameterServer::CreditSize",
+                   UintegerValue (14600),
+                   MakeUintegerAccessor (&ParameterClient::m_creditSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ControlSize",
+                   "Size of a credit request or grant message, as ParameterServer::ControlSize",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&ParameterClient::m_controlSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("FluidNetwork",
+                   "Flow-level network to exchange updates over instead of a TCP socket",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterClient::m_fluid),
+                   MakePointerChecker<FluidNetwork> ())
+    .AddAttribute ("Coflows",
+                   "Coflow scheduler that sets the priority of the gradient update bytes, if any",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterClient::m_coflows),
+                   MakePointerChecker<CoflowScheduler> ())
+    .AddAttribute ("AccuracyModel",
+                   "Model told the local steps and GPUs behind every gradient update, if any",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterClient::m_accuracy),
+                   MakePointerChecker<AccuracyModel> ())
+    .AddTraceSource ("Connected",
+                     "The connection to the server has been established",
+                     MakeTraceSourceAccessor (&ParameterClient::m_connectedTrace),
+                     "ns3::ParameterClient::ConnectedTracedCallback")
+    .AddTraceSource ("ParameterReceived",
+                     "A parameter update has been fully received",
+                     MakeTraceSourceAccessor (&ParameterClient::m_parameterReceivedTrace),
+                     "ns3::ParameterClient::IterationTracedCallback")
+    .AddTraceSource ("PushStart",
+                     "The gradient update push has started",
+                     MakeTraceSourceAccessor (&ParameterClient::m_pushStartTrace),
+                     "ns3::ParameterClient::IterationTracedCallback")
   ;
   return tid;
 }
@@ -94,10 +230,25 @@ ParameterClient::ParameterClient ()
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_fluidConnection = 0;
   m_sendEvent = EventId ();
 
   this->recv_bytes_left = 0;
   this->send_bytes_left = 0;
+  m_iteration = 0;
+  m_syncTime = -1.0;
+  m_stepsDone = 0;
+  m_pushSteps = 0;
+  m_bytesExchanged = 0;
+  m_pacingMode = PACING_NONE;
+  m_tokens = 0;
+  m_requestBytesLeft = 0;
+  m_grantBytesLeft = 0;
+  m_bytesGranted = 0;
+  m_creditBytes = 0;
+  m_retransmits = 0;
+  m_departed = false;
+  m_computeTime = CreateObject<NormalRandomVariable> ();
 }
 
 ParameterClient::~ParameterClient()
@@ -121,6 +272,48 @@ ParameterClient::SetRemote (Address addr)
   m_peerAddress = addr;
 }
 
+uint64_t
+ParameterClient::GetLocalSteps (void) const
+{
+  return m_stepsDone;
+}
+
+uint64_t
+ParameterClient::GetBytesExchanged (void) const
+{
+  return m_bytesExchanged;
+}
+
+uint64_t
+ParameterClient::GetRetransmits (void) const
+{
+  return m_retransmits;
+}
+
+void
+ParameterClient::Fail (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " of Server #" << m_serverNum << " fails");
+  m_departed = true;
+  Simulator::Cancel (m_sendEvent);
+  Simulator::Cancel (m_paceEvent);
+  if (m_socket != 0)
+    {
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t > ());
+    }
+}
+
+void
+ParameterClient::Leave (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " of Server #" << m_serverNum << " leaves");
+  m_departed = true;
+  StopApplication ();
+}
+
 void
 ParameterClient::DoDispose (void)
 {
@@ -133,27 +326,100 @@ ParameterClient::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
 
+  if (m_pacing == "none")
+    {
+      m_pacingMode = PACING_NONE;
+    }
+  else if (m_pacing == "rate")
+    {
+      m_pacingMode = PACING_RATE;
+    }
+  else if (m_pacing == "slots")
+    {
+      m_pacingMode = PACING_SLOTS;
+    }
+  else if (m_pacing == "credit")
+    {
+      m_pacingMode = PACING_CREDIT;
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown pacing " << m_pacing);
+    }
+  // Credit requests and grants are in the byte stream, so both sides
+  // have to agree on them.
+  Ptr<ParameterServer> server;
+  if (m_fluid == 0)
+    {
+      server = FindServer ();
+    }
+  if (server != 0)
+    {
+      bool credit = m_pacingMode == PACING_CREDIT;
+      if (credit != (server->GetCreditWindow () > 0))
+        {
+          NS_FATAL_ERROR ("Worker " << m_clientNum << " of server " << m_serverNum << " uses " << m_pacing
+                          << " pacing but the server's CreditWindow is " << server->GetCreditWindow ()
+                          << "; ParameterClient::Pacing=credit needs ParameterServer::CreditWindow > 0 and vice versa");
+        }
+      if (credit && (server->GetCreditSize () != m_creditSize || server->GetControlSize () != m_controlSize))
+        {
+          NS_FATAL_ERROR ("Worker " << m_clientNum << " of server " << m_serverNum << " has CreditSize " << m_creditSize
+                          << " and ControlSize " << m_controlSize << " but the server " << server->GetCreditSize ()
+                          << " and " << server->GetControlSize ());
+        }
+    }
+  if (m_computeModel == "trace")
+    {
+      // Only drawn from with a bootstrap, so that replaying in order
+      // leaves the random streams of the other variables as they were.
+      Ptr<UniformRandomVariable> position;
+      if (m_traceBlock > 0)
+        {
+          position = CreateObject<UniformRandomVariable> ();
+        }
+      m_computeTrace.Load (m_computeTraceFile, m_traceWarmup);
+      m_computeTrace.Start (m_traceOffset, m_traceBlock, position);
+    }
+  else if (m_computeModel != "normal")
+    {
+      NS_FATAL_ERROR ("Unknown compute model " << m_computeModel);
+    }
+  // Slots only delay the start of a push, which the flow model can do too.
+  if (m_fluid != 0 && m_pacingMode != PACING_NONE && m_pacingMode != PACING_SLOTS)
+    {
+      NS_FATAL_ERROR ("Pacing " << m_pacing << " needs the packet-level network");
+    }
+  m_host = HostCost::Get (GetNode ());
+  m_gpus = GpuHost::Get (GetNode ());
+  m_tokens = m_pacingBurst;
+  m_tokenTime = Simulator::Now ();
+  m_grantBytesLeft = m_controlSize;
+
+  if (m_fluid != 0)
+    {
+      this->recv_bytes_left = m_joinTransferSize > 0 ? m_joinTransferSize : this->m_parameterUpdateSize;
+      EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_CONNECT_REQUEST, 0);
+      m_fluidConnection = m_fluid->Connect (GetNode (), m_peerAddress, m_peerPort,
+                                            MakeCallback (&ParameterClient::FluidConnected, this),
+                                            MakeCallback (&ParameterClient::FluidReceive, this));
+      return;
+    }
+
   if (m_socket == 0)
     {
       TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
       m_socket = Socket::CreateSocket (GetNode (), tid);
 
-      this->recv_bytes_left = this->m_parameterUpdateSize;
-
-      std::ifstream ifile("gradient_delay_data.txt");
-
-      if (!ifile.is_open()) {
-          //NS_LOG_INFO("There was a problem opening the input file!");
-          exit(1);
-      }
-
-      double num = 0.0;
-      while (ifile >> num) {
-          this->delay_distribution.push_back(num);
-      }
+      this->recv_bytes_left = m_joinTransferSize > 0 ? m_joinTransferSize : this->m_parameterUpdateSize;
 
+      m_socket->SetConnectCallback (MakeCallback (&ParameterClient::ConnectionSucceeded, this),
+                                    MakeCallback (&ParameterClient::ConnectionFailed, this));
       m_socket->SetRecvCallback (MakeCallback (&ParameterClient::ReceiveParameterUpdate, this));
       m_socket->SetSendCallback (MakeCallback (&ParameterClient::ContinueGradientUpdate, this));
+      m_socket->SetCloseCallbacks (MakeCallback (&ParameterClient::HandleServerClose, this),
+                                   MakeCallback (&ParameterClient::HandleServerClose, this));
+      m_socket->TraceConnectWithoutContext ("Tx", MakeCallback (&ParameterClient::SocketTx, this));
 
       if (Ipv4Address::IsMatchingType(m_peerAddress) == true)
         {
@@ -161,7 +427,7 @@ ParameterClient::StartApplication (void)
             {
               NS_FATAL_ERROR ("Failed to bind socket");
             }
-          //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " made a connection request to Server #" << m_serverNum);
+          EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_CONNECT_REQUEST, 0);
           m_socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom(m_peerAddress), m_peerPort));
         }
       else if (InetSocketAddress::IsMatchingType (m_peerAddress) == true)
@@ -180,10 +446,79 @@ ParameterClient::StartApplication (void)
 
 }
 
+void
+ParameterClient::ConnectionSucceeded (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  Address local;
+  socket->GetSockName (local);
+  EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_CONNECTED, 0);
+  m_connectedTrace (m_serverNum, m_clientNum, local);
+}
+
+void
+ParameterClient::ConnectionFailed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_LOG_WARN ("Client #" << m_clientNum << " failed to connect to Server #" << m_serverNum);
+}
+
+void
+ParameterClient::HandleServerClose (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  if (m_departed)
+    {
+      return;
+    }
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " removed Client #" << m_clientNum);
+  m_departed = true;
+  StopApplication ();
+}
+
+void
+ParameterClient::FluidConnected (uint32_t connection)
+{
+  NS_LOG_FUNCTION (this << connection);
+  EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_CONNECTED, 0);
+  m_connectedTrace (m_serverNum, m_clientNum, m_fluid->GetClientAddress (connection));
+}
+
+void
+ParameterClient::FluidReceive (uint32_t connection, Time sent)
+{
+  NS_LOG_FUNCTION (this << connection << sent);
+  EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_PARAMETER_RECV, this->recv_bytes_left);
+  this->recv_bytes_left = 0;
+  this->ParameterUpdateReceived ();
+}
+
+void
+ParameterClient::SocketTx (Ptr<const Packet> packet, const TcpHeader& header, Ptr<const TcpSocketBase> socket)
+{
+  if (packet->GetSize () == 0)
+    {
+      return;
+    }
+  // A data segment below the highest sequence sent so far is a retransmission.
+  if (header.GetSequenceNumber () < m_highestTxSeq)
+    {
+      m_retransmits++;
+    }
+  else
+    {
+      m_highestTxSeq = header.GetSequenceNumber () + packet->GetSize ();
+    }
+}
+
 void
 ParameterClient::ReceiveParameterUpdate (Ptr<Socket> socket)
 {
-    assert (this->recv_bytes_left > 0);
+    // Between two parameter updates the server only sends credit grants.
+    if (this->recv_bytes_left == 0) {
+        this->ReceiveCredit();
+        return;
+    }
 
     Ptr<Packet> packet;
     while (packet = m_socket->Recv(this->recv_bytes_left, 0)) {
@@ -191,27 +526,135 @@ ParameterClient::ReceiveParameterUpdate (Ptr<Socket> socket)
         if (size == 0) {
             break;
         }
+        EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_PARAMETER_RECV, size);
+        Time done = m_host->Receive (size);
         this->recv_bytes_left -= size;
         if (this->recv_bytes_left == 0) {
-            //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " received parameter update from Server #" << m_serverNum);
-            this->send_bytes_left = this->m_gradientUpdateSize;
-            // int rand_index = rand() % this->delay_distribution.size();
-            // double rand_delay = this->delay_distribution[rand_index];
-            // this->ScheduleGradientUpdate(Seconds(rand_delay));
-
-            unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-            std::default_random_engine generator (seed);
-            std::normal_distribution<double> distribution (0.6383/4.0,0.2673/4.0);
-            double delay = distribution(generator);
-            if (delay < 0.05) {
-              delay = 0.05;
+            // The update is there once the host CPU processed all of it.
+            if (done > Simulator::Now ()) {
+                Simulator::Schedule (done - Simulator::Now (), &ParameterClient::ParameterUpdateReceived, this);
+            } else {
+                this->ParameterUpdateReceived();
             }
-            this->ScheduleGradientUpdate(Seconds(delay));
             return;
         }
     }
 }
 
+void
+ParameterClient::ParameterUpdateReceived (void)
+{
+    if (m_departed) {
+        return;
+    }
+    EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_PARAMETER_RECEIVED, m_iteration);
+    m_parameterReceivedTrace (m_serverNum, m_clientNum, m_iteration);
+    this->send_bytes_left = this->m_gradientUpdateSize;
+
+    m_bytesExchanged += m_parameterUpdateSize;
+    if (m_iteration > 0) {
+        double syncTime = (Simulator::Now () - m_pushStart).GetSeconds ();
+        m_syncTime = m_syncTime < 0 ? syncTime : 0.75 * m_syncTime + 0.25 * syncTime;
+    }
+
+    // Local SGD: run several steps on the local model before the next push.
+    // This worker is the leader of the GPUs of its host: it broadcasts the
+    // parameters to them, every step waits for the slowest one, and their
+    // gradients are reduced to it between steps and before the push.
+    uint32_t steps = this->NextLocalSteps ();
+    double delay = m_gpus->Broadcast (m_parameterUpdateSize).GetSeconds ();
+    for (uint32_t i = 0; i != steps; i++) {
+        double slowest = 0.0;
+        if (m_computeTrace.IsLoaded ()) {
+            // The recording is the step of the whole host.
+            slowest = m_computeTrace.Next ();
+        } else {
+            for (uint32_t g = 0; g != m_gpus->GetGpus (); g++) {
+                double step = m_computeTime->GetValue (m_computeTimeMean, m_computeTimeStdDev * m_computeTimeStdDev);
+                slowest = std::max (slowest, std::max (step, m_minComputeTime));
+            }
+        }
+        delay += slowest;
+        if (i + 1 != steps) {
+            delay += (m_gpus->Reduce (m_gradientUpdateSize) + m_gpus->Broadcast (m_parameterUpdateSize)).GetSeconds ();
+        }
+    }
+    delay += m_gpus->Reduce (m_gradientUpdateSize).GetSeconds ();
+    m_stepsDone += steps;
+    m_pushSteps = steps;
+    // Staggered pushes: every worker owns the ClientNum-th slot after the
+    // parameter update.
+    if (m_pacingMode == PACING_SLOTS) {
+        delay = std::max (delay, m_clientNum * m_slotDuration.GetSeconds ());
+    }
+    this->ScheduleGradientUpdate(Seconds(delay));
+}
+
+void
+ParameterClient::ReceiveCredit (void)
+{
+    assert (m_pacingMode == PACING_CREDIT);
+
+    Ptr<Packet> packet;
+    while ((packet = m_socket->Recv(m_grantBytesLeft, 0))) {
+        uint32_t size = packet->GetSize();
+        if (size == 0) {
+            break;
+        }
+        m_grantBytesLeft -= size;
+        if (m_grantBytesLeft == 0) {
+            m_grantBytesLeft = m_controlSize;
+            uint32_t grant = std::min (m_creditSize, m_gradientUpdateSize - m_bytesGranted);
+            m_bytesGranted += grant;
+            m_creditBytes += grant;
+        }
+    }
+    this->ContinueGradientUpdate(m_socket, m_socket->GetTxAvailable());
+}
+
+Ptr<ParameterServer>
+ParameterClient::FindServer (void) const
+{
+  if (!Ipv4Address::IsMatchingType (m_peerAddress))
+    {
+      return 0;
+    }
+  Ipv4Address address = Ipv4Address::ConvertFrom (m_peerAddress);
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      Ptr<Ipv4> ipv4 = (*node)->GetObject<Ipv4> ();
+      bool local = false;
+      for (uint32_t i = 0; ipv4 != 0 && i != ipv4->GetNInterfaces (); i++)
+        {
+          for (uint32_t j = 0; j != ipv4->GetNAddresses (i); j++)
+            {
+              local = local || ipv4->GetAddress (i, j).GetLocal () == address;
+            }
+        }
+      for (uint32_t i = 0; local && i != (*node)->GetNApplications (); i++)
+        {
+          Ptr<ParameterServer> server = DynamicCast<ParameterServer> ((*node)->GetApplication (i));
+          if (server != 0 && server->GetPort () == m_peerPort)
+            {
+              return server;
+            }
+        }
+    }
+  return 0;
+}
+
+uint32_t
+ParameterClient::NextLocalSteps (void) const
+{
+  if (!m_adaptiveLocalSteps || m_syncTime < 0 || m_computeTimeMean <= 0)
+    {
+      return m_localSteps;
+    }
+  // Syncing takes m_syncTime / (steps * compute + m_syncTime) of the time.
+  double steps = m_syncTime * (1.0 - m_targetSyncShare) / (m_targetSyncShare * m_computeTimeMean);
+  return std::min<double> (m_maxLocalSteps, std::max (1.0, std::ceil (steps)));
+}
+
 void
 ParameterClient::ScheduleGradientUpdate (Time dt)
 {
@@ -222,40 +665,125 @@ ParameterClient::ScheduleGradientUpdate (Time dt)
 void
 ParameterClient::SendGradientUpdate ()
 {
-    //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " sends gradient update to Server #" << m_serverNum);
+    if (m_departed) {
+        return;
+    }
+    EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_PUSH_START, m_iteration);
+    m_pushStartTrace (m_serverNum, m_clientNum, m_iteration);
+    m_pushStart = Simulator::Now ();
+    if (m_accuracy != 0) {
+        m_accuracy->AddPush(m_serverNum, m_pushSteps, m_gpus->GetGpus());
+    }
+    if (m_fluid != 0) {
+        m_fluid->Send(m_fluidConnection, true, this->send_bytes_left);
+        EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_GRADIENT_SEND, this->send_bytes_left);
+        this->send_bytes_left = 0;
+        this->GradientUpdateSent();
+        return;
+    }
+    if (m_pacingMode == PACING_CREDIT) {
+        // Ask the server for credit; it grants the update piece by piece.
+        m_requestBytesLeft = m_controlSize;
+        m_bytesGranted = 0;
+        m_creditBytes = 0;
+    }
     this->ContinueGradientUpdate(this->m_socket, this->m_socket->GetTxAvailable());
 }
 
+void
+ParameterClient::ResumeGradientUpdate (void)
+{
+    this->ContinueGradientUpdate(this->m_socket, this->m_socket->GetTxAvailable());
+}
+
+Time
+ParameterClient::PacingDelay (uint32_t bytes)
+{
+    double rate = m_pacingRate.GetBitRate () / 8.0;
+    m_tokens = std::min<double> (m_tokens + rate * (Simulator::Now () - m_tokenTime).GetSeconds (),
+                                 std::max (m_pacingBurst, bytes));
+    m_tokenTime = Simulator::Now ();
+    if (m_tokens >= bytes || rate <= 0) {
+        return Seconds (0);
+    }
+    return Seconds ((bytes - m_tokens) / rate);
+}
+
 void
 ParameterClient::ContinueGradientUpdate(Ptr<Socket> socket, uint32_t ready)
 {
+    // The pacing or host CPU timer resumes the push.
+    if (m_paceEvent.IsRunning ()) {
+        return;
+    }
+
     uint32_t to_send;
     int actual;
     do {
-        to_send = this->m_mtu - 40;
+        // A credit request goes out ahead of the update.
+        bool request = m_requestBytesLeft > 0;
+        uint32_t left = request ? m_requestBytesLeft : this->send_bytes_left;
+        if (!request && m_pacingMode == PACING_CREDIT) {
+            left = std::min (left, m_creditBytes);
+        }
+
+        to_send = m_host->GetWriteSize (this->m_mtu - 40);
         if (to_send > ready) {
             to_send = ready;
         }
-        if (to_send > this->send_bytes_left) {
-            to_send = this->send_bytes_left;
+        if (to_send > left) {
+            to_send = left;
         }
 
         if (to_send == 0 || this->recv_bytes_left > 0) {
             break;
         }
 
+        if (!request && m_pacingMode == PACING_RATE) {
+            Time wait = this->PacingDelay(to_send);
+            if (!wait.IsZero ()) {
+                m_paceEvent = Simulator::Schedule (wait, &ParameterClient::ResumeGradientUpdate, this);
+                break;
+            }
+        }
+
         Ptr<Packet> packet = Create<Packet> (to_send);
+        if (!request && m_coflows != 0) {
+            m_coflows->Tag (packet, CoflowScheduler::GetCoflow (m_serverNum, true));
+        }
         actual = socket->Send(packet);
-        if (actual > 0) {
+        if (actual > 0 && request) {
+            m_requestBytesLeft -= actual;
+        } else if (actual > 0) {
+            if (m_pacingMode == PACING_RATE) {
+                m_tokens -= actual;
+            } else if (m_pacingMode == PACING_CREDIT) {
+                m_creditBytes -= actual;
+            }
+            EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_GRADIENT_SEND, actual);
             this->send_bytes_left -= actual;
             if (this->send_bytes_left == 0) {
-                //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Client #" << m_clientNum << " finishes up gradient update");
-                this->recv_bytes_left = this->m_parameterUpdateSize;
+                this->GradientUpdateSent();
+            }
+            // Hand the next bytes to the stack once the CPU is done with these.
+            Time done = m_host->Send (actual);
+            if (done > Simulator::Now ()) {
+                m_paceEvent = Simulator::Schedule (done - Simulator::Now (), &ParameterClient::ResumeGradientUpdate, this);
+                break;
             }
         }
     } while (actual == (int) to_send);
 }
 
+void
+ParameterClient::GradientUpdateSent (void)
+{
+    EventTrace::Record (EventTrace::ClientId (m_serverNum, m_clientNum), EventTrace::CLIENT_PUSH_SENT, m_iteration);
+    m_bytesExchanged += m_gradientUpdateSize;
+    this->recv_bytes_left = this->m_parameterUpdateSize;
+    m_iteration++;
+}
+
 void
 ParameterClient::StopApplication ()
 {
@@ -269,6 +797,7 @@ ParameterClient::StopApplication ()
     }
 
   Simulator::Cancel (m_sendEvent);
+  Simulator::Cancel (m_paceEvent);
 }
 
 } // Namespace ns3
@@ -25,12 +25,24 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/traced-callback.h"
 #include "ns3/tcp-socket-base.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+#include "ns3/tcp-header.h"
+#include "fluid-network.h"
+#include "host-cost.h"
+#include "coflow.h"
+#include "gpu-host.h"
+#include "accuracy-model.h"
+#include "delay-trace.h"
+#include <string>
 #include <vector>
 
 namespace ns3 {
 
 class Socket;
 class Packet;
+class ParameterServer;
 
 /**
  * \ingroup Parameter
@@ -63,6 +75,52 @@ public:
    */
   void SetRemote (Address addr);
 
+  /**
+   * TracedCallback signature for the connection of a worker.
+   *
+   * \param [in] serverNum the number of the server
+   * \param [in] clientNum the number of the client
+   * \param [in] local the address of the client's socket
+   */
+  typedef void (* ConnectedTracedCallback)(uint32_t serverNum, uint32_t clientNum, const Address& local);
+
+  /**
+   * TracedCallback signature for per-iteration worker events.
+   *
+   * \param [in] serverNum the number of the server
+   * \param [in] clientNum the number of the client
+   * \param [in] iteration the iteration the event belongs to
+   */
+  typedef void (* IterationTracedCallback)(uint32_t serverNum, uint32_t clientNum, uint32_t iteration);
+
+  /**
+   * \return the number of local compute steps so far
+   */
+  uint64_t GetLocalSteps (void) const;
+
+  /**
+   * \return the bytes of gradient updates pushed and parameter updates
+   *         pulled so far
+   */
+  uint64_t GetBytesExchanged (void) const;
+
+  /**
+   * \return the TCP segments of gradient updates sent more than once
+   */
+  uint64_t GetRetransmits (void) const;
+
+  /**
+   * Stop without closing the connection, as a preempted host does; the
+   * server only notices when its barrier times out.
+   */
+  void Fail (void);
+
+  /**
+   * Leave gracefully by closing the connection, which the server takes
+   * as a departure.
+   */
+  void Leave (void);
+
 protected:
   virtual void DoDispose (void);
 
@@ -77,24 +135,126 @@ private:
 
   void ReceiveParameterUpdate (Ptr<Socket> socket);
 
+  void ParameterUpdateReceived (void);
+
+  void GradientUpdateSent (void);
+
+  void FluidConnected (uint32_t connection);
+
+  void FluidReceive (uint32_t connection, Time sent);
+
   void ScheduleGradientUpdate (Time dt);
 
+  /// Number of local steps before the next push.
+  uint32_t NextLocalSteps (void) const;
+
+  /// \return the ParameterServer at the peer address and port, if any
+  Ptr<ParameterServer> FindServer (void) const;
+
+  /// Read credit grants from the server while a push is in progress.
+  void ReceiveCredit (void);
+
+  /// Continue a push held back by the token bucket or the host CPU.
+  void ResumeGradientUpdate (void);
+
+  /**
+   * Refill the token bucket.
+   *
+   * \param bytes size of the next segment
+   * \return the time until the bucket holds bytes tokens
+   */
+  Time PacingDelay (uint32_t bytes);
+
+  void SocketTx (Ptr<const Packet> packet, const TcpHeader& header, Ptr<const TcpSocketBase> socket);
+
+  void ConnectionSucceeded (Ptr<Socket> socket);
+
+  void ConnectionFailed (Ptr<Socket> socket);
+
+  /**
+   * The server closed the connection, having presumed this worker failed.
+   */
+  void HandleServerClose (Ptr<Socket> socket);
+
   uint32_t recv_bytes_left;
   uint32_t send_bytes_left;
 
-  std::vector<double> delay_distribution;
-
   uint32_t m_sent; //!< Counter for sent packets
+  Ptr<HostCost> m_host; //!< CPU cost of the network stack
+  Ptr<GpuHost> m_gpus; //!< GPUs this worker stands for
   Ptr<Socket> m_socket; //!< Socket
+  Ptr<FluidNetwork> m_fluid; //!< Flow-level network used instead of a socket, if any
+  uint32_t m_fluidConnection; //!< Connection over m_fluid
+  Ptr<CoflowScheduler> m_coflows; //!< Priorities of the pushes, if any
+  Ptr<AccuracyModel> m_accuracy; //!< Told the local steps of every push, if any
   Address m_peerAddress; //!< Remote peer address
   uint16_t m_peerPort; //!< Remote peer port
   EventId m_sendEvent; //!< Event to send the next packet
 
   uint32_t m_mtu;
   uint32_t m_parameterUpdateSize;
+  uint32_t m_joinTransferSize; //!< Size of the first parameter update, 0 for m_parameterUpdateSize
+  bool m_departed; //!< Left or failed, ignores the server from now on
   uint32_t m_gradientUpdateSize;
   uint32_t m_clientNum;
   uint32_t m_serverNum;
+
+  uint32_t m_iteration; //!< Number of the current iteration
+
+  Ptr<NormalRandomVariable> m_computeTime; //!< Compute time of an iteration
+  double m_computeTimeMean;
+  double m_computeTimeStdDev;
+  double m_minComputeTime;
+
+  std::string m_computeModel; //!< normal or trace
+  std::string m_computeTraceFile;
+  uint32_t m_traceWarmup;
+  double m_traceOffset;
+  uint32_t m_traceBlock;
+  DelayTrace m_computeTrace; //!< Compute times replayed with the trace model
+
+  uint32_t m_localSteps; //!< Compute steps between two pushes
+  bool m_adaptiveLocalSteps;
+  uint32_t m_maxLocalSteps;
+  double m_targetSyncShare; //!< Share of time spent syncing the adaptive steps aim for
+  double m_syncTime; //!< Smoothed time from push start to parameters received, negative before the first sync
+  Time m_pushStart;
+  uint64_t m_stepsDone; //!< Compute steps so far
+  uint32_t m_pushSteps; //!< Compute steps behind the next push
+  uint64_t m_bytesExchanged;
+
+  /// How a worker paces its gradient pushes.
+  enum PacingMode
+  {
+    PACING_NONE,   //!< Push as fast as TCP allows
+    PACING_RATE,   //!< Token bucket of PacingRate and PacingBurst
+    PACING_SLOTS,  //!< Start a push no earlier than the worker's send slot
+    PACING_CREDIT  //!< Only send bytes the server granted
+  };
+
+  std::string m_pacing;
+  PacingMode m_pacingMode;
+  DataRate m_pacingRate;
+  uint32_t m_pacingBurst; //!< Token bucket depth in bytes
+  double m_tokens;
+  Time m_tokenTime; //!< Last refill of the token bucket
+  EventId m_paceEvent;
+  Time m_slotDuration;
+  uint32_t m_creditSize; //!< Bytes granted by a credit message
+  uint32_t m_controlSize; //!< Size of a credit request or grant
+  uint32_t m_requestBytesLeft; //!< Credit request bytes not yet sent
+  uint32_t m_grantBytesLeft; //!< Bytes of the current grant not yet received
+  uint32_t m_bytesGranted; //!< Bytes of the current push granted so far
+  uint32_t m_creditBytes; //!< Granted bytes not yet sent
+  SequenceNumber32 m_highestTxSeq;
+  uint64_t m_retransmits;
+
+  /// Traced callback: connection to the server established.
+  TracedCallback<uint32_t, uint32_t, const Address&> m_connectedTrace;
+  /// Traced callback: parameter update fully received.
+  TracedCallback<uint32_t, uint32_t, uint32_t> m_parameterReceivedTrace;
+  /// Traced callback: gradient update push started.
+  TracedCallback<uint32_t, uint32_t, uint32_t> m_pushStartTrace;
 };
 
 } // namespace ns3
@@ -20,6 +20,8 @@
 #include "parameter-server-helper.h"
 #include "parameter-server.h"
 #include "parameter-client.h"
+#include "gossip-worker.h"
+#include "pipeline-stage.h"
 #include "ns3/uinteger.h"
 #include "ns3/names.h"
 #include "ns3/tcp-socket-base.h"
@@ -129,4 +131,50 @@ ParameterClientHelper::InstallPriv (Ptr<Node> node) const
   return app;
 }
 
+GossipWorkerHelper::GossipWorkerHelper (uint16_t port)
+{
+  m_factory.SetTypeId (GossipWorker::GetTypeId ());
+  SetAttribute ("Port", UintegerValue (port));
+}
+
+void
+GossipWorkerHelper::SetAttribute (
+  std::string name,
+  const AttributeValue &value)
+{
+  m_factory.Set (name, value);
+}
+
+ApplicationContainer
+GossipWorkerHelper::Install (Ptr<Node> node) const
+{
+  Ptr<Application> app = m_factory.Create<GossipWorker> ();
+  node->AddApplication (app);
+
+  return ApplicationContainer (app);
+}
+
+PipelineStageHelper::PipelineStageHelper (uint16_t port)
+{
+  m_factory.SetTypeId (PipelineStage::GetTypeId ());
+  SetAttribute ("Port", UintegerValue (port));
+}
+
+void
+PipelineStageHelper::SetAttribute (
+  std::string name,
+  const AttributeValue &value)
+{
+  m_factory.Set (name, value);
+}
+
+ApplicationContainer
+PipelineStageHelper::Install (Ptr<Node> node) const
+{
+  Ptr<Application> app = m_factory.Create<PipelineStage> ();
+  node->AddApplication (app);
+
+  return ApplicationContainer (app);
+}
+
 } // namespace ns3
@@ -176,6 +176,73 @@ private:
   ObjectFactory m_factory; //!< Object factory.
 };
 
+/**
+ * \ingroup Parameter
+ * \brief Create a worker of decentralized SGD; its neighbors are added to
+ *        the application with GossipWorker::AddNeighbor.
+ */
+class GossipWorkerHelper
+{
+public:
+  /**
+   * \param port The port the workers listen on and connect to
+   */
+  GossipWorkerHelper (uint16_t port);
+
+  /**
+   * Record an attribute to be set in each Application after it is is created.
+   *
+   * \param name the name of the attribute to set
+   * \param value the value of the attribute to set
+   */
+  void SetAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * Create a GossipWorker on the specified node.
+   *
+   * \param node The node on which to create the Application.
+   *
+   * \returns An ApplicationContainer holding the Application created.
+   */
+  ApplicationContainer Install (Ptr<Node> node) const;
+
+private:
+  ObjectFactory m_factory; //!< Object factory.
+};
+
+/**
+ * \ingroup Parameter
+ * \brief Create a stage of a pipeline-parallel model.
+ */
+class PipelineStageHelper
+{
+public:
+  /**
+   * \param port The port the stages listen on and connect to
+   */
+  PipelineStageHelper (uint16_t port);
+
+  /**
+   * Record an attribute to be set in each Application after it is is created.
+   *
+   * \param name the name of the attribute to set
+   * \param value the value of the attribute to set
+   */
+  void SetAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * Create a PipelineStage on the specified node.
+   *
+   * \param node The node on which to create the Application.
+   *
+   * \returns An ApplicationContainer holding the Application created.
+   */
+  ApplicationContainer Install (Ptr<Node> node) const;
+
+private:
+  ObjectFactory m_factory; //!< Object factory.
+};
+
 } // namespace ns3
 
 #endif /* UDP_ECHO_HELPER_H */
@@ -29,20 +29,22 @@
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/tcp-socket-base.h"
 
 //#include "seq-ts-header.h"
 #include "parameter-server.h"
+#include "event-trace.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
-#include <chrono>
-#include <random>
 #include <fstream>
 #include <vector>
 #include <cstdlib>
-#include <iostream>
-#include <chrono>
-#include <random>
 
 namespace ns3 {
 
@@ -87,6 +89,137 @@ ParameterServer::GetTypeId (void)
                   UintegerValue(0),
                   MakeUintegerAccessor(&ParameterServer::m_serverNum),
                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute ("AggregationTimeMean",
+                   "Mean of the normally distributed aggregation time of an iteration, in seconds",
+                   DoubleValue (0.612/4.0),
+                   MakeDoubleAccessor (&ParameterServer::m_aggregationTimeMean),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("AggregationTimeStdDev",
+                   "Standard deviation of the aggregation time of an iteration, in seconds",
+                   DoubleValue (0.0384/4.0),
+                   MakeDoubleAccessor (&ParameterServer::m_aggregationTimeStdDev),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("AggregationModel",
+                   "Aggregation time model: normal (AggregationTimeMean and AggregationTimeStdDev "
+                   "after the barrier) or resource (gradients summed on AggregationCores as they "
+                   "arrive, bound by SumRate and MemoryBandwidth, then an optimizer step) or trace "
+                   "(AggregationTrace replayed in order after the barrier)",
+                   StringValue ("normal"),
+                   MakeStringAccessor (&ParameterServer::m_aggregationModel),
+                   MakeStringChecker ())
+    .AddAttribute ("AggregationTrace",
+                   "File of per-iteration aggregation times in seconds for the trace model",
+                   StringValue ("aggregation_delay_data.txt"),
+                   MakeStringAccessor (&ParameterServer::m_aggregationTraceFile),
+                   MakeStringChecker ())
+    .AddAttribute ("TraceWarmup",
+                   "Leading aggregation times of AggregationTrace played once at the start",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterServer::m_traceWarmup),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TraceOffset",
+                   "Where the replay of AggregationTrace starts after the warmup, as a fraction of its length",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&ParameterServer::m_traceOffset),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("TraceBlock",
+                   "Block length of the circular block bootstrap of AggregationTrace, 0 to replay it in order",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterServer::m_traceBlock),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("AggregationCores",
+                   "Cores summing gradients with the resource model",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&ParameterServer::m_aggregationCores),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SumRate",
+                   "Gradient bytes one core sums per second with the resource model",
+                   DoubleValue (1e9),
+                   MakeDoubleAccessor (&ParameterServer::m_sumRate),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("MemoryBandwidth",
+                   "Memory bytes per second the cores share with the resource model; summing "
+                   "a byte reads two and writes one",
+                   DoubleValue (1e10),
+                   MakeDoubleAccessor (&ParameterServer::m_memoryBandwidth),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("Elastic",
+                   "Let workers join and leave after the first NumWorkers connected; every "
+                   "barrier waits for the workers that are members at its broadcast",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&ParameterServer::m_elastic),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FailureTimeout",
+                   "With Elastic, workers whose gradient is missing this long after a broadcast "
+                   "are presumed failed and removed, 0 to wait forever.  The server closes their "
+                   "connection, so a worker that was only slow stops as if it had left; over "
+                   "FluidNetwork it keeps computing and is ignored",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&ParameterServer::m_failureTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("JoinTransferSize",
+                   "Size of the first parameter update of a worker, the full model, "
+                   "as ParameterClient::JoinTransferSize; 0 for ParameterUpdateSize",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterServer::m_joinTransferSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CreditWindow",
+                   "Receiver-driven admission of gradient pushes: bytes granted to workers but "
+                   "not yet received, 0 to let the workers push freely; needs ParameterClient::Pacing=credit",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterServer::m_creditWindow),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CreditSize",
+                   "Bytes granted by one credit message",
+                   UintegerValue (14600),
+                   MakeUintegerAccessor (&ParameterServer::m_creditSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ControlSize",
+                   "Size of a credit request or grant message",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&ParameterServer::m_controlSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SketchCompression",
+                   "Compression of the quantile sketches of iteration, push and wait times",
+                   DoubleValue (200.0),
+                   MakeDoubleAccessor (&ParameterServer::m_sketchCompression),
+                   MakeDoubleChecker<double> (10.0))
+    .AddAttribute ("MaxIterations",
+                   "Number of iterations after which the server stops broadcasting, 0 for no limit",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ParameterServer::m_maxIterations),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FluidNetwork",
+                   "Flow-level network to exchange updates over instead of TCP sockets",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterServer::m_fluid),
+                   MakePointerChecker<FluidNetwork> ())
+    .AddAttribute ("Coflows",
+                   "Coflow scheduler that sets the priority of the parameter update bytes, if any",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterServer::m_coflows),
+                   MakePointerChecker<CoflowScheduler> ())
+    .AddAttribute ("AccuracyModel",
+                   "Model fed with every aggregated iteration to estimate the time to accuracy, if any",
+                   PointerValue (),
+                   MakePointerAccessor (&ParameterServer::m_accuracy),
+                   MakePointerChecker<AccuracyModel> ())
+    .AddTraceSource ("Broadcast",
+                     "A parameter update broadcast has started",
+                     MakeTraceSourceAccessor (&ParameterServer::m_broadcastTrace),
+                     "ns3::ParameterServer::IterationTracedCallback")
+    .AddTraceSource ("GradientReceived",
+                     "A worker's gradient update has been fully received",
+                     MakeTraceSourceAccessor (&ParameterServer::m_gradientReceivedTrace),
+                     "ns3::ParameterServer::WorkerTracedCallback")
+    .AddTraceSource ("Finished",
+                     "The last of MaxIterations iterations has been aggregated",
+                     MakeTraceSourceAccessor (&ParameterServer::m_finishedTrace),
+                     "ns3::ParameterServer::IterationTracedCallback")
+    .AddTraceSource ("Membership",
+                     "A worker joined, left or was presumed failed",
+                     MakeTraceSourceAccessor (&ParameterServer::m_membershipTrace),
+                     "ns3::ParameterServer::MembershipTracedCallback")
   ;
   return tid;
 }
@@ -95,7 +228,16 @@ ParameterServer::ParameterServer ()
 {
   NS_LOG_FUNCTION (this);
   this->workers_left = 0;
+  m_barrierSize = 0;
+  m_barrierDropped = 0;
+  m_started = false;
+  m_idle = false;
+  m_iteration = 0;
+  m_creditOutstanding = 0;
+  m_resourceModel = false;
+  m_aggregationBusy = 0.0;
   m_sendEvent = EventId ();
+  m_aggregationTime = CreateObject<NormalRandomVariable> ();
 }
 
 ParameterServer::~ParameterServer ()
@@ -110,28 +252,141 @@ ParameterServer::DoDispose (void)
   Application::DoDispose ();
 }
 
+uint32_t
+ParameterServer::GetServerNum (void) const
+{
+  return m_serverNum;
+}
+
+const TDigest&
+ParameterServer::GetIterationTimes (void) const
+{
+  return m_iterationTimes;
+}
+
+const TDigest&
+ParameterServer::GetPushLatencies (void) const
+{
+  return m_pushLatencies;
+}
+
+const TDigest&
+ParameterServer::GetWaitTimes (void) const
+{
+  return m_waitTimes;
+}
+
+const TDigest&
+ParameterServer::GetPushSpreads (void) const
+{
+  return m_pushSpreads;
+}
+
+const TDigest&
+ParameterServer::GetBarrierTimes (void) const
+{
+  return m_barrierTimes;
+}
+
+const TDigest&
+ParameterServer::GetAggregationTails (void) const
+{
+  return m_aggregationTails;
+}
+
+double
+ParameterServer::GetAggregationBusyTime (void) const
+{
+  return m_aggregationBusy;
+}
+
+uint32_t
+ParameterServer::GetAggregationCores (void) const
+{
+  return m_aggregationCores;
+}
+
+uint16_t
+ParameterServer::GetPort (void) const
+{
+  return m_port;
+}
+
+uint32_t
+ParameterServer::GetCreditWindow (void) const
+{
+  return m_creditWindow;
+}
+
+uint32_t
+ParameterServer::GetCreditSize (void) const
+{
+  return m_creditSize;
+}
+
+uint32_t
+ParameterServer::GetControlSize (void) const
+{
+  return m_controlSize;
+}
+
+uint32_t
+ParameterServer::GetMembers (void) const
+{
+  uint32_t members = 0;
+  for (size_t i = 0; i != this->worker_connections.size(); i++) {
+      members += this->worker_connections[i].departed ? 0 : 1;
+  }
+  return members;
+}
+
 void
 ParameterServer::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
 
+  if (m_aggregationModel != "normal" && m_aggregationModel != "resource" && m_aggregationModel != "trace")
+    {
+      NS_FATAL_ERROR ("Unknown aggregation model " << m_aggregationModel);
+    }
+  m_resourceModel = m_aggregationModel == "resource";
+  if (m_aggregationModel == "trace")
+    {
+      // Only drawn from with a bootstrap, as for ParameterClient.
+      Ptr<UniformRandomVariable> position;
+      if (m_traceBlock > 0)
+        {
+          position = CreateObject<UniformRandomVariable> ();
+        }
+      m_aggregationTrace.Load (m_aggregationTraceFile, m_traceWarmup);
+      m_aggregationTrace.Start (m_traceOffset, m_traceBlock, position);
+    }
+
+  m_iterationTimes = TDigest (m_sketchCompression);
+  m_pushLatencies = TDigest (m_sketchCompression);
+  m_waitTimes = TDigest (m_sketchCompression);
+  m_pushSpreads = TDigest (m_sketchCompression);
+  m_barrierTimes = TDigest (m_sketchCompression);
+  m_aggregationTails = TDigest (m_sketchCompression);
+  m_host = HostCost::Get (GetNode ());
+
+  if (m_fluid != 0)
+    {
+      if (m_creditWindow > 0)
+        {
+          NS_FATAL_ERROR ("Credit-based admission needs the packet-level network");
+        }
+      m_fluid->Listen (GetNode (), m_port, MakeCallback (&ParameterServer::FluidAccept, this),
+                       MakeCallback (&ParameterServer::FluidReceive, this));
+      return;
+    }
+
   if (m_socket == 0)
     {
       TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
       m_socket = DynamicCast<TcpSocket> (Socket::CreateSocket (GetNode (), tid));
       InetSocketAddress local = InetSocketAddress (Ipv4Address::GetAny (),
                                                    m_port);
-       std::ifstream ifile("aggregation_delay_data.txt");
-
-       if (!ifile.is_open()) {
-           //NS_LOG_INFO("There was a problem opening the input file!");
-           exit(1);
-       }
-
-       double num = 0.0;
-       while (ifile >> num) {
-           this->aggregation_distribution.push_back(num);
-       }
       m_socket->SetAcceptCallback (MakeCallback (&ParameterServer::HandleRequest, this), MakeCallback (&ParameterServer::HandleAccept, this));
       if (m_socket->Bind (local) == -1)
         {
@@ -144,42 +399,192 @@ ParameterServer::StartApplication (void)
 
 bool
 ParameterServer::HandleRequest(Ptr<Socket> socket, const Address& address) {
-    //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " gets a connection request");
+    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_CONNECT_REQUEST, 0);
     return true;
 }
 
 void
 ParameterServer::HandleAccept(Ptr<Socket> socket, const Address& address) {
-    //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " accepts a connection request");
-
     struct conn_state state;
     state.socket = socket;
+    state.fluid_connection = 0;
+    state.address = address;
     state.bytes_left_recv = 0;
     state.bytes_left_send = 0;
+    state.request_bytes_left = 0;
+    state.grant_bytes_left = 0;
+    state.bytes_granted = 0;
+    state.first = true;
+    state.pending = false;
+    state.departed = false;
 
     /* Attach callbacks to the socket. */
     socket->SetSendCallback(MakeCallback(&ParameterServer::ContinueParameterUpdate, this));
     socket->SetRecvCallback(MakeCallback(&ParameterServer::ReceiveGradientUpdate, this));
+    socket->SetCloseCallbacks(MakeCallback(&ParameterServer::HandlePeerClose, this),
+                              MakeCallback(&ParameterServer::HandlePeerClose, this));
 
+    this->AddWorker(state);
+}
+
+void
+ParameterServer::FluidAccept(uint32_t connection, const Address& address) {
+    struct conn_state state;
+    state.fluid_connection = connection;
+    state.address = address;
+    state.bytes_left_recv = 0;
+    state.bytes_left_send = 0;
+    state.request_bytes_left = 0;
+    state.grant_bytes_left = 0;
+    state.bytes_granted = 0;
+    state.first = true;
+    state.pending = false;
+    state.departed = false;
+
+    this->AddWorker(state);
+}
+
+void
+ParameterServer::AddWorker(struct conn_state state) {
     this->worker_connections.push_back(state);
-    if (this->worker_connections.size() == this->m_numWorkers) {
+    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_ACCEPT, this->worker_connections.size());
+    if (m_started) {
+        // A joining worker is part of the barriers from the next broadcast on.
+        assert (m_elastic);
+        NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Worker joins Server #" << m_serverNum);
+        m_membershipTrace (m_serverNum, this->GetMembers());
+        if (m_idle) {
+            m_idle = false;
+            this->SendParameterUpdate();
+        }
+    } else if (this->worker_connections.size() == this->m_numWorkers) {
+        m_started = true;
+        m_membershipTrace (m_serverNum, this->GetMembers());
         this->SendParameterUpdate();
     } else {
         assert (this->worker_connections.size() < this->m_numWorkers);
     }
 }
 
+void
+ParameterServer::HandlePeerClose(Ptr<Socket> socket) {
+    for (size_t i = 0; i != this->worker_connections.size(); i++) {
+        if (this->worker_connections[i].socket == socket && !this->worker_connections[i].departed) {
+            NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Worker leaves Server #" << m_serverNum);
+            this->RemoveWorker(i);
+            return;
+        }
+    }
+}
+
+void
+ParameterServer::RemoveWorker(size_t i) {
+    struct conn_state& worker = this->worker_connections[i];
+    worker.departed = true;
+    worker.bytes_left_send = 0;
+    worker.grant_bytes_left = 0;
+    worker.request_bytes_left = 0;
+    Simulator::Cancel (worker.resume_send);
+
+    // Return the credit granted to it.
+    std::deque<size_t>::iterator queued = std::find(m_creditQueue.begin(), m_creditQueue.end(), i);
+    if (queued != m_creditQueue.end()) {
+        m_creditQueue.erase(queued);
+    }
+    if (worker.pending && m_creditWindow > 0) {
+        uint32_t received = this->m_gradientUpdateSize - worker.bytes_left_recv;
+        m_creditOutstanding -= worker.bytes_granted > received ? worker.bytes_granted - received : 0;
+        this->GrantCredits();
+    }
+    worker.bytes_left_recv = 0;
+    m_membershipTrace (m_serverNum, this->GetMembers());
+
+    // Close the connection, so that a worker presumed failed that is only
+    // slow stops too instead of blocking on a gradient nobody reads.
+    if (m_fluid == 0 && worker.socket != 0) {
+        worker.socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket> >(), MakeNullCallback<void, Ptr<Socket> >());
+        worker.socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> >());
+        worker.socket->Close();
+    }
+
+    if (worker.pending) {
+        worker.pending = false;
+        m_barrierSize--;
+        m_barrierDropped++;
+        this->workers_left--;
+        if (this->workers_left == 0) {
+            this->CompleteIteration();
+        }
+    }
+}
+
+void
+ParameterServer::BarrierTimeout() {
+    for (size_t i = 0; i != this->worker_connections.size(); i++) {
+        if (this->worker_connections[i].pending) {
+            NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " presumes a worker failed");
+            this->RemoveWorker(i);
+        }
+    }
+}
+
 void
 ParameterServer::SendParameterUpdate() {
+    if (m_maxIterations > 0 && m_iteration >= m_maxIterations) {
+        m_finishedTrace (m_serverNum, m_iteration);
+        return;
+    }
+    if (this->GetMembers() == 0) {
+        // Wait for a worker to join.
+        m_idle = true;
+        return;
+    }
     NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " broadcasts parameter update");
-
-    this->workers_left = this->m_numWorkers;
+    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_BROADCAST, m_iteration);
+    m_broadcastTrace (m_serverNum, m_iteration);
+    if (m_iteration > 0) {
+        m_iterationTimes.Add ((Simulator::Now () - m_lastBroadcast).GetSeconds ());
+    }
+    m_lastBroadcast = Simulator::Now ();
+
+    // The barrier waits for the current members.
+    m_barrierSize = this->GetMembers();
+    m_barrierDropped = 0;
+    this->workers_left = m_barrierSize;
+    if (m_elastic && m_failureTimeout > Seconds (0)) {
+        m_timeoutEvent = Simulator::Schedule (m_failureTimeout, &ParameterServer::BarrierTimeout, this);
+    }
+    if (m_coflows != 0) {
+        uint64_t broadcast = 0;
+        for (size_t i = 0; i != this->worker_connections.size(); i++) {
+            if (!this->worker_connections[i].departed) {
+                broadcast += this->worker_connections[i].first && m_joinTransferSize > 0 ? m_joinTransferSize : this->m_parameterUpdateSize;
+            }
+        }
+        m_coflows->Start(CoflowScheduler::GetCoflow(m_serverNum, false), broadcast);
+        m_coflows->Start(CoflowScheduler::GetCoflow(m_serverNum, true), (uint64_t) m_barrierSize * this->m_gradientUpdateSize);
+    }
     for (size_t i = 0; i != this->worker_connections.size(); i++) {
         struct conn_state& worker = this->worker_connections[i];
-        worker.bytes_left_send = this->m_parameterUpdateSize;
+        if (worker.departed) {
+            continue;
+        }
+        worker.pending = true;
+        worker.bytes_left_send = worker.first && m_joinTransferSize > 0 ? m_joinTransferSize : this->m_parameterUpdateSize;
+        worker.first = false;
+        worker.bytes_granted = 0;
+
+        if (m_fluid != 0) {
+            m_fluid->Send(worker.fluid_connection, false, worker.bytes_left_send);
+            EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_PARAMETER_SEND, worker.bytes_left_send);
+            EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_PARAMETER_SENT,
+                                ((uint64_t) m_iteration << 32) | i);
+            worker.bytes_left_send = 0;
+            worker.bytes_left_recv = this->m_gradientUpdateSize;
+            continue;
+        }
 
         Ptr<Socket> socket = worker.socket;
-        //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " starts parameter update: " << i);
         this->ContinueParameterUpdate(socket, socket->GetTxAvailable());
     }
 }
@@ -191,15 +596,21 @@ ParameterServer::ContinueParameterUpdate(Ptr<Socket> socket, uint32_t ready) {
         struct conn_state& worker = this->worker_connections[i];
 
         if (worker.socket == socket) {
+            // The host CPU timer resumes the send.
+            if (worker.resume_send.IsRunning()) {
+                return;
+            }
             uint32_t to_send;
             int actual;
             do {
-                to_send = this->m_mtu - 40;
+                // Credit grants follow the parameter update.
+                bool grant = worker.bytes_left_send == 0;
+                to_send = m_host->GetWriteSize(this->m_mtu - 40);
                 if (to_send > ready) {
                     to_send = ready;
                 }
-                if (to_send > worker.bytes_left_send) {
-                    to_send = worker.bytes_left_send;
+                if (to_send > (grant ? worker.grant_bytes_left : worker.bytes_left_send)) {
+                    to_send = grant ? worker.grant_bytes_left : worker.bytes_left_send;
                 }
 
                 if (to_send == 0) {
@@ -207,12 +618,25 @@ ParameterServer::ContinueParameterUpdate(Ptr<Socket> socket, uint32_t ready) {
                 }
 
                 Ptr<Packet> packet = Create<Packet> (to_send);
+                if (!grant && m_coflows != 0) {
+                    m_coflows->Tag(packet, CoflowScheduler::GetCoflow(m_serverNum, false));
+                }
                 actual = socket->Send(packet);
-                if (actual > 0) {
+                if (actual > 0 && grant) {
+                    worker.grant_bytes_left -= actual;
+                } else if (actual > 0) {
+                    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_PARAMETER_SEND, actual);
                     worker.bytes_left_send -= actual;
                     if (worker.bytes_left_send == 0) {
-                        //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " finishes parameter update");
+                        EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_PARAMETER_SENT,
+                                            ((uint64_t) m_iteration << 32) | i);
                         worker.bytes_left_recv = this->m_gradientUpdateSize;
+                        worker.request_bytes_left = m_creditWindow > 0 ? m_controlSize : 0;
+                    }
+                    Time done = m_host->Send(actual);
+                    if (done > Simulator::Now ()) {
+                        worker.resume_send = Simulator::Schedule (done - Simulator::Now (), &ParameterServer::ResumeParameterUpdate, this, i);
+                        break;
                     }
                 }
             } while (actual == (int) to_send);
@@ -220,6 +644,12 @@ ParameterServer::ContinueParameterUpdate(Ptr<Socket> socket, uint32_t ready) {
     }
 }
 
+void
+ParameterServer::ResumeParameterUpdate(size_t i) {
+    Ptr<Socket> socket = this->worker_connections[i].socket;
+    this->ContinueParameterUpdate(socket, socket->GetTxAvailable());
+}
+
 void
 ParameterServer::ReceiveGradientUpdate(Ptr<Socket> socket) {
     // TODO: fix this inefficient scan
@@ -232,25 +662,37 @@ ParameterServer::ReceiveGradientUpdate(Ptr<Socket> socket) {
             }
 
             Ptr<Packet> packet;
-            while (packet = socket->Recv(worker.bytes_left_recv, 0)) {
+            while (packet = socket->Recv(worker.request_bytes_left > 0 ? worker.request_bytes_left : worker.bytes_left_recv, 0)) {
                 uint32_t size = packet->GetSize();
                 if (size == 0) {
                     break;
                 }
+                if (worker.request_bytes_left > 0) {
+                    worker.request_bytes_left -= size;
+                    if (worker.request_bytes_left == 0) {
+                        m_creditQueue.push_back(i);
+                        this->GrantCredits();
+                    }
+                    continue;
+                }
+                if (m_creditWindow > 0) {
+                    m_creditOutstanding -= size;
+                    this->GrantCredits();
+                }
+                if (worker.bytes_left_recv == this->m_gradientUpdateSize) {
+                    worker.push_start = Simulator::Now ();
+                }
+                EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_GRADIENT_RECV, size);
+                Time nicBusy = m_host->GetBusyTime();
+                Time done = m_host->Receive(size);
+                this->Aggregate(size, m_host->GetBusyTime() - nicBusy);
                 worker.bytes_left_recv -= size;
                 if (worker.bytes_left_recv == 0) {
-                    this->workers_left--;
-                    if (this->workers_left == 0) {
-                        //NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Server #" << m_serverNum << " received gradient update");
-
-                        // int rand_index = rand() % this->aggregation_distribution.size();
-                        // double rand_delay = this->aggregation_distribution[rand_index];
-                        // this->ScheduleParameterUpdate(Seconds(rand_delay));
-
-                        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-                        std::default_random_engine generator (seed);
-                        std::normal_distribution<double> distribution (0.612/4.0,0.0384/4.0);
-                        this->ScheduleParameterUpdate(Seconds(distribution(generator)));
+                    // The update is there once the host CPU processed all of it.
+                    if (done > Simulator::Now ()) {
+                        Simulator::Schedule (done - Simulator::Now (), &ParameterServer::GradientUpdateReceived, this, i);
+                    } else {
+                        this->GradientUpdateReceived(i);
                     }
                     return;
                 }
@@ -259,6 +701,124 @@ ParameterServer::ReceiveGradientUpdate(Ptr<Socket> socket) {
     }
 }
 
+void
+ParameterServer::FluidReceive(uint32_t connection, Time sent) {
+    for (size_t i = 0; i != this->worker_connections.size(); i++) {
+        struct conn_state& worker = this->worker_connections[i];
+
+        if (worker.fluid_connection == connection) {
+            EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_GRADIENT_RECV, worker.bytes_left_recv);
+            worker.push_start = sent;
+            this->Aggregate(worker.bytes_left_recv, Seconds (0));
+            worker.bytes_left_recv = 0;
+            this->GradientUpdateReceived(i);
+            return;
+        }
+    }
+}
+
+void
+ParameterServer::GradientUpdateReceived(size_t i) {
+    struct conn_state& worker = this->worker_connections[i];
+    // It may have been removed while the host CPU processed the update.
+    if (!worker.pending) {
+        return;
+    }
+    worker.pending = false;
+
+    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_GRADIENT_RECEIVED,
+                        ((uint64_t) m_iteration << 32) | i);
+    m_gradientReceivedTrace (m_serverNum, m_iteration, worker.address);
+    worker.push_end = Simulator::Now ();
+    m_pushLatencies.Add ((worker.push_end - worker.push_start).GetSeconds ());
+    if (this->workers_left == m_barrierSize) {
+        m_firstPushEnd = worker.push_end;
+    }
+    this->workers_left--;
+    if (this->workers_left == 0) {
+        this->CompleteIteration();
+    }
+}
+
+void
+ParameterServer::CompleteIteration() {
+    Simulator::Cancel (m_timeoutEvent);
+    // Workers that were removed sent nothing, and joined ones only take
+    // part from the next broadcast.
+    if (m_barrierSize > 0) {
+        m_pushSpreads.Add ((Simulator::Now () - m_firstPushEnd).GetSeconds ());
+    }
+    for (size_t j = 0; j != this->worker_connections.size(); j++) {
+        if (this->worker_connections[j].departed || this->worker_connections[j].first) {
+            continue;
+        }
+        m_waitTimes.Add ((Simulator::Now () - this->worker_connections[j].push_end).GetSeconds ());
+    }
+    EventTrace::Record (EventTrace::ServerId (m_serverNum), EventTrace::SERVER_AGGREGATE, m_iteration);
+    if (m_accuracy != 0) {
+        m_accuracy->AddIteration(m_serverNum, m_lastBroadcast, m_barrierSize, m_barrierDropped,
+                                 (double) this->m_parameterUpdateSize / std::max<uint32_t>(this->m_gradientUpdateSize, 1));
+    }
+    m_iteration++;
+
+    double delay;
+    if (m_resourceModel) {
+        // The sums overlap with receiving; what is left of them after
+        // the barrier, and the optimizer step, delay the broadcast.
+        Time applied = std::max (m_aggregationDone, Simulator::Now ()) + this->GetApplyTime();
+        m_aggregationBusy += this->GetApplyTime().GetSeconds () * m_aggregationCores;
+        m_aggregationDone = applied;
+        delay = (applied - Simulator::Now ()).GetSeconds ();
+    } else if (m_aggregationTrace.IsLoaded ()) {
+        delay = m_aggregationTrace.Next ();
+    } else {
+        delay = m_aggregationTime->GetValue (m_aggregationTimeMean, m_aggregationTimeStdDev * m_aggregationTimeStdDev);
+        if (delay < 0) {
+            delay = 0;
+        }
+    }
+    m_barrierTimes.Add ((Simulator::Now () - m_lastBroadcast).GetSeconds ());
+    m_aggregationTails.Add (delay);
+    this->ScheduleParameterUpdate(Seconds(delay));
+}
+
+void
+ParameterServer::Aggregate(uint32_t bytes, Time nicTime) {
+    if (!m_resourceModel || bytes == 0) {
+        return;
+    }
+    // All cores sum in parallel until memory bandwidth runs out; the
+    // network stack takes its CPU time from the same cores.
+    double rate = std::min (m_aggregationCores * m_sumRate, m_memoryBandwidth / 3.0);
+    Time work = Seconds (bytes / rate) + Seconds (nicTime.GetSeconds () / m_aggregationCores);
+    m_aggregationDone = std::max (m_aggregationDone, Simulator::Now ()) + work;
+    m_aggregationBusy += bytes / rate * m_aggregationCores;
+}
+
+Time
+ParameterServer::GetApplyTime() const {
+    // Reads the summed gradient and the parameters, writes the parameters.
+    double rate = std::min (m_aggregationCores * m_sumRate, m_memoryBandwidth / 3.0);
+    return Seconds (m_parameterUpdateSize / rate);
+}
+
+void
+ParameterServer::GrantCredits() {
+    // First come, first served: a worker gets all of its update granted
+    // before the next one, so that few pushes share the server's link.
+    while (!m_creditQueue.empty() && m_creditOutstanding < m_creditWindow) {
+        struct conn_state& worker = this->worker_connections[m_creditQueue.front()];
+        uint32_t grant = std::min(m_creditSize, this->m_gradientUpdateSize - worker.bytes_granted);
+        worker.bytes_granted += grant;
+        worker.grant_bytes_left += m_controlSize;
+        m_creditOutstanding += grant;
+        if (worker.bytes_granted == this->m_gradientUpdateSize) {
+            m_creditQueue.pop_front();
+        }
+        this->ContinueParameterUpdate(worker.socket, worker.socket->GetTxAvailable());
+    }
+}
+
 void
 ParameterServer::ScheduleParameterUpdate (Time dt)
 {
@@ -279,6 +839,7 @@ ParameterServer::StopApplication ()
   // TODO: properly NULL out the callbacks on all sockets
 
   Simulator::Cancel (m_sendEvent);
+  Simulator::Cancel (m_timeoutEvent);
 }
 
 } // Namespace ns3
@@ -29,6 +29,15 @@
 #include "ns3/address.h"
 #include "ns3/traced-callback.h"
 #include "ns3/tcp-socket-base.h"
+#include "ns3/random-variable-stream.h"
+#include "quantile-sketch.h"
+#include "fluid-network.h"
+#include "host-cost.h"
+#include "coflow.h"
+#include "accuracy-model.h"
+#include "delay-trace.h"
+#include <deque>
+#include <string>
 #include <vector>
 
 
@@ -40,8 +49,19 @@ namespace ns3 {
 
 struct conn_state {
     Ptr<Socket> socket;
+    uint32_t fluid_connection;
+    Address address;
     uint32_t bytes_left_recv;
     uint32_t bytes_left_send;
+    uint32_t request_bytes_left; //!< Credit request bytes still expected
+    uint32_t grant_bytes_left; //!< Credit grant bytes not yet sent
+    uint32_t bytes_granted; //!< Bytes of the current push granted so far
+    EventId resume_send; //!< Continues a send held back by the host CPU
+    bool first; //!< The next parameter update is the worker's first, the full model
+    bool pending; //!< Part of the current barrier, gradient not yet received
+    bool departed; //!< Left or presumed failed
+    Time push_start;
+    Time push_end;
 };
 
 /**
@@ -64,6 +84,90 @@ public:
   ParameterServer ();
   virtual ~ParameterServer ();
 
+  /**
+   * TracedCallback signature for iteration events.
+   *
+   * \param [in] serverNum the number of the server
+   * \param [in] iteration the iteration the event belongs to
+   */
+  typedef void (* IterationTracedCallback)(uint32_t serverNum, uint32_t iteration);
+
+  /**
+   * TracedCallback signature for per-worker iteration events.
+   *
+   * \param [in] serverNum the number of the server
+   * \param [in] iteration the iteration the event belongs to
+   * \param [in] worker the address of the worker's socket
+   */
+  typedef void (* WorkerTracedCallback)(uint32_t serverNum, uint32_t iteration, const Address& worker);
+
+  /**
+   * TracedCallback signature for membership changes.
+   *
+   * \param [in] serverNum the number of the server
+   * \param [in] members the number of workers after the change
+   */
+  typedef void (* MembershipTracedCallback)(uint32_t serverNum, uint32_t members);
+
+  uint32_t GetServerNum (void) const;
+
+  /**
+   * \return sketch of the time between two consecutive broadcasts
+   */
+  const TDigest& GetIterationTimes (void) const;
+
+  /**
+   * \return sketch of the time from the first to the last byte of a
+   *         worker's gradient update
+   */
+  const TDigest& GetPushLatencies (void) const;
+
+  /**
+   * \return sketch of the time a worker's complete gradient update
+   *         waited for the other workers
+   */
+  const TDigest& GetWaitTimes (void) const;
+
+  /**
+   * \return sketch of the time from the first to the last complete
+   *         gradient update of an iteration
+   */
+  const TDigest& GetPushSpreads (void) const;
+
+  /**
+   * \return sketch of the time from a broadcast to the last complete
+   *         gradient update, bound by the workers and the network
+   */
+  const TDigest& GetBarrierTimes (void) const;
+
+  /**
+   * \return sketch of the time from the last complete gradient update
+   *         to the next broadcast, bound by the server's CPU
+   */
+  const TDigest& GetAggregationTails (void) const;
+
+  /**
+   * \return the core time spent aggregating so far with the resource
+   *         model, in core-seconds
+   */
+  double GetAggregationBusyTime (void) const;
+
+  uint32_t GetAggregationCores (void) const;
+
+  /**
+   * \return the number of workers that joined and not left
+   */
+  uint32_t GetMembers (void) const;
+
+  uint16_t GetPort (void) const;
+
+  /**
+   * \return the credit window, 0 if the workers push freely
+   */
+  uint32_t GetCreditWindow (void) const;
+  uint32_t GetCreditSize (void) const;
+  uint32_t GetControlSize (void) const;
+
 protected:
   virtual void DoDispose (void);
 
@@ -76,21 +180,65 @@ private:
 
   void HandleAccept(Ptr<Socket> socket, const Address& address);
 
+  void FluidAccept(uint32_t connection, const Address& address);
+
+  void AddWorker(struct conn_state state);
+
+  void HandlePeerClose(Ptr<Socket> socket);
+
+  /// Take a worker out of the membership, and out of the current barrier.
+  void RemoveWorker(size_t i);
+
+  /// Remove the workers still missing when the barrier times out.
+  void BarrierTimeout();
+
   void SendParameterUpdate();
 
   void ContinueParameterUpdate(Ptr<Socket> socket, uint32_t ready);
 
+  void ResumeParameterUpdate(size_t i);
+
   void ReceiveGradientUpdate(Ptr<Socket> socket);
 
+  void FluidReceive(uint32_t connection, Time sent);
+
+  void GradientUpdateReceived(size_t i);
+
+  /// All workers of the barrier are in: aggregate and schedule the broadcast.
+  void CompleteIteration();
+
+  /**
+   * Queue the summing of received gradient bytes on the aggregation
+   * cores, slowed down by the CPU time the host's network stack took.
+   */
+  void Aggregate(uint32_t bytes, Time nicTime);
+
+  /// Time of the optimizer step once all gradients are summed.
+  Time GetApplyTime() const;
+
+  /// Grant credit to the waiting workers while the window allows.
+  void GrantCredits();
 
   void ScheduleParameterUpdate (Time dt);
 
   uint16_t m_port; //!< Port on which we listen for incoming packets.
   Ptr<TcpSocket> m_socket; //!< IPv4 Socket
+  Ptr<FluidNetwork> m_fluid; //!< Flow-level network used instead of sockets, if any
+  Ptr<HostCost> m_host; //!< CPU cost of the network stack
+  Ptr<CoflowScheduler> m_coflows; //!< Priorities of the broadcasts and pushes, if any
+  Ptr<AccuracyModel> m_accuracy; //!< Statistical efficiency of the iterations, if any
   //Ptr<Socket> m_socket6; //!< IPv6 Socket
 
   std::vector<struct conn_state> worker_connections;
   int workers_left;
+  int m_barrierSize; //!< Workers in the current barrier
+  uint32_t m_barrierDropped; //!< Workers removed from the current barrier
+  bool m_started; //!< The initial workers have connected
+  bool m_idle; //!< No members were left to broadcast to
+  bool m_elastic;
+  Time m_failureTimeout;
+  uint32_t m_joinTransferSize;
+  EventId m_timeoutEvent;
 
   EventId m_sendEvent; //!< Event to send the next packet
   uint16_t m_numWorkers;
@@ -100,7 +248,51 @@ private:
   uint32_t m_gradientUpdateSize;
   uint32_t m_serverNum;
 
-  std::vector<double> aggregation_distribution;
+  uint32_t m_iteration; //!< Number of the current iteration
+  uint32_t m_maxIterations; //!< Iterations to run, 0 for no limit
+
+  Ptr<NormalRandomVariable> m_aggregationTime; //!< Aggregation time of an iteration
+  double m_aggregationTimeMean;
+  double m_aggregationTimeStdDev;
+
+  std::string m_aggregationModel; //!< normal, resource or trace
+  bool m_resourceModel;
+  uint32_t m_aggregationCores;
+  double m_sumRate; //!< Gradient bytes a core sums per second
+  double m_memoryBandwidth; //!< Bytes per second
+  Time m_aggregationDone; //!< When the cores are done with the bytes received so far
+  double m_aggregationBusy; //!< Core-seconds spent aggregating
+
+  std::string m_aggregationTraceFile;
+  uint32_t m_traceWarmup;
+  double m_traceOffset;
+  uint32_t m_traceBlock;
+  DelayTrace m_aggregationTrace; //!< Aggregation times replayed with the trace model
+
+  uint32_t m_creditWindow; //!< Granted bytes not yet received, 0 to not grant credit
+  uint32_t m_creditSize;
+  uint32_t m_controlSize;
+  uint32_t m_creditOutstanding;
+  std::deque<size_t> m_creditQueue; //!< Workers waiting for credit, in request order
+
+  double m_sketchCompression;
+  Time m_lastBroadcast;
+  TDigest m_iterationTimes;
+  TDigest m_pushLatencies;
+  TDigest m_waitTimes;
+  TDigest m_pushSpreads;
+  Time m_firstPushEnd; //!< First complete gradient update of the iteration
+  TDigest m_barrierTimes;
+  TDigest m_aggregationTails;
+
+  /// Traced callback: parameter update broadcast started.
+  TracedCallback<uint32_t, uint32_t> m_broadcastTrace;
+  /// Traced callback: gradient update of a worker fully received.
+  TracedCallback<uint32_t, uint32_t, const Address&> m_gradientReceivedTrace;
+  /// Traced callback: the last iteration has been aggregated.
+  TracedCallback<uint32_t, uint32_t> m_finishedTrace;
+  /// Traced callback: a worker joined, left or was presumed failed.
+  TracedCallback<uint32_t, uint32_t> m_membershipTrace;
 
 };
 
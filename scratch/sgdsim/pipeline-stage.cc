@@ -0,0 +1,545 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
+#include "ns3/trace-source-accessor.h"
+#include "pipeline-stage.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PipelineStageApplication");
+
+NS_OBJECT_ENSURE_REGISTERED (PipelineStage);
+
+TypeId
+PipelineStage::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PipelineStage")
+    .SetParent<Application> ()
+    .SetGroupName("Applications")
+    .AddConstructor<PipelineStage> ()
+    .AddAttribute ("Port",
+                   "Port on which the previous stage connects, and on which the next one listens",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&PipelineStage::m_port),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("NextAddress",
+                   "Address of the node of the next stage",
+                   AddressValue (),
+                   MakeAddressAccessor (&PipelineStage::m_nextAddress),
+                   MakeAddressChecker ())
+    .AddAttribute ("PipelineNum",
+                   "PipelineNum",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PipelineStage::m_pipelineNum),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StageNum",
+                   "StageNum",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PipelineStage::m_stageNum),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("NumStages",
+                   "Number of stages of the pipeline",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&PipelineStage::m_numStages),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("NumMicroBatches",
+                   "Number of micro-batches of a mini-batch",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&PipelineStage::m_numMicroBatches),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Schedule",
+                   "Order of the forward and backward passes: gpipe or 1f1b",
+                   StringValue ("1f1b"),
+                   MakeStringAccessor (&PipelineStage::m_schedule),
+                   MakeStringChecker ())
+    .AddAttribute ("ForwardTime",
+                   "Compute time of the forward pass of a micro-batch, in seconds",
+                   DoubleValue (0.02),
+                   MakeDoubleAccessor (&PipelineStage::m_forwardTime),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("BackwardTime",
+                   "Compute time of the backward pass of a micro-batch, in seconds",
+                   DoubleValue (0.04),
+                   MakeDoubleAccessor (&PipelineStage::m_backwardTime),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ActivationSize",
+                   "Size in bytes of the activations of a micro-batch sent to the next stage, "
+                   "and of the activation gradients it sends back",
+                   UintegerValue (16384),
+                   MakeUintegerAccessor (&PipelineStage::m_activationSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("InputActivationSize",
+                   "ActivationSize of the previous stage",
+                   UintegerValue (16384),
+                   MakeUintegerAccessor (&PipelineStage::m_inputActivationSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MTU",
+                   "MTU",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&PipelineStage::m_mtu),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxIterations",
+                   "Number of mini-batches after which the stage stops, 0 for no limit",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PipelineStage::m_maxIterations),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FluidNetwork",
+                   "Flow-level network to exchange activations over instead of TCP sockets",
+                   PointerValue (),
+                   MakePointerAccessor (&PipelineStage::m_fluid),
+                   MakePointerChecker<FluidNetwork> ())
+    .AddTraceSource ("Iteration",
+                     "A mini-batch has started",
+                     MakeTraceSourceAccessor (&PipelineStage::m_iterationTrace),
+                     "ns3::PipelineStage::IterationTracedCallback")
+  ;
+  return tid;
+}
+
+PipelineStage::PipelineStage ()
+  : m_nextConnected (false),
+    m_op (0),
+    m_busy (false),
+    m_iteration (0),
+    m_forwardDone (0),
+    m_backwardDone (0),
+    m_iterationTimes (200.0)
+{
+  NS_LOG_FUNCTION (this);
+  m_prev.connection = 0;
+  m_prev.bytesLeftSend = 0;
+  m_prev.bytesReceived = 0;
+  m_next = m_prev;
+}
+
+PipelineStage::~PipelineStage ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+PipelineStage::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_prev.socket = 0;
+  m_next.socket = 0;
+  Application::DoDispose ();
+}
+
+uint32_t
+PipelineStage::GetPipelineNum (void) const
+{
+  return m_pipelineNum;
+}
+
+uint32_t
+PipelineStage::GetStageNum (void) const
+{
+  return m_stageNum;
+}
+
+uint32_t
+PipelineStage::GetCompletedIterations (void) const
+{
+  return m_iteration;
+}
+
+double
+PipelineStage::GetBusyFraction (void) const
+{
+  Time elapsed = m_lastFinish - m_firstStart;
+  return m_iteration > 0 && elapsed.IsStrictlyPositive () ? m_busyCompleted.GetSeconds () / elapsed.GetSeconds () : 0.0;
+}
+
+const TDigest&
+PipelineStage::GetIterationTimes (void) const
+{
+  return m_iterationTimes;
+}
+
+void
+PipelineStage::BuildSchedule (void)
+{
+  int m = m_numMicroBatches;
+  m_ops.clear ();
+  if (m_schedule == "gpipe")
+    {
+      for (int i = 0; i != m; i++)
+        {
+          m_ops.push_back (i);
+        }
+      for (int i = 0; i != m; i++)
+        {
+          m_ops.push_back (-i - 1);
+        }
+    }
+  else if (m_schedule == "1f1b")
+    {
+      // Enough forward passes in flight to keep the later stages busy.
+      int warmup = std::min<int> (m_numStages - m_stageNum - 1, m);
+      for (int i = 0; i != warmup; i++)
+        {
+          m_ops.push_back (i);
+        }
+      for (int i = 0; i != m - warmup; i++)
+        {
+          m_ops.push_back (warmup + i);
+          m_ops.push_back (-i - 1);
+        }
+      for (int i = m - warmup; i != m; i++)
+        {
+          m_ops.push_back (-i - 1);
+        }
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown pipeline schedule " << m_schedule);
+    }
+}
+
+void
+PipelineStage::StartApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_stageNum < m_numStages);
+  BuildSchedule ();
+  m_host = HostCost::Get (GetNode ());
+  bool last = m_stageNum + 1 == m_numStages;
+
+  if (m_fluid != 0)
+    {
+      if (m_stageNum > 0)
+        {
+          m_fluid->Listen (GetNode (), m_port, MakeCallback (&PipelineStage::FluidAccept, this),
+                           MakeCallback (&PipelineStage::FluidReceiveFromPrev, this));
+        }
+      if (!last)
+        {
+          m_next.connection = m_fluid->Connect (GetNode (), m_nextAddress, m_port,
+                                                MakeCallback (&PipelineStage::FluidConnected, this),
+                                                MakeCallback (&PipelineStage::FluidReceiveFromNext, this));
+        }
+    }
+  else
+    {
+      TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
+      if (m_stageNum > 0)
+        {
+          m_socket = Socket::CreateSocket (GetNode (), tid);
+          m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                       MakeCallback (&PipelineStage::HandleAccept, this));
+          if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port)) == -1)
+            {
+              NS_FATAL_ERROR ("Failed to bind socket");
+            }
+          m_socket->Listen ();
+        }
+      if (!last)
+        {
+          m_next.socket = Socket::CreateSocket (GetNode (), tid);
+          if (m_next.socket->Bind () == -1)
+            {
+              NS_FATAL_ERROR ("Failed to bind socket");
+            }
+          m_next.socket->SetConnectCallback (MakeCallback (&PipelineStage::ConnectionSucceeded, this),
+                                             MakeCallback (&PipelineStage::ConnectionFailed, this));
+          m_next.socket->SetRecvCallback (MakeCallback (&PipelineStage::ReceiveFromNext, this));
+          m_next.socket->SetSendCallback (MakeCallback (&PipelineStage::ContinueSend, this));
+          m_next.socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_nextAddress), m_port));
+        }
+    }
+
+  if (last)
+    {
+      m_nextConnected = true;
+      TryRun ();
+    }
+}
+
+void
+PipelineStage::ConnectionSucceeded (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  m_nextConnected = true;
+  TryRun ();
+}
+
+void
+PipelineStage::ConnectionFailed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_LOG_WARN ("Stage #" << m_stageNum << " of pipeline #" << m_pipelineNum << " failed to connect to the next stage");
+}
+
+void
+PipelineStage::FluidConnected (uint32_t connection)
+{
+  NS_LOG_FUNCTION (this << connection);
+  m_nextConnected = true;
+  TryRun ();
+}
+
+void
+PipelineStage::HandleAccept (Ptr<Socket> socket, const Address& address)
+{
+  NS_LOG_FUNCTION (this << socket << address);
+  socket->SetRecvCallback (MakeCallback (&PipelineStage::ReceiveFromPrev, this));
+  socket->SetSendCallback (MakeCallback (&PipelineStage::ContinueSend, this));
+  m_prev.socket = socket;
+}
+
+void
+PipelineStage::FluidAccept (uint32_t connection, const Address& address)
+{
+  NS_LOG_FUNCTION (this << connection << address);
+  m_prev.connection = connection;
+}
+
+void
+PipelineStage::ReceiveFromPrev (Ptr<Socket> socket)
+{
+  uint64_t bytes = 0;
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()) && packet->GetSize () > 0)
+    {
+      bytes += packet->GetSize ();
+    }
+  // The activations are there once the host CPU processed all of them.
+  Time done = m_host->Receive (bytes);
+  if (done > Simulator::Now ())
+    {
+      Simulator::Schedule (done - Simulator::Now (), &PipelineStage::ActivationsReceived, this, socket, bytes);
+    }
+  else
+    {
+      ActivationsReceived (socket, bytes);
+    }
+}
+
+void
+PipelineStage::ReceiveFromNext (Ptr<Socket> socket)
+{
+  uint64_t bytes = 0;
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()) && packet->GetSize () > 0)
+    {
+      bytes += packet->GetSize ();
+    }
+  Time done = m_host->Receive (bytes);
+  if (done > Simulator::Now ())
+    {
+      Simulator::Schedule (done - Simulator::Now (), &PipelineStage::ActivationsReceived, this, socket, bytes);
+    }
+  else
+    {
+      ActivationsReceived (socket, bytes);
+    }
+}
+
+void
+PipelineStage::ActivationsReceived (Ptr<Socket> socket, uint64_t bytes)
+{
+  Link& link = socket == m_next.socket ? m_next : m_prev;
+  link.bytesReceived += bytes;
+  TryRun ();
+}
+
+void
+PipelineStage::FluidReceiveFromPrev (uint32_t connection, Time sent)
+{
+  m_prev.bytesReceived += m_inputActivationSize;
+  TryRun ();
+}
+
+void
+PipelineStage::FluidReceiveFromNext (uint32_t connection, Time sent)
+{
+  m_next.bytesReceived += m_activationSize;
+  TryRun ();
+}
+
+void
+PipelineStage::Send (Link& link, uint32_t bytes)
+{
+  if (m_fluid != 0)
+    {
+      // This stage is the client of the connection to the next stage.
+      m_fluid->Send (link.connection, &link == &m_next, bytes);
+      return;
+    }
+  link.bytesLeftSend += bytes;
+  ContinueSend (link.socket, link.socket->GetTxAvailable ());
+}
+
+void
+PipelineStage::ContinueSend (Ptr<Socket> socket, uint32_t ready)
+{
+  Link& link = socket == m_next.socket ? m_next : m_prev;
+  // The host CPU timer resumes the send.
+  if (link.resumeSend.IsRunning ())
+    {
+      return;
+    }
+  uint32_t toSend;
+  int actual;
+  do
+    {
+      toSend = std::min<uint64_t> (m_host->GetWriteSize (m_mtu - 40), link.bytesLeftSend);
+      toSend = std::min (toSend, ready);
+      if (toSend == 0)
+        {
+          break;
+        }
+      actual = socket->Send (Create<Packet> (toSend));
+      if (actual > 0)
+        {
+          link.bytesLeftSend -= actual;
+          ready -= actual;
+          // Hand the next bytes to the stack once the CPU is done with these.
+          Time done = m_host->Send (actual);
+          if (done > Simulator::Now ())
+            {
+              link.resumeSend = Simulator::Schedule (done - Simulator::Now (), &PipelineStage::ResumeSend, this, socket);
+              break;
+            }
+        }
+    }
+  while (actual == (int) toSend);
+}
+
+void
+PipelineStage::ResumeSend (Ptr<Socket> socket)
+{
+  ContinueSend (socket, socket->GetTxAvailable ());
+}
+
+void
+PipelineStage::TryRun (void)
+{
+  if (m_busy || !m_nextConnected)
+    {
+      return;
+    }
+  if (m_op == 0 && m_maxIterations > 0 && m_iteration >= m_maxIterations)
+    {
+      return;
+    }
+
+  int op = m_ops[m_op];
+  bool forward = op >= 0;
+  // Passes of a kind run in micro-batch order on every stage, so the n-th
+  // message from a neighbor is the input of the n-th pass of that kind.
+  if (forward && m_stageNum > 0
+      && m_prev.bytesReceived < (m_forwardDone + 1) * m_inputActivationSize)
+    {
+      return;
+    }
+  if (!forward && m_stageNum + 1 < m_numStages
+      && m_next.bytesReceived < (m_backwardDone + 1) * m_activationSize)
+    {
+      return;
+    }
+
+  Time now = Simulator::Now ();
+  if (m_op == 0)
+    {
+      m_iterationTrace (m_pipelineNum * m_numStages + m_stageNum, m_iteration);
+      if (m_iteration > 0)
+        {
+          m_iterationTimes.Add ((now - m_iterationStart).GetSeconds ());
+        }
+      else
+        {
+          m_firstStart = now;
+        }
+      m_iterationStart = now;
+    }
+
+  Time duration = Seconds (forward ? m_forwardTime : m_backwardTime);
+  m_busy = true;
+  m_busyTime += duration;
+  m_computeEvent = Simulator::Schedule (duration, &PipelineStage::PassDone, this);
+}
+
+void
+PipelineStage::PassDone (void)
+{
+  m_busy = false;
+  if (m_ops[m_op] >= 0)
+    {
+      m_forwardDone++;
+      if (m_stageNum + 1 < m_numStages)
+        {
+          Send (m_next, m_activationSize);
+        }
+    }
+  else
+    {
+      m_backwardDone++;
+      if (m_stageNum > 0)
+        {
+          Send (m_prev, m_inputActivationSize);
+        }
+    }
+
+  if (++m_op == m_ops.size ())
+    {
+      NS_LOG_INFO (Simulator::Now ().GetSeconds () << ": Stage #" << m_stageNum << " of pipeline #"
+                   << m_pipelineNum << " finished mini-batch " << m_iteration);
+      m_op = 0;
+      m_iteration++;
+      m_lastFinish = Simulator::Now ();
+      m_busyCompleted = m_busyTime;
+    }
+  TryRun ();
+}
+
+void
+PipelineStage::StopApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_socket != 0)
+    {
+      m_socket->Close ();
+      m_socket = 0;
+    }
+  if (m_prev.socket != 0)
+    {
+      m_prev.socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+  if (m_next.socket != 0)
+    {
+      m_next.socket->Close ();
+    }
+
+  Simulator::Cancel (m_prev.resumeSend);
+  Simulator::Cancel (m_next.resumeSend);
+  Simulator::Cancel (m_computeEvent);
+}
+
+} // namespace ns3
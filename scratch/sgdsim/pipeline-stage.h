@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PIPELINE_STAGE_H
+#define PIPELINE_STAGE_H
+
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+#include "ns3/address.h"
+#include "ns3/traced-callback.h"
+#include "quantile-sketch.h"
+#include "fluid-network.h"
+#include "host-cost.h"
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class Socket;
+
+/**
+ * \brief One stage of a pipeline-parallel model.
+ *
+ * Every mini-batch is split into NumMicroBatches micro-batches.  A stage
+ * runs the forward pass of a micro-batch once the previous stage sent
+ * its activations, and the backward pass once the next stage sent back
+ * the activation gradients; the first and the last stage only depend on
+ * themselves on the respective side.  The order of the passes is the
+ * schedule:
+ *  - gpipe: all forward passes, then all backward passes
+ *  - 1f1b: NumStages - StageNum - 1 forward passes, then alternating one
+ *    forward and one backward pass, then the remaining backward passes
+ * Both flush the pipeline at the end of every mini-batch.
+ *
+ * A stage connects to the next stage at NextAddress; activations flow
+ * forward and activation gradients backward over the same connection.
+ */
+class PipelineStage : public Application
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PipelineStage ();
+
+  virtual ~PipelineStage ();
+
+  /**
+   * TracedCallback signature for iteration events, compatible with
+   * ParameterServer::IterationTracedCallback.
+   *
+   * \param [in] stageId the number of the pipeline times NumStages plus
+   *             the number of the stage
+   * \param [in] iteration the mini-batch the event belongs to
+   */
+  typedef void (* IterationTracedCallback)(uint32_t stageId, uint32_t iteration);
+
+  uint32_t GetPipelineNum (void) const;
+  uint32_t GetStageNum (void) const;
+
+  /**
+   * \return the number of mini-batches this stage completed
+   */
+  uint32_t GetCompletedIterations (void) const;
+
+  /**
+   * \return the share of time from the start of the first to the end of
+   *         the last completed mini-batch this stage spent computing
+   */
+  double GetBusyFraction (void) const;
+
+  /**
+   * \return sketch of the time between the start of two consecutive
+   *         mini-batches
+   */
+  const TDigest& GetIterationTimes (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// A connection to a neighboring stage.
+  struct Link
+  {
+    Ptr<Socket> socket;
+    uint32_t connection;
+    uint64_t bytesLeftSend;
+    uint64_t bytesReceived;
+    EventId resumeSend; //!< Resumes sending once the host CPU is done
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void ConnectionSucceeded (Ptr<Socket> socket);
+  void ConnectionFailed (Ptr<Socket> socket);
+  void FluidConnected (uint32_t connection);
+  void HandleAccept (Ptr<Socket> socket, const Address& address);
+  void FluidAccept (uint32_t connection, const Address& address);
+
+  void ReceiveFromPrev (Ptr<Socket> socket);
+  void ReceiveFromNext (Ptr<Socket> socket);
+  /// Count received bytes once the host CPU processed them.
+  void ActivationsReceived (Ptr<Socket> socket, uint64_t bytes);
+  void FluidReceiveFromPrev (uint32_t connection, Time sent);
+  void FluidReceiveFromNext (uint32_t connection, Time sent);
+
+  void Send (Link& link, uint32_t bytes);
+  void ContinueSend (Ptr<Socket> socket, uint32_t ready);
+  void ResumeSend (Ptr<Socket> socket);
+
+  /// Fill m_ops with the passes of a mini-batch in schedule order.
+  void BuildSchedule (void);
+
+  /// Start the next pass if its input is there and the stage is idle.
+  void TryRun (void);
+  void PassDone (void);
+
+  uint16_t m_port;
+  Address m_nextAddress;
+  uint32_t m_pipelineNum;
+  uint32_t m_stageNum;
+  uint32_t m_numStages;
+  uint32_t m_numMicroBatches;
+  std::string m_schedule;
+  double m_forwardTime;
+  double m_backwardTime;
+  uint32_t m_activationSize; //!< Bytes sent to the next stage per micro-batch
+  uint32_t m_inputActivationSize; //!< Bytes received from the previous stage per micro-batch
+  uint32_t m_mtu;
+  uint32_t m_maxIterations; //!< Mini-batches to run, 0 for no limit
+  Ptr<FluidNetwork> m_fluid; //!< Flow-level network used instead of sockets, if any
+  Ptr<HostCost> m_host; //!< CPU cost of the network stack
+
+  Ptr<Socket> m_socket; //!< Listening socket
+  Link m_prev;
+  Link m_next;
+  bool m_nextConnected;
+
+  std::vector<int> m_ops; //!< Micro-batch of every pass, negated and minus one for backward
+  size_t m_op; //!< Next pass of the current mini-batch
+  bool m_busy;
+  uint32_t m_iteration; //!< Number of the current mini-batch
+  uint64_t m_forwardDone; //!< Forward passes over all mini-batches so far
+  uint64_t m_backwardDone; //!< Backward passes over all mini-batches so far
+  EventId m_computeEvent;
+
+  Time m_firstStart;
+  Time m_iterationStart;
+  Time m_lastFinish;
+  Time m_busyTime; //!< Compute time of the passes so far
+  Time m_busyCompleted; //!< Compute time of the completed mini-batches
+  TDigest m_iterationTimes;
+
+  /// Traced callback: a mini-batch has started.
+  TracedCallback<uint32_t, uint32_t> m_iterationTrace;
+};
+
+} // namespace ns3
+
+#endif /* PIPELINE_STAGE_H */
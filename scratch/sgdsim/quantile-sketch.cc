@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "quantile-sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+TDigest::TDigest (double compression)
+  : m_compression (compression),
+    m_min (std::numeric_limits<double>::infinity ()),
+    m_max (-std::numeric_limits<double>::infinity ()),
+    m_sum (0.0),
+    m_count (0.0),
+    m_buffered (0.0)
+{
+  m_buffer.reserve (5 * (size_t) compression);
+}
+
+void
+TDigest::Add (double value, double weight)
+{
+  Centroid c;
+  c.mean = value;
+  c.weight = weight;
+  m_buffer.push_back (c);
+  m_buffered += weight;
+  m_sum += value * weight;
+  m_min = std::min (m_min, value);
+  m_max = std::max (m_max, value);
+
+  if (m_buffer.size () >= 5 * (size_t) m_compression)
+    {
+      Compress ();
+    }
+}
+
+void
+TDigest::Merge (const TDigest& other)
+{
+  other.Compress ();
+  for (size_t i = 0; i != other.m_centroids.size (); i++)
+    {
+      m_buffer.push_back (other.m_centroids[i]);
+      m_buffered += other.m_centroids[i].weight;
+    }
+  m_sum += other.m_sum;
+  m_min = std::min (m_min, other.m_min);
+  m_max = std::max (m_max, other.m_max);
+  Compress ();
+}
+
+static double
+Scale (double q, double compression)
+{
+  q = std::min (1.0, std::max (0.0, q));
+  return compression / (2.0 * M_PI) * std::asin (2.0 * q - 1.0);
+}
+
+void
+TDigest::Compress () const
+{
+  if (m_buffer.empty ())
+    {
+      return;
+    }
+
+  m_buffer.insert (m_buffer.end (), m_centroids.begin (), m_centroids.end ());
+  std::sort (m_buffer.begin (), m_buffer.end ());
+  m_count += m_buffered;
+  m_buffered = 0.0;
+
+  m_centroids.clear ();
+  Centroid current = m_buffer[0];
+  double before = 0.0;
+  double limit = Scale (0.0, m_compression) + 1.0;
+  for (size_t i = 1; i != m_buffer.size (); i++)
+    {
+      const Centroid& next = m_buffer[i];
+      double q = (before + current.weight + next.weight) / m_count;
+      if (Scale (q, m_compression) <= limit)
+        {
+          current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+          current.weight += next.weight;
+        }
+      else
+        {
+          before += current.weight;
+          m_centroids.push_back (current);
+          limit = Scale (before / m_count, m_compression) + 1.0;
+          current = next;
+        }
+    }
+  m_centroids.push_back (current);
+  m_buffer.clear ();
+}
+
+double
+TDigest::Quantile (double q) const
+{
+  Compress ();
+  if (m_centroids.empty ())
+    {
+      return 0.0;
+    }
+  if (q <= 0.0)
+    {
+      return m_min;
+    }
+  if (q >= 1.0)
+    {
+      return m_max;
+    }
+
+  // Each centroid's mean sits at the middle of its weight; interpolate
+  // between neighbouring centers and towards min/max at the ends.
+  double target = q * m_count;
+  double left = 0.0;
+  double previousMean = m_min;
+  double previousCenter = 0.0;
+  for (size_t i = 0; i != m_centroids.size (); i++)
+    {
+      const Centroid& c = m_centroids[i];
+      double center = left + c.weight / 2.0;
+      if (target < center)
+        {
+          double fraction = (target - previousCenter) / (center - previousCenter);
+          return previousMean + fraction * (c.mean - previousMean);
+        }
+      previousMean = c.mean;
+      previousCenter = center;
+      left += c.weight;
+    }
+  double fraction = (target - previousCenter) / (m_count - previousCenter);
+  return previousMean + fraction * (m_max - previousMean);
+}
+
+double
+TDigest::Cdf (double value) const
+{
+  Compress ();
+  if (m_centroids.empty () || value < m_min)
+    {
+      return 0.0;
+    }
+  if (value >= m_max)
+    {
+      return 1.0;
+    }
+
+  double left = 0.0;
+  double previousMean = m_min;
+  double previousCenter = 0.0;
+  for (size_t i = 0; i != m_centroids.size (); i++)
+    {
+      const Centroid& c = m_centroids[i];
+      double center = left + c.weight / 2.0;
+      if (value < c.mean)
+        {
+          double fraction = (c.mean > previousMean) ? (value - previousMean) / (c.mean - previousMean) : 1.0;
+          return (previousCenter + fraction * (center - previousCenter)) / m_count;
+        }
+      previousMean = c.mean;
+      previousCenter = center;
+      left += c.weight;
+    }
+  double fraction = (value - previousMean) / (m_max - previousMean);
+  return (previousCenter + fraction * (m_count - previousCenter)) / m_count;
+}
+
+double
+TDigest::GetCount () const
+{
+  return m_count + m_buffered;
+}
+
+double
+TDigest::GetMean () const
+{
+  double count = GetCount ();
+  return count > 0 ? m_sum / count : 0.0;
+}
+
+double
+TDigest::GetMin () const
+{
+  return GetCount () > 0 ? m_min : 0.0;
+}
+
+double
+TDigest::GetMax () const
+{
+  return GetCount () > 0 ? m_max : 0.0;
+}
+
+double
+TDigest::GetCompression () const
+{
+  return m_compression;
+}
+
+} // namespace ns3
@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Merging t-digest: a mergeable streaming quantile sketch.
+ *
+ * Values are buffered and periodically merged into at most about
+ * `compression` centroids using the arcsine scale function, which keeps
+ * centroids small near the tails so that p99 and p99.9 stay accurate.
+ * Memory is bounded by the compression regardless of how many values
+ * are added, and two digests can be merged, e.g. to build a global
+ * distribution out of per-server ones.
+ */
+class TDigest
+{
+public:
+  /**
+   * \param compression number of centroids to aim for; higher is more
+   *                    accurate and uses more memory
+   */
+  TDigest (double compression = 100.0);
+
+  void Add (double value, double weight = 1.0);
+
+  /**
+   * Add all values summarized by another digest.
+   */
+  void Merge (const TDigest& other);
+
+  /**
+   * \param q quantile in [0, 1]
+   * \return the estimated value at quantile q, 0 if the digest is empty
+   */
+  double Quantile (double q) const;
+
+  /**
+   * \param value the value
+   * \return the estimated fraction of values not larger than value
+   */
+  double Cdf (double value) const;
+
+  double GetCount () const;
+  double GetMean () const;
+  double GetMin () const;
+  double GetMax () const;
+  double GetCompression () const;
+
+private:
+  struct Centroid
+  {
+    double mean;
+    double weight;
+    bool operator< (const Centroid& other) const { return mean < other.mean; }
+  };
+
+  void Compress () const;
+
+  double m_compression;
+  double m_min;
+  double m_max;
+  double m_sum;
+
+  // Compression is deferred until the digest is read, hence mutable.
+  mutable std::vector<Centroid> m_centroids;
+  mutable std::vector<Centroid> m_buffer;
+  mutable double m_count;
+  mutable double m_buffered;
+};
+
+} // namespace ns3
+
+#endif /* QUANTILE_SKETCH_H */
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/callback.h"
+#include "run-summary.h"
+#include <fstream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("RunSummary");
+
+RunSummary::RunSummary ()
+  : m_iterations (0),
+    m_iterationTimeSum (0.0),
+    m_iterationTimes (200.0)
+{
+}
+
+void
+RunSummary::Connect ()
+{
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Broadcast",
+                                 MakeCallback (&RunSummary::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::GossipWorker/Iteration",
+                                 MakeCallback (&RunSummary::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PipelineStage/Iteration",
+                                 MakeCallback (&RunSummary::Broadcast, this));
+}
+
+void
+RunSummary::Connect (Ptr<Application> server)
+{
+  server->TraceConnectWithoutContext ("Broadcast", MakeCallback (&RunSummary::Broadcast, this));
+}
+
+void
+RunSummary::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  Time now = Simulator::Now ();
+  std::map<uint32_t, Time>::iterator it = m_lastBroadcast.find (serverNum);
+  if (it != m_lastBroadcast.end ())
+    {
+      m_iterations++;
+      m_iterationTimeSum += (now - it->second).GetSeconds ();
+      m_iterationTimes.Add ((now - it->second).GetSeconds ());
+      it->second = now;
+    }
+  else
+    {
+      m_lastBroadcast[serverNum] = now;
+    }
+}
+
+void
+RunSummary::SetRaw (std::string key, std::string value)
+{
+  for (size_t i = 0; i != m_values.size (); i++)
+    {
+      if (m_values[i].first == key)
+        {
+          m_values[i].second = value;
+          return;
+        }
+    }
+  m_values.push_back (std::make_pair (key, value));
+}
+
+void
+RunSummary::Set (std::string key, double value)
+{
+  std::ostringstream os;
+  os.precision (10);
+  os << value;
+  SetRaw (key, os.str ());
+}
+
+void
+RunSummary::Set (std::string key, std::string value)
+{
+  std::ostringstream os;
+  os << '"';
+  for (size_t i = 0; i != value.size (); i++)
+    {
+      if (value[i] == '"' || value[i] == '\\')
+        {
+          os << '\\';
+        }
+      os << value[i];
+    }
+  os << '"';
+  SetRaw (key, os.str ());
+}
+
+void
+RunSummary::Write (std::string filename)
+{
+  Set ("servers", (double) m_lastBroadcast.size ());
+  Set ("iterations", (double) m_iterations);
+  Set ("mean_iteration_time", m_iterations > 0 ? m_iterationTimeSum / m_iterations : 0.0);
+  Set ("p99_iteration_time", m_iterationTimes.Quantile (0.99));
+
+  std::ofstream output (filename.c_str ());
+  if (!output.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  output << "{" << std::endl;
+  for (size_t i = 0; i != m_values.size (); i++)
+    {
+      output << "  \"" << m_values[i].first << "\": " << m_values[i].second;
+      output << (i + 1 != m_values.size () ? "," : "") << std::endl;
+    }
+  output << "}" << std::endl;
+}
+
+const TDigest&
+RunSummary::GetIterationTimes () const
+{
+  return m_iterationTimes;
+}
+
+} // namespace ns3
@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RUN_SUMMARY_H
+#define RUN_SUMMARY_H
+
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/application.h"
+#include "quantile-sketch.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Machine-readable key/value summary of one run.
+ *
+ * Counts the iterations of every ParameterServer through its Broadcast
+ * trace source and collects whatever other metrics main () adds, then
+ * writes everything as a flat JSON object.  Scripts driving many runs
+ * (benchmarks, sweeps) read this file instead of parsing the log.
+ */
+class RunSummary
+{
+public:
+  RunSummary ();
+
+  /**
+   * Connect to the Broadcast trace source of all installed
+   * ParameterServer applications, and to the Iteration trace source of
+   * all GossipWorker and PipelineStage applications, each of which
+   * counts as a server.
+   */
+  void Connect ();
+
+  /**
+   * Connect to the Broadcast trace source of a ParameterServer installed
+   * after Connect (), as the JobScheduler does when a job starts.
+   */
+  void Connect (Ptr<Application> server);
+
+  void Set (std::string key, double value);
+  void Set (std::string key, std::string value);
+
+  /**
+   * Add the iteration statistics and write the summary.
+   *
+   * \param filename the file to write
+   */
+  void Write (std::string filename);
+
+  /**
+   * \return sketch of the time between two broadcasts of a server
+   */
+  const TDigest& GetIterationTimes () const;
+
+private:
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+
+  void SetRaw (std::string key, std::string value);
+
+  std::map<uint32_t, Time> m_lastBroadcast;
+  uint64_t m_iterations;
+  double m_iterationTimeSum;
+  TDigest m_iterationTimes;
+
+  std::vector<std::pair<std::string, std::string> > m_values;
+};
+
+} // namespace ns3
+
+#endif /* RUN_SUMMARY_H */
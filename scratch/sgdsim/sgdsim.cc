@@ -22,16 +22,49 @@
 #include "ns3/applications-module.h"
 #include "ns3/bridge-module.h"
 #include "ns3/csma-module.h"
+#include "ns3/flow-monitor-module.h"
 #include "parameter-server-helper.h"
+#include "parameter-server.h"
+#include "parameter-client.h"
+#include "quantile-sketch.h"
+#include "link-monitor.h"
+#include "critical-path.h"
+#include "sim-profiler.h"
+#include "run-summary.h"
+#include "event-trace.h"
+#include "fluid-network.h"
+#include "convergence-monitor.h"
+#include "branch-runner.h"
+#include "job-scheduler.h"
+#include "gossip-worker.h"
+#include "pipeline-stage.h"
+#include "host-cost.h"
+#include "gpu-host.h"
+#include "elastic-monitor.h"
+#include "coflow.h"
+#include "topology-file.h"
+#include "accuracy-model.h"
+#include "telemetry.h"
+#include <chrono>
+#include <set>
+#include <limits>
+#include <cstdlib>
+#include <unistd.h>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("CS268Simulation");
 
-NetDeviceContainer datacenter_connect(Ptr<Node> a, Ptr<Node> b) {
+NetDeviceContainer datacenter_connect(Ptr<Node> a, Ptr<Node> b, std::string queue, std::string rate = "10Mbps",
+                                      Time delay = NanoSeconds (15), std::string queueSize = "") {
     CsmaHelper csma;
-    csma.SetChannelAttribute ("DataRate", StringValue ("10Mbps"));
-    csma.SetChannelAttribute ("Delay", TimeValue (NanoSeconds (15)));
+    if (!queueSize.empty()) {
+        csma.SetQueue (queue.empty() ? "ns3::DropTailQueue<Packet>" : queue, "MaxSize", QueueSizeValue (QueueSize (queueSize)));
+    } else if (!queue.empty()) {
+        csma.SetQueue (queue);
+    }
+    csma.SetChannelAttribute ("DataRate", StringValue (rate));
+    csma.SetChannelAttribute ("Delay", TimeValue (delay));
     return csma.Install(NodeContainer(a, b));
 
     // PointToPointHelper pointToPoint;
@@ -42,14 +75,18 @@ NetDeviceContainer datacenter_connect(Ptr<Node> a, Ptr<Node> b) {
 
 class Rack {
 public:
-    Rack(int numhosts, Ipv4Address network, Ipv4Mask mask);
+    Rack(int numhosts, Ipv4Address network, Ipv4Mask mask, std::string queue);
+    // An empty rack, for hosts added one by one.
+    Rack(Ipv4Address network, Ipv4Mask mask);
 
+    void AddHost(Ptr<Node> host, NetDeviceContainer link);
     void AddEgress(Ptr<NetDevice> egress, Ptr<NetDevice> nextlayer);
     void Init();
 
     NodeContainer hosts;
     Ptr<Node> topOfRack;
     Ipv4InterfaceContainer hostIPs;
+    std::vector<NetDeviceContainer> links;
 
 private:
     NetDeviceContainer tordevs;
@@ -58,12 +95,13 @@ private:
     Ipv4Mask mask;
 };
 
-Rack::Rack(int numhosts, Ipv4Address netmask_addr, Ipv4Mask netmask_mask) : network(netmask_addr), mask(netmask_mask) {
+Rack::Rack(int numhosts, Ipv4Address netmask_addr, Ipv4Mask netmask_mask, std::string queue) : network(netmask_addr), mask(netmask_mask) {
     this->hosts.Create(numhosts);
     this->topOfRack = CreateObject<Node>();
 
     for (int i = 0; i != numhosts; i++) {
-        NetDeviceContainer netdevs = datacenter_connect(this->topOfRack, this->hosts.Get(i));
+        NetDeviceContainer netdevs = datacenter_connect(this->topOfRack, this->hosts.Get(i), queue);
+        this->links.push_back(netdevs);
         this->tordevs.Add(netdevs.Get(0));
         this->hostdevs.Add(netdevs.Get(1));
     }
@@ -72,6 +110,17 @@ Rack::Rack(int numhosts, Ipv4Address netmask_addr, Ipv4Mask netmask_mask) : netw
     stack.Install(this->hosts);
 }
 
+Rack::Rack(Ipv4Address netmask_addr, Ipv4Mask netmask_mask) : network(netmask_addr), mask(netmask_mask) {
+    this->topOfRack = CreateObject<Node>();
+}
+
+void Rack::AddHost(Ptr<Node> host, NetDeviceContainer link) {
+    this->hosts.Add(host);
+    this->links.push_back(link);
+    this->tordevs.Add(link.Get(0));
+    this->hostdevs.Add(link.Get(1));
+}
+
 void Rack::AddEgress(Ptr<NetDevice> egress, Ptr<NetDevice> nextlayer) {
     this->tordevs.Add(egress);
     this->hostdevs.Add(nextlayer);
@@ -91,33 +140,86 @@ void Rack::Init() {
 
 class Topology {
 public:
-    Topology(int numRacks, int rackSize);
+    // queue is the type of every device queue, empty for the CSMA default.
+    Topology(int numRacks, int rackSize, std::string queue);
+    // The fabric of a description file, with a rack for every tor.
+    Topology(const TopologyFile& file, std::string queue);
 
     void setColocate();
     void setCluster();
     void setStride();
     void setRandom();
+    void setGossip(std::string graph, int degree);
+    void setPipeline(std::string placement, int numStages, const std::vector<double>& forwardTimes,
+                     const std::vector<double>& backwardTimes, const std::vector<double>& activationSizes);
+
+    void installServer(int rack, int host, int serverNum, int numWorkers);
+    void installClient(int rack, int host, int serverRack, int serverHost, int serverNum, int clientNum, double start = 1.0);
+
+    // Elastic membership: a worker joins the server with the fewest
+    // workers, on a host freed by an earlier leave if any, and the last
+    // worker to join the server with the most workers leaves or fails.
+    // Both return the server number, -1 if there is no worker to remove.
+    int joinWorker();
+    int removeWorker(bool fail);
+
+    void monitorLinks(LinkMonitor& monitor);
+    // Warn about uplinks of racks with several of them that carried
+    // nothing, i.e. that equal-cost routing left unused.
+    void checkUplinks(const LinkMonitor& monitor) const;
+    // Name of the i-th uplink in the link reports; further uplinks of a
+    // rack are numbered from 1.
+    std::string uplinkName(size_t i) const;
+    void registerHosts(JobScheduler& scheduler);
+    void useFluidNetwork(Ptr<FluidNetwork> network);
+
+    int size(int rack) const;
+    int numHosts() const;
+    // Rack and host of the host at index in rack order.
+    std::pair<int, int> hostAt(int index) const;
 
     int numRacks;
-    int rackSize;
+    int rackSize; // 0 if the racks differ in size
     Rack** racks;
     Ptr<Node> topSwitch;
+    std::vector<NetDeviceContainer> uplinks;
+    std::vector<int> uplinkRacks;
+    std::vector<NetDeviceContainer> coreLinks; // Between switches
+    Ptr<FluidNetwork> fluid;
+    Ptr<CoflowScheduler> coflows;
+    Ptr<AccuracyModel> accuracy;
+
+    ApplicationContainer servers;
+    ApplicationContainer clients;
+    ApplicationContainer gossipWorkers;
+    ApplicationContainer pipelineStages;
+    std::map<std::pair<int, int>, int> workerRacks;
+
+    std::vector<std::pair<int, int> > serverHosts;
+    std::vector<std::pair<int, int> > clientHosts;
+    std::vector<std::vector<uint32_t> > serverClients; // Remaining workers of every server, in joining order
+    std::vector<int> nextClientNum;
+    std::vector<std::pair<int, int> > freeHosts;
+    int nextJoinHost;
 };
 
-Topology::Topology(int numRacks, int rackSize) {
+Topology::Topology(int numRacks, int rackSize, std::string queue) {
     this->numRacks = numRacks;
     this->rackSize = rackSize;
+    this->nextJoinHost = 0;
 
     this->racks = new Rack*[numRacks];
     this->topSwitch = CreateObject<Node>();
     for (int i = 0; i != numRacks; i++) {
         char subnet[20];
         sprintf(subnet, "10.1.%d.0", i+1);
-        Rack* rack = new Rack(rackSize, subnet, "255.255.255.0");
+        Rack* rack = new Rack(rackSize, subnet, "255.255.255.0", queue);
         this->racks[i] = rack;
 
-        NetDeviceContainer link = datacenter_connect(this->topSwitch, rack->topOfRack);
+        NetDeviceContainer link = datacenter_connect(this->topSwitch, rack->topOfRack, queue);
         rack->AddEgress(link.Get(1), link.Get(0));
+        this->uplinks.push_back(link);
+        this->uplinkRacks.push_back(i);
     }
 
     InternetStackHelper stack;
@@ -128,46 +230,212 @@ Topology::Topology(int numRacks, int rackSize) {
     }
 }
 
-void Topology::setColocate() {
+Topology::Topology(const TopologyFile& file, std::string queue) {
+    const std::vector<TopologyFile::Link>& links = file.GetLinks();
+    std::vector<uint32_t> tors = file.GetTors();
+    this->numRacks = tors.size();
+    this->nextJoinHost = 0;
 
+    // Switches route between the racks, as the top switch does in the
+    // generated topologies.
+    std::map<uint32_t, Ptr<Node> > switches;
+    NodeContainer routers;
+    for (size_t i = 0; i != file.GetNodes().size(); i++) {
+        if (file.GetNodes()[i].role == TopologyFile::SWITCH) {
+            switches[i] = CreateObject<Node>();
+            routers.Add(switches[i]);
+        }
+    }
+    this->topSwitch = routers.Get(0);
+
+    this->racks = new Rack*[this->numRacks];
     for (int i = 0; i != this->numRacks; i++) {
-        Rack* rack = this->racks[i];
-        ParameterServerHelper paramServer (9);
-        paramServer.SetAttribute ("NumWorkers", UintegerValue (this->rackSize - 1));
-        paramServer.SetAttribute ("ServerNum", UintegerValue(i));
-        ApplicationContainer serverApps = paramServer.Install (rack->hosts.Get (0));
-        serverApps.Start(Seconds(1.0));
+        char subnet[20];
+        sprintf(subnet, "10.1.%d.0", i+1);
+        Rack* rack = new Rack(subnet, "255.255.255.0");
+        this->racks[i] = rack;
+
+        std::vector<uint32_t> hostLinks = file.GetHostLinks(tors[i]);
+        for (size_t j = 0; j != hostLinks.size(); j++) {
+            const TopologyFile::Link& l = links[hostLinks[j]];
+            Ptr<Node> host = CreateObject<Node>();
+            rack->AddHost(host, datacenter_connect(rack->topOfRack, host, queue, l.rate, l.delay, l.queue));
+        }
+        InternetStackHelper stack;
+        stack.Install(rack->hosts);
+
+        std::vector<uint32_t> uplinks = file.GetUplinks(tors[i]);
+        for (size_t j = 0; j != uplinks.size(); j++) {
+            const TopologyFile::Link& l = links[uplinks[j]];
+            NetDeviceContainer link = datacenter_connect(switches[l.a], rack->topOfRack, queue, l.rate, l.delay, l.queue);
+            rack->AddEgress(link.Get(1), link.Get(0));
+            this->uplinks.push_back(link);
+            this->uplinkRacks.push_back(i);
+        }
+    }
 
-        for (int j = 1; j != this->rackSize; j++) {
-            ParameterClientHelper paramClient (rack->hostIPs.GetAddress (0), 9);
-            paramClient.SetAttribute ("ClientNum", UintegerValue(j - 1));
-            paramClient.SetAttribute ("ServerNum", UintegerValue(i));
-            ApplicationContainer clientApps = paramClient.Install (rack->hosts.Get (j));
-            clientApps.Start(Seconds(1.0));
+    this->rackSize = this->size(0);
+    for (int i = 1; i != this->numRacks; i++) {
+        if (this->size(i) != this->rackSize) {
+            this->rackSize = 0;
         }
     }
+
+    InternetStackHelper stack;
+    stack.Install(routers);
+
+    Ipv4AddressHelper core("10.2.0.0", "255.255.255.252");
+    std::vector<uint32_t> coreLinks = file.GetCoreLinks();
+    for (size_t i = 0; i != coreLinks.size(); i++) {
+        const TopologyFile::Link& l = links[coreLinks[i]];
+        NetDeviceContainer link = datacenter_connect(switches[l.a], switches[l.b], queue, l.rate, l.delay, l.queue);
+        core.Assign(link);
+        core.NewNetwork();
+        this->coreLinks.push_back(link);
+    }
+
+    for (int i = 0; i != this->numRacks; i++) {
+        this->racks[i]->Init();
+    }
 }
 
-void Topology::setCluster() {
-    assert(this->numRacks == this->rackSize);
+int Topology::size(int rack) const {
+    return this->racks[rack]->hosts.GetN();
+}
+
+int Topology::numHosts() const {
+    int n = 0;
+    for (int i = 0; i != this->numRacks; i++) {
+        n += this->size(i);
+    }
+    return n;
+}
+
+std::pair<int, int> Topology::hostAt(int index) const {
+    int rack = 0;
+    while (index >= this->size(rack)) {
+        index -= this->size(rack++);
+    }
+    return std::make_pair(rack, index);
+}
+
+void Topology::installServer(int rack, int host, int serverNum, int numWorkers) {
+    ParameterServerHelper paramServer (9);
+    paramServer.SetAttribute ("NumWorkers", UintegerValue (numWorkers));
+    paramServer.SetAttribute ("ServerNum", UintegerValue (serverNum));
+    paramServer.SetAttribute ("TraceOffset", DoubleValue (DelayTrace::GetOffset(serverNum)));
+    if (this->fluid != 0) {
+        paramServer.SetAttribute ("FluidNetwork", PointerValue (this->fluid));
+    }
+    if (this->coflows != 0) {
+        paramServer.SetAttribute ("Coflows", PointerValue (this->coflows));
+    }
+    if (this->accuracy != 0) {
+        paramServer.SetAttribute ("AccuracyModel", PointerValue (this->accuracy));
+    }
+    ApplicationContainer serverApps = paramServer.Install (this->racks[rack]->hosts.Get (host));
+    serverApps.Start(Seconds(1.0));
+    this->servers.Add(serverApps);
+    if ((int) this->serverHosts.size() <= serverNum) {
+        this->serverHosts.resize(serverNum + 1);
+        this->serverClients.resize(serverNum + 1);
+        this->nextClientNum.resize(serverNum + 1, 0);
+    }
+    this->serverHosts[serverNum] = std::make_pair(rack, host);
+}
+
+void Topology::installClient(int rack, int host, int serverRack, int serverHost, int serverNum, int clientNum, double start) {
+    ParameterClientHelper paramClient (this->racks[serverRack]->hostIPs.GetAddress (serverHost), 9);
+    paramClient.SetAttribute ("ClientNum", UintegerValue (clientNum));
+    paramClient.SetAttribute ("ServerNum", UintegerValue (serverNum));
+    paramClient.SetAttribute ("TraceOffset", DoubleValue (DelayTrace::GetOffset(this->clients.GetN())));
+    if (this->fluid != 0) {
+        paramClient.SetAttribute ("FluidNetwork", PointerValue (this->fluid));
+    }
+    if (this->coflows != 0) {
+        paramClient.SetAttribute ("Coflows", PointerValue (this->coflows));
+    }
+    if (this->accuracy != 0) {
+        paramClient.SetAttribute ("AccuracyModel", PointerValue (this->accuracy));
+    }
+    ApplicationContainer clientApps = paramClient.Install (this->racks[rack]->hosts.Get (host));
+    clientApps.Start(Seconds(start));
+    this->clients.Add(clientApps);
+    this->workerRacks[std::make_pair(serverNum, clientNum)] = rack;
+    this->clientHosts.push_back(std::make_pair(rack, host));
+    this->serverClients[serverNum].push_back(this->clients.GetN() - 1);
+    this->nextClientNum[serverNum] = std::max(this->nextClientNum[serverNum], clientNum + 1);
+}
+
+int Topology::joinWorker() {
+    int server = 0;
+    for (int i = 1; i != (int) this->serverHosts.size(); i++) {
+        if (this->serverClients[i].size() < this->serverClients[server].size()) {
+            server = i;
+        }
+    }
+    std::pair<int, int> host;
+    if (!this->freeHosts.empty()) {
+        host = this->freeHosts.front();
+        this->freeHosts.erase(this->freeHosts.begin());
+    } else {
+        host = this->hostAt(this->nextJoinHost++ % this->numHosts());
+    }
+    this->installClient(host.first, host.second, this->serverHosts[server].first, this->serverHosts[server].second,
+                        server, this->nextClientNum[server], 0.0);
+    return server;
+}
+
+int Topology::removeWorker(bool fail) {
+    int server = 0;
+    for (int i = 1; i != (int) this->serverHosts.size(); i++) {
+        if (this->serverClients[i].size() > this->serverClients[server].size()) {
+            server = i;
+        }
+    }
+    if (this->serverClients.empty() || this->serverClients[server].empty()) {
+        return -1;
+    }
+    uint32_t index = this->serverClients[server].back();
+    this->serverClients[server].pop_back();
+    Ptr<ParameterClient> client = DynamicCast<ParameterClient>(this->clients.Get(index));
+    if (fail) {
+        client->Fail();
+    } else {
+        client->Leave();
+    }
+    this->freeHosts.push_back(this->clientHosts[index]);
+    return server;
+}
 
+void Topology::setColocate() {
 
-    Rack* rack0 = this->racks[0];
-    for (int j = 0; j != this->rackSize; j++) {
-        ParameterServerHelper paramServer (9);
-        paramServer.SetAttribute ("NumWorkers", UintegerValue (this->rackSize - 1));
-        paramServer.SetAttribute ("ServerNum", UintegerValue(j));
-        ApplicationContainer serverApps = paramServer.Install (rack0->hosts.Get (j));
-        serverApps.Start(Seconds(1.0));
+    for (int i = 0; i != this->numRacks; i++) {
+        this->installServer(i, 0, i, this->size(i) - 1);
+
+        for (int j = 1; j != this->size(i); j++) {
+            this->installClient(i, j, i, 0, i, j - 1);
+        }
     }
+}
+
+void Topology::setCluster() {
+    // Host j of a rack works for server j modulo the servers in the first
+    // rack, which are all of its hosts.
+    int servers = this->size(0);
+    std::vector<int> workers(servers, 0);
     for (int i = 1; i != this->numRacks; i++) {
-        Rack* rack = this->racks[i];
-        for (int j = 0; j != this->rackSize; j++) {
-            ParameterClientHelper paramClient (rack0->hostIPs.GetAddress (j), 9);
-            paramClient.SetAttribute("ServerNum", UintegerValue(j));
-            paramClient.SetAttribute("ClientNum", UintegerValue(i-1));
-            ApplicationContainer clientApps = paramClient.Install (rack->hosts.Get (j));
-            clientApps.Start(Seconds(1.0));
+        for (int j = 0; j != this->size(i); j++) {
+            workers[j % servers]++;
+        }
+    }
+    for (int j = 0; j != servers; j++) {
+        this->installServer(0, j, j, workers[j]);
+    }
+    std::vector<int> next(servers, 0);
+    for (int i = 1; i != this->numRacks; i++) {
+        for (int j = 0; j != this->size(i); j++) {
+            this->installClient(i, j, 0, j % servers, j % servers, next[j % servers]++);
         }
     }
 }
@@ -175,93 +443,1342 @@ void Topology::setCluster() {
 void Topology::setStride() {
 
     for (int i = 0; i != this->numRacks; i++) {
-        Rack* rack = this->racks[i];
-        ParameterServerHelper paramServer (9);
-        paramServer.SetAttribute ("NumWorkers", UintegerValue (this->rackSize - 1));
-        paramServer.SetAttribute ("ServerNum", UintegerValue(i));
-        ApplicationContainer serverApps = paramServer.Install (rack->hosts.Get (0));
-        serverApps.Start(Seconds(1.0));
+        // Its workers are the hosts of the previous rack.
+        this->installServer(i, 0, i, this->size((i + this->numRacks - 1) % this->numRacks) - 1);
 
         int rotatedi = (i+1)%numRacks;
-        Rack* serverRack = this->racks[rotatedi];
         // if (i == 0) {
         //     serverRack = this->racks[this->numRacks - 1];
         // } else {
         //     serverRack = this->racks[i - 1];
         // }
 
-        for (int j = 1; j != this->rackSize; j++) {
-            ParameterClientHelper paramClient (serverRack->hostIPs.GetAddress (0), 9);
-            paramClient.SetAttribute("ServerNum", UintegerValue(rotatedi));
-            paramClient.SetAttribute("ClientNum", UintegerValue(j - 1));
-            ApplicationContainer clientApps = paramClient.Install (rack->hosts.Get (j));
-            clientApps.Start(Seconds(1.0));
+        for (int j = 1; j != this->size(i); j++) {
+            this->installClient(i, j, rotatedi, 0, rotatedi, j - 1);
         }
     }
 }
 
 void Topology::setRandom() {
-    std::vector<int> locations(this->numRacks * this->rackSize);
+    std::vector<int> locations(this->numHosts());
     for (int i = 0; i != (int) locations.size(); i++) {
         locations[i] = i;
     }
     NS_LOG_INFO(locations.size());
-    std::random_shuffle(locations.begin(), locations.end());
+    Ptr<UniformRandomVariable> shuffle = CreateObject<UniformRandomVariable>();
+    // A fixed stream keeps the placement of a run independent of how many
+    // random variables were created before, e.g. by an earlier run.
+    shuffle->SetStream(0);
+    for (int i = (int) locations.size() - 1; i > 0; i--) {
+        std::swap(locations[i], locations[shuffle->GetInteger(0, i)]);
+    }
 
 
     int servernum = 0;
     int i = 0;
     for (int j = 0; j != this->numRacks; j++) {
-        int location = locations[i++];
-        Rack* serverRack = this->racks[location / this->rackSize];
-        int hostIndex = location % this->rackSize;
+        std::pair<int, int> location = this->hostAt(locations[i++]);
+        int serverRack = location.first;
+        int hostIndex = location.second;
 
-        ParameterServerHelper paramServer (9);
-        paramServer.SetAttribute ("NumWorkers", UintegerValue (this->rackSize - 1));
-        paramServer.SetAttribute ("ServerNum", UintegerValue (servernum));
-        ApplicationContainer serverApps = paramServer.Install (serverRack->hosts.Get (hostIndex));
-        serverApps.Start(Seconds(1.0));
+        // Every server gets as many workers as a rack of the same number holds.
+        this->installServer(serverRack, hostIndex, servernum, this->size(j) - 1);
 
         int clientnum = 0;
-        for (int k = 1; k != this->rackSize; k++) {
-            int clientLocation = locations[i++];
-            Rack* clientRack = this->racks[clientLocation / this->rackSize];
-            int clientHostIndex = clientLocation % this->rackSize;
+        for (int k = 1; k != this->size(j); k++) {
+            std::pair<int, int> clientLocation = this->hostAt(locations[i++]);
+            this->installClient(clientLocation.first, clientLocation.second,
+                                serverRack, hostIndex, servernum, clientnum++);
+        }
+        servernum++;
 
-            ParameterClientHelper paramClient (serverRack->hostIPs.GetAddress (hostIndex), 9);
-            paramClient.SetAttribute("ClientNum", UintegerValue(clientnum++));
-            paramClient.SetAttribute("ServerNum", UintegerValue(servernum));
+    }
+}
 
-            ApplicationContainer clientApps = paramClient.Install (clientRack->hosts.Get (clientHostIndex));
-            clientApps.Start(Seconds(1.0));
+// Undirected, so that every worker accepts a connection from each of the
+// neighbors it connects to.
+static void addEdge(std::vector<std::set<int> >& neighbors, int a, int b) {
+    if (a != b) {
+        neighbors[a].insert(b);
+        neighbors[b].insert(a);
+    }
+}
+
+/**
+ * Run decentralized SGD with a gossip worker on every host instead of
+ * parameter servers.  Hosts are numbered rack by rack, and graph picks
+ * their neighbors:
+ *  - ring: the previous and the next host
+ *  - torus: racks as rows, neighbors left, right, above and below
+ *  - expander: the union of degree/2 random rings, a random expander
+ *  - rack: a ring inside every rack, plus one gateway host per rack in a
+ *    ring of racks, so that only one model per rack and direction crosses
+ *    the uplinks
+ */
+void Topology::setGossip(std::string graph, int degree) {
+    if (this->rackSize == 0) {
+        NS_FATAL_ERROR ("--gossip needs racks of the same size");
+    }
+    int n = this->numRacks * this->rackSize;
+    std::vector<std::set<int> > neighbors(n);
+
+    if (graph == "ring") {
+        for (int i = 0; i != n; i++) {
+            addEdge(neighbors, i, (i + 1) % n);
         }
-        servernum++;
+    } else if (graph == "torus") {
+        for (int i = 0; i != this->numRacks; i++) {
+            for (int j = 0; j != this->rackSize; j++) {
+                addEdge(neighbors, i * this->rackSize + j, i * this->rackSize + (j + 1) % this->rackSize);
+                addEdge(neighbors, i * this->rackSize + j, (i + 1) % this->numRacks * this->rackSize + j);
+            }
+        }
+    } else if (graph == "expander") {
+        Ptr<UniformRandomVariable> shuffle = CreateObject<UniformRandomVariable>();
+        shuffle->SetStream(0);
+        std::vector<int> order(n);
+        for (int i = 0; i != n; i++) {
+            order[i] = i;
+        }
+        for (int cycle = 0; cycle < std::max(1, degree / 2); cycle++) {
+            for (int i = n - 1; i > 0; i--) {
+                std::swap(order[i], order[shuffle->GetInteger(0, i)]);
+            }
+            for (int i = 0; i != n; i++) {
+                addEdge(neighbors, order[i], order[(i + 1) % n]);
+            }
+        }
+    } else if (graph == "rack") {
+        for (int i = 0; i != this->numRacks; i++) {
+            for (int j = 0; j != this->rackSize; j++) {
+                addEdge(neighbors, i * this->rackSize + j, i * this->rackSize + (j + 1) % this->rackSize);
+            }
+            // Host i + 1 of rack i links to host i + 1 of the next rack,
+            // which in turn reaches on through its host i + 2 (modulo the
+            // rack size).  With more than one host per rack no host is the
+            // gateway to both neighboring racks.
+            int next = (i + 1) % this->numRacks;
+            addEdge(neighbors, i * this->rackSize + (i + 1) % this->rackSize, next * this->rackSize + next % this->rackSize);
+        }
+    } else {
+        NS_FATAL_ERROR ("Unknown gossip graph " << graph);
+    }
+
+    for (int i = 0; i != n; i++) {
+        GossipWorkerHelper helper (9);
+        helper.SetAttribute ("WorkerNum", UintegerValue (i));
+        if (this->fluid != 0) {
+            helper.SetAttribute ("FluidNetwork", PointerValue (this->fluid));
+        }
+        ApplicationContainer apps = helper.Install (this->racks[i / this->rackSize]->hosts.Get (i % this->rackSize));
+        Ptr<GossipWorker> worker = DynamicCast<GossipWorker>(apps.Get(0));
+        for (std::set<int>::const_iterator it = neighbors[i].begin(); it != neighbors[i].end(); ++it) {
+            worker->AddNeighbor(this->racks[*it / this->rackSize]->hostIPs.GetAddress(*it % this->rackSize));
+        }
+        apps.Start(Seconds(1.0));
+        this->gossipWorkers.Add(apps);
+    }
+}
+
+/**
+ * \return values[i], or the last value for i past the end
+ */
+static double stageValue(const std::vector<double>& values, int i) {
+    return values[std::min(i, (int) values.size() - 1)];
+}
+
+/**
+ * Run as many pipelines of numStages stages as there are hosts for.  With
+ * the rack placement consecutive stages go to consecutive hosts of a rack,
+ * with spread to the same host of consecutive racks.  The per-stage lists
+ * repeat their last value; empty ones keep the attribute defaults.
+ */
+void Topology::setPipeline(std::string placement, int numStages, const std::vector<double>& forwardTimes,
+                           const std::vector<double>& backwardTimes, const std::vector<double>& activationSizes) {
+    if (this->rackSize == 0) {
+        NS_FATAL_ERROR ("--pipeline needs racks of the same size");
+    }
+    int n = this->numRacks * this->rackSize;
+    std::vector<std::pair<int, int> > hosts;
+    if (placement == "rack") {
+        for (int i = 0; i != n; i++) {
+            hosts.push_back(std::make_pair(i / this->rackSize, i % this->rackSize));
+        }
+    } else if (placement == "spread") {
+        for (int i = 0; i != n; i++) {
+            hosts.push_back(std::make_pair(i % this->numRacks, i / this->numRacks));
+        }
+    } else {
+        NS_FATAL_ERROR ("Unknown pipeline placement " << placement);
+    }
+    if (numStages < 1 || numStages > n) {
+        NS_FATAL_ERROR ("Cannot place pipelines of " << numStages << " stages on " << n << " hosts");
+    }
+
+    for (int p = 0; p != n / numStages; p++) {
+        for (int i = 0; i != numStages; i++) {
+            std::pair<int, int> host = hosts[p * numStages + i];
+            PipelineStageHelper helper (9);
+            helper.SetAttribute ("PipelineNum", UintegerValue (p));
+            helper.SetAttribute ("StageNum", UintegerValue (i));
+            helper.SetAttribute ("NumStages", UintegerValue (numStages));
+            if (i + 1 < numStages) {
+                std::pair<int, int> next = hosts[p * numStages + i + 1];
+                helper.SetAttribute ("NextAddress", AddressValue (this->racks[next.first]->hostIPs.GetAddress (next.second)));
+            }
+            if (!forwardTimes.empty()) {
+                helper.SetAttribute ("ForwardTime", DoubleValue (stageValue(forwardTimes, i)));
+            }
+            if (!backwardTimes.empty()) {
+                helper.SetAttribute ("BackwardTime", DoubleValue (stageValue(backwardTimes, i)));
+            } else if (!forwardTimes.empty()) {
+                helper.SetAttribute ("BackwardTime", DoubleValue (2.0 * stageValue(forwardTimes, i)));
+            }
+            if (!activationSizes.empty()) {
+                helper.SetAttribute ("ActivationSize", UintegerValue ((uint32_t) stageValue(activationSizes, i)));
+                if (i > 0) {
+                    helper.SetAttribute ("InputActivationSize", UintegerValue ((uint32_t) stageValue(activationSizes, i - 1)));
+                }
+            }
+            if (this->fluid != 0) {
+                helper.SetAttribute ("FluidNetwork", PointerValue (this->fluid));
+            }
+            ApplicationContainer apps = helper.Install (this->racks[host.first]->hosts.Get (host.second));
+            apps.Start(Seconds(1.0));
+            this->pipelineStages.Add(apps);
+        }
+    }
+}
+
+void Topology::monitorLinks(LinkMonitor& monitor) {
+    for (int i = 0; i != this->numRacks; i++) {
+        Rack* rack = this->racks[i];
+        for (size_t j = 0; j != rack->links.size(); j++) {
+            std::ostringstream name;
+            name << "rack" << i << "-host" << j;
+            monitor.AddLink(name.str(), "host", rack->links[j]);
+        }
+
+    }
+    for (size_t i = 0; i != this->uplinks.size(); i++) {
+        monitor.AddLink(this->uplinkName(i), "uplink", this->uplinks[i]);
+    }
+    for (size_t i = 0; i != this->coreLinks.size(); i++) {
+        std::ostringstream name;
+        name << "core" << i;
+        monitor.AddLink(name.str(), "core", this->coreLinks[i]);
+    }
+}
+
+std::string Topology::uplinkName(size_t i) const {
+    int k = 0;
+    for (size_t j = 0; j != i; j++) {
+        if (this->uplinkRacks[j] == this->uplinkRacks[i]) {
+            k++;
+        }
+    }
+    std::ostringstream name;
+    name << "rack" << this->uplinkRacks[i] << "-uplink";
+    if (k > 0) {
+        name << k;
+    }
+    return name.str();
+}
+
+void Topology::checkUplinks(const LinkMonitor& monitor) const {
+    std::map<int, std::vector<size_t> > rackUplinks;
+    for (size_t i = 0; i != this->uplinks.size(); i++) {
+        rackUplinks[this->uplinkRacks[i]].push_back(i);
+    }
+    for (std::map<int, std::vector<size_t> >::const_iterator it = rackUplinks.begin(); it != rackUplinks.end(); ++it) {
+        const std::vector<size_t>& links = it->second;
+        uint64_t total = 0;
+        for (size_t j = 0; j != links.size(); j++) {
+            total += monitor.GetTotalBytes(this->uplinkName(links[j]));
+        }
+        if (links.size() < 2 || total == 0) {
+            continue;
+        }
+        for (size_t j = 0; j != links.size(); j++) {
+            if (monitor.GetTotalBytes(this->uplinkName(links[j])) == 0) {
+                std::cout << "Warning: " << this->uplinkName(links[j]) << " carried nothing while the other uplinks of rack "
+                          << it->first << " carried " << total << " bytes" << std::endl;
+            }
+        }
+    }
+}
+
+void Topology::registerHosts(JobScheduler& scheduler) {
+    for (int i = 0; i != this->numRacks; i++) {
+        for (int j = 0; j != this->size(i); j++) {
+            scheduler.AddHost(i, this->racks[i]->hosts.Get(j), this->racks[i]->hostIPs.GetAddress(j));
+        }
+    }
+}
+
+void Topology::useFluidNetwork(Ptr<FluidNetwork> network) {
+    for (int i = 0; i != this->numRacks; i++) {
+        Rack* rack = this->racks[i];
+        for (size_t j = 0; j != rack->links.size(); j++) {
+            network->AddLink(rack->links[j]);
+        }
+    }
+    for (size_t i = 0; i != this->uplinks.size(); i++) {
+        network->AddLink(this->uplinks[i]);
+    }
+    for (size_t i = 0; i != this->coreLinks.size(); i++) {
+        network->AddLink(this->coreLinks[i]);
+    }
+    this->fluid = network;
+}
+
+static void writeQuantiles(std::ostream& os, std::string server, std::string metric, const TDigest& sketch) {
+    os << server << "," << metric << "," << sketch.GetCount() << "," << sketch.GetMean()
+       << "," << sketch.Quantile(0.5) << "," << sketch.Quantile(0.9)
+       << "," << sketch.Quantile(0.99) << "," << sketch.Quantile(0.999) << std::endl;
+}
 
+/**
+ * Write the busy and bubble fraction of every pipeline stage to
+ * <prefix>-pipeline.csv and print the throughput.
+ */
+static void writePipelineReport(const ApplicationContainer& stages, std::string prefix, uint32_t numStages, uint32_t numMicroBatches) {
+    std::string filename = prefix + "-pipeline.csv";
+    std::ofstream output(filename.c_str());
+    output << "pipeline,stage,mini_batches,mean_iteration_time,busy_fraction,bubble_fraction" << std::endl;
+    double bubbleSum = 0.0;
+    double throughput = 0.0;
+    for (uint32_t i = 0; i != stages.GetN(); i++) {
+        Ptr<PipelineStage> stage = DynamicCast<PipelineStage>(stages.Get(i));
+        const TDigest& times = stage->GetIterationTimes();
+        output << stage->GetPipelineNum() << "," << stage->GetStageNum() << "," << stage->GetCompletedIterations()
+               << "," << times.GetMean() << "," << stage->GetBusyFraction() << "," << 1.0 - stage->GetBusyFraction() << std::endl;
+        bubbleSum += 1.0 - stage->GetBusyFraction();
+        if (stage->GetStageNum() + 1 == numStages && times.GetCount() > 0 && times.GetMean() > 0) {
+            throughput += numMicroBatches / times.GetMean();
+        }
+    }
+    std::cout << stages.GetN() / numStages << " pipelines of " << numStages << " stages: "
+              << throughput << " micro-batches/s, mean bubble fraction " << bubbleSum / std::max(1u, stages.GetN())
+              << " (" << (numStages - 1.0) / (numMicroBatches + numStages - 1.0) << " with balanced stages and no network)" << std::endl;
+}
+
+/**
+ * Parse a comma-separated list of numbers.
+ */
+static std::vector<double> parseList(std::string list) {
+    std::vector<double> values;
+    std::istringstream input(list);
+    std::string item;
+    while (std::getline(input, item, ',')) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+struct RescaleEvent {
+    double at;
+    char kind; // + joins, - leaves gracefully, x fails
+    int count;
+    std::string change;
+};
+
+/**
+ * Parse a comma-separated list of time:change rescale events, where the
+ * change is +n, -n or xn workers.
+ */
+static std::vector<RescaleEvent> parseRescale(std::string list) {
+    std::vector<RescaleEvent> events;
+    std::istringstream input(list);
+    std::string item;
+    while (std::getline(input, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos || colon + 2 > item.size()
+            || (item[colon + 1] != '+' && item[colon + 1] != '-' && item[colon + 1] != 'x')) {
+            NS_FATAL_ERROR ("Expected time:+n, time:-n or time:xn in --rescale, got " << item);
+        }
+        RescaleEvent event;
+        event.at = std::atof(item.substr(0, colon).c_str());
+        event.kind = item[colon + 1];
+        event.count = std::atoi(item.substr(colon + 2).c_str());
+        event.change = item.substr(colon + 1);
+        if (event.at <= 1.0 || event.count <= 0) {
+            NS_FATAL_ERROR ("--rescale needs a time after the start at 1s and a positive count, got " << item);
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+static void rescale(Topology* topology, ElasticMonitor* monitor, RescaleEvent event) {
+    std::set<uint32_t> servers;
+    for (int i = 0; i != event.count; i++) {
+        int server = event.kind == '+' ? topology->joinWorker() : topology->removeWorker(event.kind == 'x');
+        if (server >= 0) {
+            servers.insert(server);
+        }
+    }
+    monitor->AddEvent(event.change, servers);
+}
+
+void writeQuantileReport(const ApplicationContainer& servers, std::string prefix, uint32_t cdfPoints) {
+    const char* metrics[] = { "iteration", "push", "wait" };
+    // Merge at the finest compression of the servers' sketches.
+    double compression = TDigest().GetCompression();
+    for (uint32_t i = 0; i != servers.GetN(); i++) {
+        compression = std::max(compression, DynamicCast<ParameterServer>(servers.Get(i))->GetIterationTimes().GetCompression());
+    }
+    std::vector<TDigest> global(3, TDigest(compression));
+
+    std::string filename = prefix + "-quantiles.csv";
+    std::ofstream table(filename.c_str());
+    table << "server,metric,count,mean,p50,p90,p99,p99.9" << std::endl;
+    for (uint32_t i = 0; i != servers.GetN(); i++) {
+        Ptr<ParameterServer> server = DynamicCast<ParameterServer>(servers.Get(i));
+        const TDigest* sketches[] = { &server->GetIterationTimes(), &server->GetPushLatencies(), &server->GetWaitTimes() };
+
+        std::ostringstream num;
+        num << server->GetServerNum();
+        for (int m = 0; m != 3; m++) {
+            writeQuantiles(table, num.str(), metrics[m], *sketches[m]);
+            global[m].Merge(*sketches[m]);
+        }
+    }
+    for (int m = 0; m != 3; m++) {
+        writeQuantiles(table, "all", metrics[m], global[m]);
+    }
+
+    filename = prefix + "-cdf.csv";
+    std::ofstream cdf(filename.c_str());
+    cdf << "metric,quantile,value" << std::endl;
+    for (int m = 0; m != 3; m++) {
+        for (uint32_t k = 0; k <= cdfPoints; k++) {
+            double q = (double) k / cdfPoints;
+            cdf << metrics[m] << "," << q << "," << global[m].Quantile(q) << std::endl;
+        }
+    }
+
+    std::cout << "Iteration time over " << global[0].GetCount() << " iterations:"
+              << " p50 " << global[0].Quantile(0.5) << "s"
+              << " p90 " << global[0].Quantile(0.9) << "s"
+              << " p99 " << global[0].Quantile(0.99) << "s"
+              << " p99.9 " << global[0].Quantile(0.999) << "s" << std::endl;
+}
+
+struct RunOptions {
+    int numRacks;
+    int rackSize;
+    std::string placement;
+    double stopTime;
+    bool summary;
+    uint32_t updateSize;
+    bool monitorLinks;
+    double monitorInterval;
+    uint32_t monitorTopN;
+    bool criticalPath;
+    bool quantiles;
+    uint32_t cdfPoints;
+    bool profile;
+    double profileInterval;
+    bool trace;
+    uint32_t traceBuffer;
+    bool traceRing;
+    bool converge;
+    uint32_t warmupIterations;
+    double precision;
+    double confidence;
+    uint32_t minSamples;
+    std::string branches;
+    double branchAt;
+    uint32_t branchJobs;
+    std::string jobs;
+    std::string schedulerPolicy;
+    std::string gossip;
+    int gossipDegree;
+    std::string pipeline;
+    std::string pipelinePlacement;
+    uint32_t pipelineStages;
+    uint32_t microBatches;
+    std::string stageForwardTimes;
+    std::string stageBackwardTimes;
+    std::string activationSizes;
+    uint32_t localSteps;
+    bool adaptiveLocalSteps;
+    std::string pacing;
+    uint32_t creditWindow;
+    uint32_t mtu;
+    std::string aggregation;
+    uint32_t gpusPerHost;
+    std::string rescale;
+    double rescaleWindow;
+    std::string coflow;
+    std::string topology;
+    bool timeToAccuracy;
+    std::string computeModel;
+    uint32_t traceBlock;
+    bool telemetry;
+    double telemetryInterval;
+    std::string telemetryClock;
+};
+
+static void countDrop(uint64_t* drops, Ptr<const Packet> packet) {
+    (*drops)++;
+}
+
+struct RunResult {
+    TDigest iterationTimes;
+    TDigest barrierTimes;
+    double wallTime;
+    uint64_t events;
+};
+
+/**
+ * Write the results of all branches of a run to <prefix>-branches.csv.
+ */
+static void writeBranchReport(const BranchRunner& runner, std::string prefix) {
+    std::string filename = prefix + "-branches.csv";
+    std::ofstream output(filename.c_str());
+    output << "branch,iterations,mean_iteration_time,p50_iteration_time,p99_iteration_time,wall_time" << std::endl;
+    for (uint32_t i = 0; i != runner.GetN(); i++) {
+        const std::string& result = runner.GetResults()[i];
+        output << runner.GetName(i) << "," << (result.empty() ? ",,,," : result) << std::endl;
+        std::cout << "Branch " << runner.GetName(i) << ": "
+                  << (result.empty() ? "failed" : "iterations,mean,p50,p99,wall_time = " + result) << std::endl;
     }
 }
 
+/**
+ * Build the topology, run the simulation over the packet-level or the
+ * fluid network and write the reports enabled in the options, prefixing
+ * their file names with prefix.
+ */
+static RunResult runSimulation(const RunOptions& options, std::string network, std::string prefix) {
+    if (options.trace) {
+        EventTrace::Enable(prefix + "-events.bin", options.traceBuffer, options.traceRing);
+    }
+
+    std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now ();
+
+    // Coflow priorities need priority queues at every device.
+    std::string queue = options.coflow != "fair" ? "ns3::CoflowQueue" : "";
+    Topology* topology;
+    if (options.topology.empty()) {
+        topology = new Topology(options.numRacks, options.rackSize, queue);
+    } else {
+        topology = new Topology(TopologyFile(options.topology), queue);
+    }
+    if (options.coflow != "fair") {
+        topology->coflows = CreateObject<CoflowScheduler>();
+        topology->coflows->SetAttribute("Policy", StringValue (options.coflow));
+    }
+    if (options.timeToAccuracy) {
+        topology->accuracy = CreateObject<AccuracyModel>();
+    }
+
+    Ptr<FluidNetwork> fluid;
+    if (network == "fluid") {
+        fluid = CreateObject<FluidNetwork>();
+        topology->useFluidNetwork(fluid);
+    } else {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+
+    // With a job trace the scheduler installs the applications as jobs
+    // start, instead of one fixed placement.
+    JobScheduler scheduler (JobScheduler::ParsePolicy(options.schedulerPolicy), prefix);
+    if (!options.jobs.empty()) {
+        topology->registerHosts(scheduler);
+        if (fluid != 0) {
+            scheduler.SetFluidNetwork(fluid);
+        }
+        scheduler.LoadTrace(options.jobs);
+    } else if (!options.gossip.empty()) {
+        topology->setGossip(options.gossip, options.gossipDegree);
+    } else if (!options.pipeline.empty()) {
+        topology->setPipeline(options.pipelinePlacement, options.pipelineStages, parseList(options.stageForwardTimes),
+                              parseList(options.stageBackwardTimes), parseList(options.activationSizes));
+    } else if (options.placement == "random") {
+        topology->setRandom();
+    } else if (options.placement == "stride") {
+        topology->setStride();
+    } else if (options.placement == "cluster") {
+        topology->setCluster();
+    } else if (options.placement == "colocate") {
+        topology->setColocate();
+    } else {
+        NS_FATAL_ERROR ("Unknown placement " << options.placement);
+    }
+
+    // Drops at any device queue, most of them at the port towards a server
+    // that many workers push to at once.
+    uint64_t drops = 0;
+    if (fluid == 0) {
+        Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::CsmaNetDevice/MacTxDrop", MakeBoundCallback (&countDrop, &drops));
+        Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::CsmaNetDevice/PhyTxDrop", MakeBoundCallback (&countDrop, &drops));
+        // Packets pushed out of a CoflowQueue to make room for more urgent ones.
+        Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::CsmaNetDevice/TxQueue/DropAfterDequeue", MakeBoundCallback (&countDrop, &drops));
+    }
+
+    LinkMonitor monitor (Seconds (options.monitorInterval), prefix, options.monitorTopN);
+    if (options.monitorLinks) {
+        topology->monitorLinks(monitor);
+        monitor.EnableFlowMonitor(9);
+        monitor.Start(Seconds(1.0));
+    }
+
+    CriticalPathAnalyzer analyzer (prefix);
+    if (options.criticalPath) {
+        for (std::map<std::pair<int, int>, int>::const_iterator it = topology->workerRacks.begin (); it != topology->workerRacks.end (); ++it) {
+            analyzer.SetWorkerRack(it->first.first, it->first.second, it->second);
+        }
+        analyzer.Connect();
+    }
+
+    // Workers join, leave and fail while the servers keep training.
+    ElasticMonitor elastic (prefix, Seconds (options.rescaleWindow));
+    std::vector<RescaleEvent> rescaleEvents = parseRescale(options.rescale);
+    if (!rescaleEvents.empty()) {
+        elastic.Connect();
+        for (size_t i = 0; i != rescaleEvents.size(); i++) {
+            Simulator::Schedule (Seconds (rescaleEvents[i].at), &rescale, topology, &elastic, rescaleEvents[i]);
+        }
+    }
+
+    SimProfiler profiler (Seconds (options.profileInterval), prefix);
+    uint64_t eventsBefore = options.profile ? ProfilingSimulatorImpl::GetEventCount () : 0;
+    if (options.profile) {
+        profiler.Start();
+    }
+
+    std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
+
+    // Run the shared part once, then continue every branch in its own
+    // process; the parent only collects their results.
+    BranchRunner runner (options.branches, options.branchJobs);
+    int branch = -1;
+    if (runner.GetN() > 0) {
+        Simulator::Stop (Seconds(options.branchAt));
+        Simulator::Run ();
+        branch = runner.Fork();
+        if (branch < 0) {
+            writeBranchReport(runner, prefix);
+            Simulator::Destroy ();
+            return RunResult();
+        }
+        runner.Apply(branch);
+        prefix = prefix + "-" + runner.GetName(branch);
+        runStart = std::chrono::steady_clock::now ();
+    }
+
+    // Connected after the branch point so that they only see the branch.
+    ConvergenceMonitor convergence (prefix, options.warmupIterations, options.precision,
+                                    options.confidence, options.minSamples);
+    if (options.converge) {
+        convergence.Connect();
+    }
+
+    Telemetry telemetry (Seconds (options.telemetryInterval), options.telemetryClock == "wall",
+                         Seconds (options.stopTime), prefix);
+    if (options.telemetry) {
+        telemetry.Start();
+    }
+
+    RunSummary runSummary;
+    if (options.summary || branch >= 0) {
+        runSummary.Connect();
+        // Job servers are only installed as their jobs start.
+        scheduler.SetRunSummary(&runSummary);
+    }
+
+    Simulator::Stop (Seconds(options.stopTime) - Simulator::Now ());
+    Simulator::Run ();
+    std::chrono::steady_clock::time_point runEnd = std::chrono::steady_clock::now ();
+    EventTrace::Disable();
+    if (options.telemetry) {
+        telemetry.Stop();
+    }
+
+    RunResult result;
+    result.wallTime = std::chrono::duration<double> (runEnd - runStart).count ();
+    result.events = options.profile ? ProfilingSimulatorImpl::GetEventCount () - eventsBefore : 0;
+    for (uint32_t i = 0; i != topology->servers.GetN(); i++) {
+        result.iterationTimes.Merge(DynamicCast<ParameterServer>(topology->servers.Get(i))->GetIterationTimes());
+    }
+    for (uint32_t i = 0; i != topology->gossipWorkers.GetN(); i++) {
+        result.iterationTimes.Merge(DynamicCast<GossipWorker>(topology->gossipWorkers.Get(i))->GetIterationTimes());
+    }
+    for (uint32_t i = 0; i != topology->pipelineStages.GetN(); i++) {
+        result.iterationTimes.Merge(DynamicCast<PipelineStage>(topology->pipelineStages.Get(i))->GetIterationTimes());
+    }
+
+    if (options.profile) {
+        profiler.Report();
+    }
+    if (options.monitorLinks) {
+        monitor.Report();
+        topology->checkUplinks(monitor);
+    }
+    if (options.criticalPath) {
+        analyzer.Report();
+    }
+    if (options.quantiles) {
+        writeQuantileReport(topology->servers, prefix, options.cdfPoints);
+    }
+    if (options.converge) {
+        convergence.Report();
+    }
+    if (!options.jobs.empty()) {
+        scheduler.Report();
+    }
+    if (!rescaleEvents.empty()) {
+        elastic.Report();
+    }
+    if (options.timeToAccuracy) {
+        topology->accuracy->Report(prefix);
+    }
+    // Local SGD trades compute steps against traffic to the servers.
+    double elapsed = (Simulator::Now () - Seconds (1.0)).GetSeconds ();
+    uint64_t localSteps = 0;
+    uint64_t bytesExchanged = 0;
+    for (uint32_t i = 0; i != topology->clients.GetN(); i++) {
+        Ptr<ParameterClient> client = DynamicCast<ParameterClient>(topology->clients.Get(i));
+        localSteps += client->GetLocalSteps();
+        bytesExchanged += client->GetBytesExchanged();
+    }
+    if (options.localSteps > 1 || options.adaptiveLocalSteps) {
+        std::cout << "Local SGD: " << localSteps / std::max(elapsed, 1e-9) << " worker steps/s, "
+                  << bytesExchanged / std::max(elapsed, 1e-9) << " bytes/s exchanged with the servers, "
+                  << (double) bytesExchanged / std::max<uint64_t>(localSteps, 1) << " bytes per step" << std::endl;
+    }
+    uint64_t retransmits = 0;
+    for (uint32_t i = 0; i != topology->clients.GetN(); i++) {
+        retransmits += DynamicCast<ParameterClient>(topology->clients.Get(i))->GetRetransmits();
+    }
+    TDigest pushSpreads;
+    for (uint32_t i = 0; i != topology->servers.GetN(); i++) {
+        pushSpreads.Merge(DynamicCast<ParameterServer>(topology->servers.Get(i))->GetPushSpreads());
+    }
+    if (fluid == 0 && topology->servers.GetN() > 0) {
+        std::cout << "Incast with " << options.pacing << " pacing: " << drops << " drops, " << retransmits
+                  << " retransmitted segments, push completion spread mean " << pushSpreads.GetMean() << "s p99 "
+                  << pushSpreads.Quantile(0.99) << "s" << std::endl;
+    }
+    // Split the server side of an iteration into waiting for the workers
+    // and the network, and aggregating on the server's cores.
+    TDigest barrierTimes;
+    TDigest aggregationTails;
+    double aggregationBusy = 0.0;
+    double aggregationCapacity = 0.0;
+    for (uint32_t i = 0; i != topology->servers.GetN(); i++) {
+        Ptr<ParameterServer> server = DynamicCast<ParameterServer>(topology->servers.Get(i));
+        barrierTimes.Merge(server->GetBarrierTimes());
+        aggregationTails.Merge(server->GetAggregationTails());
+        aggregationBusy += server->GetAggregationBusyTime();
+        aggregationCapacity += server->GetAggregationCores() * elapsed;
+    }
+    result.barrierTimes = barrierTimes;
+    if (options.aggregation == "resource" && topology->servers.GetN() > 0) {
+        std::cout << "Server time per iteration: " << barrierTimes.GetMean() << "s waiting for workers and network, "
+                  << aggregationTails.GetMean() << "s CPU-bound after the barrier, aggregation cores "
+                  << 100.0 * aggregationBusy / std::max(aggregationCapacity, 1e-9) << "% busy" << std::endl;
+    }
+
+    // CPU time the network stacks of all hosts spent on packets.
+    // And the share of the time workers spent reducing and broadcasting
+    // between the GPUs of their host.
+    double hostCpuTime = 0.0;
+    double intraHostTime = 0.0;
+    uint32_t gpuHosts = 0;
+    // As set by --gpusPerHost or by ns3::GpuHost::Gpus.
+    uint32_t gpusPerHost = 1;
+    for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it) {
+        Ptr<HostCost> cost = (*it)->GetObject<HostCost> ();
+        if (cost != 0) {
+            hostCpuTime += cost->GetBusyTime ().GetSeconds ();
+        }
+        Ptr<GpuHost> gpus = (*it)->GetObject<GpuHost> ();
+        if (gpus != 0) {
+            intraHostTime += gpus->GetLocalTime ().GetSeconds ();
+            gpusPerHost = std::max(gpusPerHost, gpus->GetGpus ());
+            gpuHosts++;
+        }
+    }
+    double intraHostShare = intraHostTime / std::max(gpuHosts * elapsed, 1e-9);
+    if (gpusPerHost > 1) {
+        std::cout << gpusPerHost << " GPUs per host: intra-host reduce and broadcast take "
+                  << 100.0 * intraHostShare << "% of the workers' time" << std::endl;
+    }
+    if (!options.pipeline.empty()) {
+        writePipelineReport(topology->pipelineStages, prefix, options.pipelineStages, options.microBatches);
+    }
+    if (options.summary) {
+        if (!options.topology.empty()) {
+            runSummary.Set("topology", options.topology);
+        }
+        runSummary.Set("num_racks", topology->numRacks);
+        runSummary.Set("rack_size", topology->rackSize);
+        if (!options.gossip.empty()) {
+            runSummary.Set("placement", "gossip-" + options.gossip);
+        } else if (!options.pipeline.empty()) {
+            runSummary.Set("placement", options.pipeline + "-" + options.pipelinePlacement);
+            runSummary.Set("pipeline_stages", options.pipelineStages);
+            runSummary.Set("micro_batches", options.microBatches);
+        } else if (!options.jobs.empty()) {
+            runSummary.Set("placement", "jobs-" + options.schedulerPolicy);
+        } else {
+            runSummary.Set("placement", options.placement);
+        }
+        runSummary.Set("update_size", options.updateSize);
+        if (options.mtu != 0) {
+            runSummary.Set("mtu", options.mtu);
+        }
+        runSummary.Set("host_cpu_time", hostCpuTime);
+        runSummary.Set("gpus_per_host", gpusPerHost);
+        runSummary.Set("intra_host_share", intraHostShare);
+        runSummary.Set("network", network);
+        runSummary.Set("sim_time", Simulator::Now ().GetSeconds ());
+        runSummary.Set("setup_wall_time", std::chrono::duration<double> (runStart - setupStart).count ());
+        runSummary.Set("wall_time", result.wallTime);
+        if (topology->clients.GetN() > 0) {
+            runSummary.Set("local_steps", options.localSteps);
+            runSummary.Set("adaptive_local_steps", options.adaptiveLocalSteps ? 1.0 : 0.0);
+            runSummary.Set("steps_per_second", localSteps / std::max(elapsed, 1e-9));
+            runSummary.Set("comm_bytes_per_second", bytesExchanged / std::max(elapsed, 1e-9));
+        }
+        if (topology->servers.GetN() > 0) {
+            runSummary.Set("pacing", options.pacing);
+            runSummary.Set("coflow", options.coflow);
+            runSummary.Set("aggregation", options.aggregation);
+            runSummary.Set("compute_model", options.computeModel);
+            runSummary.Set("mean_barrier_time", barrierTimes.GetMean());
+            runSummary.Set("mean_aggregation_tail", aggregationTails.GetMean());
+            if (options.aggregation == "resource") {
+                runSummary.Set("aggregation_utilization", aggregationBusy / std::max(aggregationCapacity, 1e-9));
+            }
+            runSummary.Set("mean_push_spread", pushSpreads.GetMean());
+            runSummary.Set("p99_push_spread", pushSpreads.Quantile(0.99));
+            if (fluid == 0) {
+                runSummary.Set("drops", drops);
+                runSummary.Set("retransmits", retransmits);
+            }
+        }
+        runSummary.Set("peak_rss_kb", SimProfiler::GetPeakRss ());
+        if (options.profile) {
+            runSummary.Set("events", result.events);
+        }
+        if (fluid != 0) {
+            runSummary.Set("flows", fluid->GetFlowCount ());
+        }
+        if (options.converge) {
+            runSummary.Set("converged", convergence.IsConverged () ? 1.0 : 0.0);
+            runSummary.Set("steady_iterations", convergence.GetSampleCount ());
+            runSummary.Set("steady_mean_iteration_time", convergence.GetMean ());
+            runSummary.Set("steady_p99_iteration_time", convergence.GetP99 ());
+            // Intervals stay unbounded until there are enough samples.
+            if (convergence.GetMeanHalfWidth () < std::numeric_limits<double>::infinity ()) {
+                runSummary.Set("steady_mean_half_width", convergence.GetMeanHalfWidth ());
+            }
+            if (convergence.GetP99HalfWidth () < std::numeric_limits<double>::infinity ()) {
+                runSummary.Set("steady_p99_half_width", convergence.GetP99HalfWidth ());
+            }
+        }
+        if (!options.jobs.empty()) {
+            runSummary.Set("scheduler_policy", options.schedulerPolicy);
+            runSummary.Set("jobs", scheduler.GetJobCount ());
+            runSummary.Set("jobs_completed", scheduler.GetCompletedJobCount ());
+            runSummary.Set("mean_job_completion_time", scheduler.GetMeanCompletionTime ());
+            runSummary.Set("mean_job_queueing_time", scheduler.GetMeanQueueingTime ());
+        }
+        if (!rescaleEvents.empty()) {
+            runSummary.Set("rescale_events", elastic.GetEventCount ());
+            runSummary.Set("mean_rescale_recovery_time", elastic.GetMeanRecoveryTime ());
+            runSummary.Set("mean_rescale_throughput_dip", elastic.GetMeanThroughputDip ());
+        }
+        if (options.timeToAccuracy) {
+            runSummary.Set("iterations_per_second", topology->accuracy->GetIterationRate ());
+            runSummary.Set("progress_per_iteration", topology->accuracy->GetProgressPerIteration ());
+            runSummary.Set("accuracy_reached", topology->accuracy->GetReachedCount ());
+            // Without any progress the target is never reached.
+            if (topology->accuracy->GetTimeToAccuracy () < std::numeric_limits<double>::infinity ()) {
+                runSummary.Set("time_to_accuracy", topology->accuracy->GetTimeToAccuracy ());
+            }
+        }
+        if (branch >= 0) {
+            runSummary.Set("branch", runner.GetName(branch));
+            runSummary.Set("branch_at", options.branchAt);
+        }
+        runSummary.Write(prefix + "-summary.json");
+    }
+    if (branch >= 0) {
+        const TDigest& times = runSummary.GetIterationTimes();
+        std::ostringstream line;
+        line << times.GetCount() << "," << times.GetMean() << "," << times.Quantile(0.5) << ","
+             << times.Quantile(0.99) << "," << result.wallTime;
+        runner.SendResult(line.str());
+        std::exit(0);
+    }
+    Simulator::Destroy ();
+    return result;
+}
+
+/**
+ * Compare the iteration times of a fluid run against a packet-level run
+ * of the same scenario.
+ */
+static void writeValidationReport(const RunResult& packet, const RunResult& fluid, std::string prefix) {
+    const char* names[] = { "mean", "p50", "p90", "p99" };
+    double packetValues[] = { packet.iterationTimes.GetMean(), packet.iterationTimes.Quantile(0.5),
+                              packet.iterationTimes.Quantile(0.9), packet.iterationTimes.Quantile(0.99) };
+    double fluidValues[] = { fluid.iterationTimes.GetMean(), fluid.iterationTimes.Quantile(0.5),
+                             fluid.iterationTimes.Quantile(0.9), fluid.iterationTimes.Quantile(0.99) };
+
+    std::string filename = prefix + "-validation.csv";
+    std::ofstream output(filename.c_str());
+    output << "metric,packet,fluid,relative_error" << std::endl;
+    output << "iterations," << packet.iterationTimes.GetCount() << "," << fluid.iterationTimes.GetCount() << ","
+           << (packet.iterationTimes.GetCount() > 0 ? fluid.iterationTimes.GetCount() / packet.iterationTimes.GetCount() - 1.0 : 0.0) << std::endl;
+    std::cout << "Fluid vs packet-level iteration time:";
+    for (int i = 0; i != 4; i++) {
+        double error = packetValues[i] > 0 ? fluidValues[i] / packetValues[i] - 1.0 : 0.0;
+        output << names[i] << "," << packetValues[i] << "," << fluidValues[i] << "," << error << std::endl;
+        std::cout << " " << names[i] << " " << packetValues[i] << "s/" << fluidValues[i] << "s (" << 100.0 * error << "%)";
+    }
+    output << "wall_time," << packet.wallTime << "," << fluid.wallTime << ","
+           << (packet.wallTime > 0 ? fluid.wallTime / packet.wallTime - 1.0 : 0.0) << std::endl;
+    std::cout << ", " << (fluid.wallTime > 0 ? packet.wallTime / fluid.wallTime : 0.0) << "x faster" << std::endl;
+}
+
+/**
+ * Compare the iteration and barrier times of a run with coflow
+ * priorities against the per-flow fair-share baseline.
+ */
+static void writeCoflowReport(const RunResult& fair, const RunResult& coflow, std::string policy, std::string prefix) {
+    const char* names[] = { "mean_iteration_time", "p50_iteration_time", "p99_iteration_time",
+                            "mean_barrier_time", "p99_barrier_time" };
+    double fairValues[] = { fair.iterationTimes.GetMean(), fair.iterationTimes.Quantile(0.5), fair.iterationTimes.Quantile(0.99),
+                            fair.barrierTimes.GetMean(), fair.barrierTimes.Quantile(0.99) };
+    double coflowValues[] = { coflow.iterationTimes.GetMean(), coflow.iterationTimes.Quantile(0.5), coflow.iterationTimes.Quantile(0.99),
+                              coflow.barrierTimes.GetMean(), coflow.barrierTimes.Quantile(0.99) };
+
+    std::string filename = prefix + "-coflow.csv";
+    std::ofstream output(filename.c_str());
+    output << "metric,fair," << policy << ",speedup" << std::endl;
+    output << "iterations," << fair.iterationTimes.GetCount() << "," << coflow.iterationTimes.GetCount() << ","
+           << (fair.iterationTimes.GetCount() > 0 ? (double) coflow.iterationTimes.GetCount() / fair.iterationTimes.GetCount() : 0.0) << std::endl;
+    std::cout << "Coflow " << policy << " vs fair share:";
+    for (int i = 0; i != 5; i++) {
+        double speedup = coflowValues[i] > 0 ? fairValues[i] / coflowValues[i] : 0.0;
+        output << names[i] << "," << fairValues[i] << "," << coflowValues[i] << "," << speedup << std::endl;
+        std::cout << (i > 0 ? ", " : " ") << names[i] << " " << fairValues[i] << "s/" << coflowValues[i] << "s (" << speedup << "x)";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * Read a scenario file into command line arguments.  Every line is a
+ * "name = value" pair, where name is any flag of main, an attribute such
+ * as ns3::ParameterClient::ComputeTimeMean or a global value such as
+ * RngRun; '#' starts a comment.
+ */
+static std::vector<std::string> readScenario(std::string filename) {
+    std::ifstream input(filename.c_str());
+    if (!input.is_open()) {
+        NS_FATAL_ERROR ("Failed to open scenario " << filename);
+    }
+
+    std::vector<std::string> args;
+    std::string line;
+    int number = 0;
+    while (std::getline(input, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        if (equals == std::string::npos || equals == begin) {
+            NS_FATAL_ERROR (filename << ":" << number << ": expected name = value");
+        }
+        std::string name = line.substr(begin, line.find_last_not_of(" \t", equals - 1) + 1 - begin);
+        size_t valueBegin = line.find_first_not_of(" \t", equals + 1);
+        std::string value = valueBegin == std::string::npos ? "" : line.substr(valueBegin, line.find_last_not_of(" \t\r") + 1 - valueBegin);
+        args.push_back("--" + name + "=" + value);
+    }
+    return args;
+}
+
+/**
+ * Whether a flag was given on the command line or in the scenario.  The
+ * defaults that mirror a flag are only set for given flags, so that a
+ * scenario or command line can set the attribute itself.
+ */
+static bool flagGiven(const std::vector<std::string>& args, std::string name) {
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--" + name || args[i].compare(0, name.size() + 3, "--" + name + "=") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int
 main (int argc, char *argv[])
 {
+  RunOptions options;
+  options.monitorLinks = false;
+  options.monitorInterval = 0.1;
+  options.monitorTopN = 10;
+  options.criticalPath = false;
+  options.profile = false;
+  options.profileInterval = 1.0;
+  options.numRacks = 8;
+  options.rackSize = 8;
+  options.placement = "random";
+  options.updateSize = 0;
+  options.stopTime = 30.0;
+  options.summary = false;
+  options.quantiles = false;
+  options.cdfPoints = 100;
+  options.trace = false;
+  options.traceBuffer = 65536;
+  options.traceRing = false;
+  options.converge = false;
+  options.warmupIterations = 5;
+  options.precision = 0.02;
+  options.confidence = 0.95;
+  options.minSamples = 200;
+  options.branchAt = 10.0;
+  options.branchJobs = 0;
+  options.schedulerPolicy = "network";
+  options.gossipDegree = 4;
+  options.pipelinePlacement = "rack";
+  options.pipelineStages = 4;
+  options.microBatches = 8;
+  options.localSteps = 1;
+  options.adaptiveLocalSteps = false;
+  options.pacing = "none";
+  options.creditWindow = 29200;
+  options.mtu = 0;
+  options.aggregation = "normal";
+  options.gpusPerHost = 1;
+  options.rescaleWindow = 5.0;
+  options.coflow = "fair";
+  options.timeToAccuracy = false;
+  options.computeModel = "normal";
+  options.traceBlock = 0;
+  options.telemetry = false;
+  options.telemetryInterval = 10.0;
+  options.telemetryClock = "wall";
+  bool compareFair = false;
+  double failureTimeout = 0;
+  uint32_t joinTransferSize = 0;
+  double intraHostBandwidth = 0;
+  uint32_t aggregationCores = 1;
+  double packetCost = 0;
+  bool tso = false;
+  bool gro = false;
+  std::string pacingRate;
+  double slotDuration = 0;
+  std::string queueSize;
+  std::string outputPrefix = "sgdsim";
+  std::string network = "packet";
+  std::string scenario;
+
   CommandLine cmd;
-  cmd.Parse (argc, argv);
+  cmd.AddValue ("numRacks", "Number of racks", options.numRacks);
+  cmd.AddValue ("rackSize", "Number of hosts per rack", options.rackSize);
+  cmd.AddValue ("topology", "File describing the cluster fabric (node <name> host|tor|switch, link <a> <b> [rate=] [delay=] [queue=] lines), instead of --numRacks racks of --rackSize hosts", options.topology);
+  cmd.AddValue ("placement", "Placement of servers and workers: colocate, cluster, stride or random", options.placement);
+  cmd.AddValue ("updateSize", "Size in bytes of parameter and gradient updates (0 keeps the attribute defaults)", options.updateSize);
+  cmd.AddValue ("stopTime", "Simulated seconds to run, at most with --converge", options.stopTime);
+  cmd.AddValue ("converge", "Stop as soon as the mean and p99 iteration time are known to --precision", options.converge);
+  cmd.AddValue ("warmupIterations", "Iterations of every server excluded from the steady state", options.warmupIterations);
+  cmd.AddValue ("precision", "Target confidence interval half-width relative to the estimate", options.precision);
+  cmd.AddValue ("confidence", "Confidence level of the intervals", options.confidence);
+  cmd.AddValue ("minSamples", "Steady-state iterations needed before stopping early", options.minSamples);
+  cmd.AddValue ("computeModel", "Worker compute time: normal (fixed distribution) or trace (gradient_delay_data.txt replayed in order, from a different offset for every worker)", options.computeModel);
+  cmd.AddValue ("traceBlock", "Resample the replayed delay traces by a circular block bootstrap with blocks of this many iterations (0 replays them in order)", options.traceBlock);
+  cmd.AddValue ("localSteps", "Compute steps of a worker between two exchanges with its server (local SGD)", options.localSteps);
+  cmd.AddValue ("adaptiveLocalSteps", "Adapt the local steps to the observed sync time, starting from --localSteps", options.adaptiveLocalSteps);
+  cmd.AddValue ("pacing", "Pacing of the gradient pushes against incast: none, rate (token bucket), slots (staggered by worker) or credit (granted by the server)", options.pacing);
+  cmd.AddValue ("pacingRate", "Token bucket rate of every worker with --pacing=rate, e.g. 2Mbps", pacingRate);
+  cmd.AddValue ("slotDuration", "Seconds between the send slots of two workers with --pacing=slots", slotDuration);
+  cmd.AddValue ("creditWindow", "Bytes a server grants but has not yet received with --pacing=credit", options.creditWindow);
+  cmd.AddValue ("queueSize", "Size of every device queue, e.g. 100p (the default) or 1000p for deeper switch buffers", queueSize);
+  cmd.AddValue ("aggregation", "Server aggregation time: normal (fixed distribution), resource (summed on --aggregationCores as gradients arrive) or trace (aggregation_delay_data.txt replayed in order)", options.aggregation);
+  cmd.AddValue ("aggregationCores", "Cores of every server summing gradients with --aggregation=resource", aggregationCores);
+  cmd.AddValue ("gpusPerHost", "GPUs behind every worker, reducing and broadcasting over the intra-host interconnect", options.gpusPerHost);
+  cmd.AddValue ("intraHostBandwidth", "Bytes per second between two GPUs of a host (0 keeps the attribute default)", intraHostBandwidth);
+  cmd.AddValue ("mtu", "MTU of every device, with the TCP segment size and the application writes to match, e.g. 9000 for jumbo frames (0 keeps the attribute defaults)", options.mtu);
+  cmd.AddValue ("packetCost", "Seconds of host CPU time per packet sent or received", packetCost);
+  cmd.AddValue ("tso", "Segmentation offload: the host CPU pays per 64 KB sent instead of per packet", tso);
+  cmd.AddValue ("gro", "Receive offload: the host CPU pays per 64 KB received instead of per packet", gro);
+  cmd.AddValue ("coflow", "Switch scheduling of the parameter server traffic: fair (per-flow TCP fair share), sebf (smallest coflow bottleneck first) or las (least attained coflow service)", options.coflow);
+  cmd.AddValue ("compareFair", "Also run the fair-share baseline and compare the iteration times with --coflow", compareFair);
+  cmd.AddValue ("rescale", "Elastic membership: comma-separated time:change events, where the change is +n workers joining, -n leaving or xn failing, e.g. 10:+4,20:x2", options.rescale);
+  cmd.AddValue ("rescaleWindow", "Seconds of the throughput windows before and after a rescale event", options.rescaleWindow);
+  cmd.AddValue ("failureTimeout", "Seconds a server waits for a gradient before it presumes the worker failed (0 keeps the attribute default)", failureTimeout);
+  cmd.AddValue ("joinTransferSize", "Bytes of the full model a joining worker receives first (0 for the parameter update size)", joinTransferSize);
+  cmd.AddValue ("timeToAccuracy", "Estimate the time to the target accuracy of every server from the statistical efficiency of its iterations (see the ns3::AccuracyModel attributes)", options.timeToAccuracy);
+  cmd.AddValue ("network", "Network model: packet (TCP over CSMA), fluid (max-min fair flows) or validate (run both and compare)", network);
+  cmd.AddValue ("branches", "Variations to continue from the state at --branchAt, each in a forked process: name:Type::Attribute=value,...;name:...", options.branches);
+  cmd.AddValue ("branchAt", "Simulated second at which the branches are forked", options.branchAt);
+  cmd.AddValue ("branchJobs", "Number of branches run at the same time (0 for one per processor)", options.branchJobs);
+  cmd.AddValue ("gossip", "Decentralized SGD without parameter servers, exchanging models with the neighbors in a ring, torus, expander or rack graph; replaces --placement", options.gossip);
+  cmd.AddValue ("gossipDegree", "Degree of the --gossip=expander graph", options.gossipDegree);
+  cmd.AddValue ("pipeline", "Pipeline-parallel training with the gpipe or 1f1b schedule instead of parameter servers; replaces --placement", options.pipeline);
+  cmd.AddValue ("pipelinePlacement", "Consecutive pipeline stages on hosts of one rack (rack) or of consecutive racks (spread)", options.pipelinePlacement);
+  cmd.AddValue ("pipelineStages", "Number of stages of every pipeline", options.pipelineStages);
+  cmd.AddValue ("microBatches", "Number of micro-batches of a mini-batch", options.microBatches);
+  cmd.AddValue ("stageForwardTimes", "Comma-separated forward pass times of the stages, in seconds; the last one repeats", options.stageForwardTimes);
+  cmd.AddValue ("stageBackwardTimes", "Comma-separated backward pass times of the stages (default twice the forward time)", options.stageBackwardTimes);
+  cmd.AddValue ("activationSizes", "Comma-separated activation sizes in bytes sent by the stages to the next one", options.activationSizes);
+  cmd.AddValue ("jobs", "Trace of training jobs sharing the cluster (arrival servers workers iterations [name] per line), replacing --placement", options.jobs);
+  cmd.AddValue ("schedulerPolicy", "Placement of the jobs of --jobs: packing, spreading or network", options.schedulerPolicy);
+  cmd.AddValue ("outputPrefix", "Prefix of the report files", outputPrefix);
+  cmd.AddValue ("summary", "Write a JSON summary of the run to <outputPrefix>-summary.json", options.summary);
+  cmd.AddValue ("monitorLinks", "Sample per-link load and queue depth and record per-flow statistics", options.monitorLinks);
+  cmd.AddValue ("monitorInterval", "Seconds between two link samples", options.monitorInterval);
+  cmd.AddValue ("monitorTopN", "Number of links listed in the hottest links summary", options.monitorTopN);
+  cmd.AddValue ("criticalPath", "Attribute every iteration to its gating worker and phase", options.criticalPath);
+  cmd.AddValue ("quantiles", "Write per-server and global iteration, push and wait time quantiles and a CDF", options.quantiles);
+  cmd.AddValue ("cdfPoints", "Number of points in the compact CDF", options.cdfPoints);
+  cmd.AddValue ("profile", "Report the event rate, wall time and memory of the simulator itself", options.profile);
+  cmd.AddValue ("profileInterval", "Simulated seconds between two profile reports", options.profileInterval);
+  cmd.AddValue ("telemetry", "Keep a snapshot of the progress in <outputPrefix>-telemetry.json and .csv while running, also written on SIGUSR1", options.telemetry);
+  cmd.AddValue ("telemetryInterval", "Seconds between two telemetry snapshots", options.telemetryInterval);
+  cmd.AddValue ("telemetryClock", "Clock of --telemetryInterval: wall or sim", options.telemetryClock);
+  cmd.AddValue ("trace", "Write a binary event trace to <outputPrefix>-events.bin instead of logging every broadcast", options.trace);
+  cmd.AddValue ("traceBuffer", "Number of trace records buffered in memory", options.traceBuffer);
+  cmd.AddValue ("traceRing", "Only keep the last traceBuffer records of the trace", options.traceRing);
+  cmd.AddValue ("scenario", "File of name = value lines setting any of these flags or attributes; the command line takes precedence", scenario);
+
+  // Scenario arguments go first so that the command line overrides them.
+  std::vector<std::string> args(argv, argv + argc);
+  for (int i = 1; i < argc; i++) {
+      if (args[i].compare(0, 11, "--scenario=") == 0) {
+          std::vector<std::string> scenarioArgs = readScenario(args[i].substr(11));
+          args.insert(args.begin() + 1, scenarioArgs.begin(), scenarioArgs.end());
+          break;
+      }
+  }
+  std::vector<char*> argvs;
+  for (size_t i = 0; i != args.size(); i++) {
+      argvs.push_back(&args[i][0]);
+  }
+  cmd.Parse (argvs.size(), &argvs[0]);
+
+  if (network != "packet" && network != "fluid" && network != "validate") {
+      NS_FATAL_ERROR ("Unknown network " << network);
+  }
+  if (options.monitorLinks && network != "packet") {
+      NS_FATAL_ERROR ("--monitorLinks needs the packet-level network");
+  }
+  if (!options.gossip.empty() && (options.criticalPath || !options.jobs.empty() || !options.pipeline.empty())) {
+      NS_FATAL_ERROR ("--gossip cannot be combined with --criticalPath, --jobs or --pipeline");
+  }
+  if (!options.pipeline.empty()) {
+      if (options.criticalPath || !options.jobs.empty()) {
+          NS_FATAL_ERROR ("--pipeline cannot be combined with --criticalPath or --jobs");
+      }
+      Config::SetDefault ("ns3::PipelineStage::Schedule", StringValue (options.pipeline));
+      Config::SetDefault ("ns3::PipelineStage::NumMicroBatches", UintegerValue (options.microBatches));
+  }
+  if (!options.jobs.empty()) {
+      // These connect to the applications before the jobs install them.
+      if (options.converge || options.criticalPath || options.telemetry || !options.branches.empty()) {
+          NS_FATAL_ERROR ("--jobs cannot be combined with --converge, --criticalPath, --telemetry or --branches");
+      }
+  }
+  if (!options.branches.empty()) {
+      // These write their output while running, which branches would share.
+      if (options.trace || options.monitorLinks || options.criticalPath || options.profile || network == "validate") {
+          NS_FATAL_ERROR ("--branches cannot be combined with --trace, --monitorLinks, --criticalPath, --profile or --network=validate");
+      }
+      if (options.branchAt >= options.stopTime) {
+          NS_FATAL_ERROR ("--branchAt must be before --stopTime");
+      }
+      if (options.branchJobs == 0) {
+          options.branchJobs = std::max (1L, sysconf (_SC_NPROCESSORS_ONLN));
+      }
+  }
+
+  if (options.telemetry) {
+      if (options.telemetryClock != "wall" && options.telemetryClock != "sim") {
+          NS_FATAL_ERROR ("Unknown telemetry clock " << options.telemetryClock);
+      }
+      if (options.telemetryInterval <= 0) {
+          NS_FATAL_ERROR ("--telemetryInterval must be positive");
+      }
+  }
+  // Telemetry reports the event rate too.
+  if (options.profile || options.telemetry) {
+      SimProfiler::Enable();
+  }
 
   Time::SetResolution (Time::NS);
-  LogComponentEnable ("ParameterClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable ("ParameterServerApplication", LOG_LEVEL_INFO);
+  if (!options.trace) {
+      LogComponentEnable ("ParameterClientApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("ParameterServerApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("GossipWorkerApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("PipelineStageApplication", LOG_LEVEL_INFO);
+  }
+
+  if (options.updateSize != 0) {
+      Config::SetDefault ("ns3::ParameterServer::ParameterUpdateSize", UintegerValue (options.updateSize));
+      Config::SetDefault ("ns3::ParameterServer::GradientUpdateSize", UintegerValue (options.updateSize));
+      Config::SetDefault ("ns3::ParameterClient::ParameterUpdateSize", UintegerValue (options.updateSize));
+      Config::SetDefault ("ns3::ParameterClient::GradientUpdateSize", UintegerValue (options.updateSize));
+      Config::SetDefault ("ns3::GossipWorker::ModelSize", UintegerValue (options.updateSize));
+  }
+
+  if (options.localSteps == 0) {
+      NS_FATAL_ERROR ("--localSteps must be at least 1");
+  }
+  if (flagGiven(args, "localSteps")) {
+      Config::SetDefault ("ns3::ParameterClient::LocalSteps", UintegerValue (options.localSteps));
+  }
+  if (flagGiven(args, "adaptiveLocalSteps")) {
+      Config::SetDefault ("ns3::ParameterClient::AdaptiveLocalSteps", BooleanValue (options.adaptiveLocalSteps));
+  }
+
+  if (options.pacing != "none" && options.pacing != "rate" && options.pacing != "slots" && options.pacing != "credit") {
+      NS_FATAL_ERROR ("Unknown pacing " << options.pacing);
+  }
+  if ((options.pacing == "rate" || options.pacing == "credit") && network != "packet") {
+      NS_FATAL_ERROR ("--pacing=" << options.pacing << " needs the packet-level network");
+  }
+  if (flagGiven(args, "pacing")) {
+      Config::SetDefault ("ns3::ParameterClient::Pacing", StringValue (options.pacing));
+  }
+  if (!pacingRate.empty()) {
+      Config::SetDefault ("ns3::ParameterClient::PacingRate", DataRateValue (DataRate (pacingRate)));
+  }
+  if (slotDuration > 0) {
+      Config::SetDefault ("ns3::ParameterClient::SlotDuration", TimeValue (Seconds (slotDuration)));
+  }
+  if (options.pacing == "credit") {
+      Config::SetDefault ("ns3::ParameterServer::CreditWindow", UintegerValue (options.creditWindow));
+  }
+  // A file may give a rack several uplinks, which only add capacity if
+  // routing spreads the traffic over all equal-cost paths.
+  if (!options.topology.empty()) {
+      Config::SetDefault ("ns3::Ipv4GlobalRouting::RandomEcmpRouting", BooleanValue (true));
+  }
+  if (!queueSize.empty()) {
+      Config::SetDefault ("ns3::DropTailQueue<Packet>::MaxSize", QueueSizeValue (QueueSize (queueSize)));
+      Config::SetDefault ("ns3::CoflowQueue::MaxSize", QueueSizeValue (QueueSize (queueSize)));
+  }
+
+  if (options.coflow != "fair" && options.coflow != "sebf" && options.coflow != "las") {
+      NS_FATAL_ERROR ("Unknown coflow scheduling " << options.coflow);
+  }
+  if (options.coflow != "fair") {
+      // The flow model has no switch queues, and only the parameter
+      // server applications tag their coflows.
+      if (network != "packet") {
+          NS_FATAL_ERROR ("--coflow=" << options.coflow << " needs the packet-level network");
+      }
+      if (!options.jobs.empty() || !options.gossip.empty() || !options.pipeline.empty()) {
+          NS_FATAL_ERROR ("--coflow cannot be combined with --jobs, --gossip or --pipeline");
+      }
+  }
+  if (options.timeToAccuracy && (!options.jobs.empty() || !options.gossip.empty() || !options.pipeline.empty())) {
+      NS_FATAL_ERROR ("--timeToAccuracy cannot be combined with --jobs, --gossip or --pipeline");
+  }
+  if (compareFair && (options.coflow == "fair" || !options.branches.empty())) {
+      NS_FATAL_ERROR ("--compareFair needs --coflow=sebf or las and cannot be combined with --branches");
+  }
 
-  Topology* topology = new Topology(8, 8);
+  if (options.aggregation != "normal" && options.aggregation != "resource" && options.aggregation != "trace") {
+      NS_FATAL_ERROR ("Unknown aggregation " << options.aggregation);
+  }
+  if (flagGiven(args, "aggregation")) {
+      Config::SetDefault ("ns3::ParameterServer::AggregationModel", StringValue (options.aggregation));
+  }
+  if (options.computeModel != "normal" && options.computeModel != "trace") {
+      NS_FATAL_ERROR ("Unknown compute model " << options.computeModel);
+  }
+  // Only ParameterClient workers replay the trace.
+  if (options.computeModel == "trace" && (!options.gossip.empty() || !options.pipeline.empty())) {
+      NS_FATAL_ERROR ("--computeModel=trace cannot be combined with --gossip or --pipeline");
+  }
+  if (flagGiven(args, "computeModel")) {
+      Config::SetDefault ("ns3::ParameterClient::ComputeModel", StringValue (options.computeModel));
+  }
+  if (flagGiven(args, "traceBlock")) {
+      Config::SetDefault ("ns3::ParameterServer::TraceBlock", UintegerValue (options.traceBlock));
+      Config::SetDefault ("ns3::ParameterClient::TraceBlock", UintegerValue (options.traceBlock));
+  }
+  if (flagGiven(args, "aggregationCores")) {
+      Config::SetDefault ("ns3::ParameterServer::AggregationCores", UintegerValue (aggregationCores));
+  }
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  if (options.gpusPerHost == 0) {
+      NS_FATAL_ERROR ("--gpusPerHost must be at least 1");
+  }
+  if (flagGiven(args, "gpusPerHost")) {
+      Config::SetDefault ("ns3::GpuHost::Gpus", UintegerValue (options.gpusPerHost));
+  }
+  if (intraHostBandwidth > 0) {
+      Config::SetDefault ("ns3::GpuHost::IntraHostBandwidth", DoubleValue (intraHostBandwidth));
+  }
 
-  topology->setRandom();
-  //topology->setStride();
-  //topology->setCluster();
-  //topology->setColocate();
+  if (!options.rescale.empty()) {
+      // Other placements do not install ParameterClient workers at fixed hosts.
+      if (!options.jobs.empty() || !options.gossip.empty() || !options.pipeline.empty() || options.criticalPath) {
+          NS_FATAL_ERROR ("--rescale cannot be combined with --jobs, --gossip, --pipeline or --criticalPath");
+      }
+      Config::SetDefault ("ns3::ParameterServer::Elastic", BooleanValue (true));
+  }
+  if (failureTimeout > 0) {
+      Config::SetDefault ("ns3::ParameterServer::FailureTimeout", TimeValue (Seconds (failureTimeout)));
+  }
+  if (joinTransferSize != 0) {
+      Config::SetDefault ("ns3::ParameterServer::JoinTransferSize", UintegerValue (joinTransferSize));
+      Config::SetDefault ("ns3::ParameterClient::JoinTransferSize", UintegerValue (joinTransferSize));
+  }
 
+  // One MTU end to end: devices, TCP segments and application writes.
+  if (options.mtu != 0) {
+      if (options.mtu < 576) {
+          NS_FATAL_ERROR ("--mtu must be at least 576");
+      }
+      Config::SetDefault ("ns3::CsmaNetDevice::Mtu", UintegerValue (options.mtu));
+      Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (options.mtu - 40));
+      Config::SetDefault ("ns3::ParameterServer::MTU", UintegerValue (options.mtu));
+      Config::SetDefault ("ns3::ParameterClient::MTU", UintegerValue (options.mtu));
+      Config::SetDefault ("ns3::GossipWorker::MTU", UintegerValue (options.mtu));
+      Config::SetDefault ("ns3::PipelineStage::MTU", UintegerValue (options.mtu));
+      Config::SetDefault ("ns3::HostCost::SegmentSize", UintegerValue (options.mtu - 40));
+      // The flow model's efficiency was fitted at 1500 bytes; scale it with
+      // the share of payload in a frame.
+      double payloadShare = (options.mtu - 40.0) / (options.mtu + 38.0);
+      Config::SetDefault ("ns3::FluidNetwork::Efficiency", DoubleValue (std::min (1.0, 0.84 * payloadShare / (1460.0 / 1538.0))));
+  }
+  if (flagGiven(args, "packetCost")) {
+      Config::SetDefault ("ns3::HostCost::PacketCost", TimeValue (Seconds (packetCost)));
+  }
+  if (flagGiven(args, "tso")) {
+      Config::SetDefault ("ns3::HostCost::Tso", BooleanValue (tso));
+  }
+  if (flagGiven(args, "gro")) {
+      Config::SetDefault ("ns3::HostCost::Gro", BooleanValue (gro));
+  }
 
-  Simulator::Stop (Seconds(30));
-  Simulator::Run ();
-  Simulator::Destroy ();
+  if (network == "validate") {
+      RunResult packet = runSimulation(options, "packet", outputPrefix + "-packet");
+      RunResult fluid = runSimulation(options, "fluid", outputPrefix + "-fluid");
+      writeValidationReport(packet, fluid, outputPrefix);
+  } else if (compareFair) {
+      RunOptions fairOptions = options;
+      fairOptions.coflow = "fair";
+      RunResult fair = runSimulation(fairOptions, network, outputPrefix + "-fair");
+      RunResult coflow = runSimulation(options, network, outputPrefix + "-" + options.coflow);
+      writeCoflowReport(fair, coflow, options.coflow, outputPrefix);
+  } else {
+      runSimulation(options, network, outputPrefix);
+  }
   return 0;
 }
@@ -0,0 +1,300 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/global-value.h"
+#include "ns3/string.h"
+#include "sim-profiler.h"
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <typeindex>
+#include <sys/resource.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SimProfiler");
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingSimulatorImpl);
+
+uint64_t ProfilingSimulatorImpl::s_events[ProfilingSimulatorImpl::NUM_SOURCES];
+
+/**
+ * Forwards to the wrapped event and counts its execution.  Cancelling
+ * the wrapper prevents the wrapped event from running, which is all the
+ * simulator needs.
+ */
+class CountingEventImpl : public EventImpl
+{
+public:
+  CountingEventImpl (EventImpl *event, uint64_t *counter)
+    : m_event (event),
+      m_counter (counter)
+  {
+  }
+  virtual ~CountingEventImpl ()
+  {
+    m_event->Unref ();
+  }
+
+protected:
+  virtual void Notify (void)
+  {
+    (*m_counter)++;
+    m_event->Invoke ();
+  }
+
+private:
+  EventImpl *m_event;
+  uint64_t *m_counter;
+};
+
+static ProfilingSimulatorImpl::Source
+Classify (const std::type_info& type)
+{
+  int status = 0;
+  char* demangled = abi::__cxa_demangle (type.name (), 0, 0, &status);
+  std::string name = (status == 0) ? demangled : type.name ();
+  std::free (demangled);
+
+  if (name.find ("Tcp") != std::string::npos)
+    {
+      return ProfilingSimulatorImpl::TCP;
+    }
+  if (name.find ("Bridge") != std::string::npos)
+    {
+      return ProfilingSimulatorImpl::BRIDGE;
+    }
+  if (name.find ("Csma") != std::string::npos)
+    {
+      return ProfilingSimulatorImpl::CSMA;
+    }
+  if (name.find ("Ipv4") != std::string::npos || name.find ("Arp") != std::string::npos)
+    {
+      return ProfilingSimulatorImpl::IP;
+    }
+  if (name.find ("Parameter") != std::string::npos || name.find ("Application") != std::string::npos)
+    {
+      return ProfilingSimulatorImpl::APPLICATION;
+    }
+  return ProfilingSimulatorImpl::OTHER;
+}
+
+TypeId
+ProfilingSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingSimulatorImpl")
+    .SetParent<DefaultSimulatorImpl> ()
+    .SetGroupName ("Core")
+    .AddConstructor<ProfilingSimulatorImpl> ()
+  ;
+  return tid;
+}
+
+ProfilingSimulatorImpl::ProfilingSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+  for (int i = 0; i != NUM_SOURCES; i++)
+    {
+      s_events[i] = 0;
+    }
+}
+
+ProfilingSimulatorImpl::~ProfilingSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+EventImpl*
+ProfilingSimulatorImpl::Wrap (EventImpl *event)
+{
+  static std::map<std::type_index, Source> sources;
+
+  std::type_index type (typeid (*event));
+  std::map<std::type_index, Source>::const_iterator it = sources.find (type);
+  if (it == sources.end ())
+    {
+      it = sources.insert (std::make_pair (type, Classify (typeid (*event)))).first;
+    }
+  return new CountingEventImpl (event, &s_events[it->second]);
+}
+
+EventId
+ProfilingSimulatorImpl::Schedule (const Time &delay, EventImpl *event)
+{
+  return DefaultSimulatorImpl::Schedule (delay, Wrap (event));
+}
+
+void
+ProfilingSimulatorImpl::ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event)
+{
+  DefaultSimulatorImpl::ScheduleWithContext (context, delay, Wrap (event));
+}
+
+EventId
+ProfilingSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return DefaultSimulatorImpl::ScheduleNow (Wrap (event));
+}
+
+uint64_t
+ProfilingSimulatorImpl::GetEventCount (Source source)
+{
+  return s_events[source];
+}
+
+uint64_t
+ProfilingSimulatorImpl::GetEventCount (void)
+{
+  uint64_t total = 0;
+  for (int i = 0; i != NUM_SOURCES; i++)
+    {
+      total += s_events[i];
+    }
+  return total;
+}
+
+const char*
+ProfilingSimulatorImpl::SourceName (Source source)
+{
+  switch (source)
+    {
+    case TCP:
+      return "tcp";
+    case IP:
+      return "ip";
+    case CSMA:
+      return "csma";
+    case BRIDGE:
+      return "bridge";
+    case APPLICATION:
+      return "application";
+    default:
+      return "other";
+    }
+}
+
+SimProfiler::SimProfiler (Time interval, std::string prefix)
+  : m_interval (interval),
+    m_prefix (prefix)
+{
+}
+
+void
+SimProfiler::Enable ()
+{
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::ProfilingSimulatorImpl"));
+}
+
+void
+SimProfiler::Start ()
+{
+  std::string filename = m_prefix + "-profile.csv";
+  m_output.open (filename.c_str ());
+  if (!m_output.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  m_output << "sim_time,wall_time,events";
+  for (int i = 0; i != ProfilingSimulatorImpl::NUM_SOURCES; i++)
+    {
+      m_output << "," << ProfilingSimulatorImpl::SourceName ((ProfilingSimulatorImpl::Source) i);
+    }
+  m_output << ",events_per_wall_second,wall_per_sim_second,peak_rss_kb" << std::endl;
+
+  m_wallStart = std::chrono::steady_clock::now ();
+  m_simStart = Simulator::Now ();
+  m_tickEvent = Simulator::Schedule (m_interval, &SimProfiler::Tick, this);
+}
+
+double
+SimProfiler::GetWallSeconds () const
+{
+  return std::chrono::duration<double> (std::chrono::steady_clock::now () - m_wallStart).count ();
+}
+
+uint64_t
+SimProfiler::GetPeakRss ()
+{
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+  return usage.ru_maxrss;
+}
+
+void
+SimProfiler::WriteLine ()
+{
+  double wall = GetWallSeconds ();
+  double sim = (Simulator::Now () - m_simStart).GetSeconds ();
+  uint64_t events = ProfilingSimulatorImpl::GetEventCount ();
+
+  m_output << Simulator::Now ().GetSeconds () << "," << wall << "," << events;
+  for (int i = 0; i != ProfilingSimulatorImpl::NUM_SOURCES; i++)
+    {
+      m_output << "," << ProfilingSimulatorImpl::GetEventCount ((ProfilingSimulatorImpl::Source) i);
+    }
+  m_output << "," << (wall > 0 ? events / wall : 0.0)
+           << "," << (sim > 0 ? wall / sim : 0.0)
+           << "," << GetPeakRss () << std::endl;
+}
+
+void
+SimProfiler::Tick ()
+{
+  WriteLine ();
+  m_tickEvent = Simulator::Schedule (m_interval, &SimProfiler::Tick, this);
+}
+
+void
+SimProfiler::Report ()
+{
+  Simulator::Cancel (m_tickEvent);
+  WriteLine ();
+  m_output.close ();
+
+  double wall = GetWallSeconds ();
+  double sim = (Simulator::Now () - m_simStart).GetSeconds ();
+  uint64_t events = ProfilingSimulatorImpl::GetEventCount ();
+
+  std::ostringstream os;
+  os << "Simulator profile:" << std::endl
+     << "  events processed: " << events << std::endl
+     << "  wall time: " << wall << "s for " << sim << "s simulated" << std::endl
+     << "  events per wall second: " << (wall > 0 ? events / wall : 0.0) << std::endl
+     << "  wall seconds per simulated second: " << (sim > 0 ? wall / sim : 0.0) << std::endl
+     << "  peak RSS: " << GetPeakRss () << " kB" << std::endl
+     << "  events by source:" << std::endl;
+  for (int i = 0; i != ProfilingSimulatorImpl::NUM_SOURCES; i++)
+    {
+      ProfilingSimulatorImpl::Source source = (ProfilingSimulatorImpl::Source) i;
+      uint64_t count = ProfilingSimulatorImpl::GetEventCount (source);
+      os << "    " << ProfilingSimulatorImpl::SourceName (source) << ": " << count
+         << " (" << (events > 0 ? 100.0 * count / events : 0.0) << "%)" << std::endl;
+    }
+
+  std::string filename = m_prefix + "-profile.txt";
+  std::ofstream summary (filename.c_str ());
+  summary << os.str ();
+  std::cout << os.str ();
+}
+
+} // namespace ns3
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SIM_PROFILER_H
+#define SIM_PROFILER_H
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief The default simulator implementation, counting every event it
+ *        executes by the module that scheduled it.
+ *
+ * Each scheduled event is wrapped in a small counting event, so this
+ * costs one extra allocation per event and is only meant to be selected
+ * when profiling the simulator itself.  The source of an event is
+ * derived once per event type from the demangled name of its class, which
+ * names the object the event is bound to.
+ */
+class ProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  enum Source
+  {
+    TCP,
+    IP,
+    CSMA,
+    BRIDGE,
+    APPLICATION,
+    OTHER,
+    NUM_SOURCES
+  };
+
+  static TypeId GetTypeId (void);
+
+  ProfilingSimulatorImpl ();
+  virtual ~ProfilingSimulatorImpl ();
+
+  virtual EventId Schedule (const Time &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+
+  /**
+   * \param source the source of the events
+   * \return the number of events of that source executed so far
+   */
+  static uint64_t GetEventCount (Source source);
+
+  /**
+   * \return the number of events executed so far
+   */
+  static uint64_t GetEventCount (void);
+
+  static const char* SourceName (Source source);
+
+private:
+  EventImpl* Wrap (EventImpl *event);
+
+  static uint64_t s_events[NUM_SOURCES];
+};
+
+/**
+ * \brief Periodically reports what the simulation costs to run.
+ *
+ * Every interval of simulated time a line with the events executed,
+ * the events per wall-clock second, the wall-clock time per simulated
+ * second and the peak resident set size is appended to
+ * "<prefix>-profile.csv".  Report () prints the totals and the event
+ * breakdown by source at exit.
+ *
+ * Requires ProfilingSimulatorImpl to be the simulator implementation;
+ * Enable () selects it and must run before anything is scheduled.
+ */
+class SimProfiler
+{
+public:
+  SimProfiler (Time interval, std::string prefix);
+
+  /**
+   * Select ProfilingSimulatorImpl as the simulator implementation.
+   */
+  static void Enable ();
+
+  /**
+   * Start the wall clock and schedule the first periodic report.
+   */
+  void Start ();
+
+  /**
+   * Write the final report.  Must be called after Simulator::Run ().
+   */
+  void Report ();
+
+  /**
+   * \return the peak resident set size of the process in kilobytes
+   */
+  static uint64_t GetPeakRss ();
+
+private:
+  void Tick ();
+
+  void WriteLine ();
+
+  double GetWallSeconds () const;
+
+  Time m_interval;
+  std::string m_prefix;
+  std::ofstream m_output;
+  EventId m_tickEvent;
+  std::chrono::steady_clock::time_point m_wallStart;
+  Time m_simStart;
+};
+
+} // namespace ns3
+
+#endif /* SIM_PROFILER_H */
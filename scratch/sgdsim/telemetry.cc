@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/callback.h"
+#include "sim-profiler.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Telemetry");
+
+volatile std::sig_atomic_t Telemetry::s_dumpRequested = 0;
+
+Telemetry::Telemetry (Time interval, bool wallClock, Time stopTime, std::string prefix)
+  : m_interval (interval),
+    m_wallClock (wallClock),
+    m_stopTime (stopTime),
+    m_prefix (prefix),
+    m_eventsStart (0),
+    m_polls (0),
+    m_lastWall (0.0)
+{
+}
+
+void
+Telemetry::HandleSignal (int number)
+{
+  s_dumpRequested = 1;
+}
+
+void
+Telemetry::Start ()
+{
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::ParameterServer/Broadcast",
+                                 MakeCallback (&Telemetry::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::GossipWorker/Iteration",
+                                 MakeCallback (&Telemetry::Broadcast, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PipelineStage/Iteration",
+                                 MakeCallback (&Telemetry::Broadcast, this));
+
+  std::string filename = m_prefix + "-telemetry.csv";
+  m_csv.open (filename.c_str ());
+  if (!m_csv.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open " << filename);
+    }
+  m_csv << "sim_time,wall_time,iterations,p50_iteration_time,p90_iteration_time,p99_iteration_time,"
+        << "events,events_per_wall_second,eta" << std::endl;
+
+  // The handler stays installed, a late signal only sets the flag.
+  std::signal (SIGUSR1, &Telemetry::HandleSignal);
+  s_dumpRequested = 0;
+
+  m_wallStart = std::chrono::steady_clock::now ();
+  m_simStart = Simulator::Now ();
+  m_lastSim = m_simStart;
+  m_eventsStart = ProfilingSimulatorImpl::GetEventCount ();
+  m_polls = 0;
+  SchedulePoll ();
+}
+
+void
+Telemetry::SchedulePoll ()
+{
+  Time delay = MilliSeconds (POLL);
+  if (!m_wallClock)
+    {
+      delay = std::min (delay, m_lastSim + m_interval - Simulator::Now ());
+    }
+  m_pollEvent = Simulator::Schedule (delay, &Telemetry::Poll, this);
+}
+
+void
+Telemetry::Broadcast (uint32_t serverNum, uint32_t iteration)
+{
+  Time now = Simulator::Now ();
+  std::map<uint32_t, Time>::iterator it = m_lastBroadcast.find (serverNum);
+  if (it != m_lastBroadcast.end ())
+    {
+      m_iterations[serverNum]++;
+      m_recent.push_back ((now - it->second).GetSeconds ());
+      if (m_recent.size () > RECENT)
+        {
+          m_recent.pop_front ();
+        }
+      it->second = now;
+    }
+  else
+    {
+      m_iterations[serverNum] = 0;
+      m_lastBroadcast[serverNum] = now;
+    }
+}
+
+void
+Telemetry::Poll ()
+{
+  m_polls++;
+  double wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - m_wallStart).count ();
+  bool due = m_wallClock ? wall - m_lastWall >= m_interval.GetSeconds ()
+                         : Simulator::Now () - m_lastSim >= m_interval;
+  if (due || s_dumpRequested)
+    {
+      s_dumpRequested = 0;
+      Write ();
+    }
+  SchedulePoll ();
+}
+
+void
+Telemetry::Write ()
+{
+  double wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - m_wallStart).count ();
+  double sim = (Simulator::Now () - m_simStart).GetSeconds ();
+  uint64_t events = ProfilingSimulatorImpl::GetEventCount () - m_eventsStart - m_polls;
+  double eventRate = wall > 0 ? events / wall : 0.0;
+  // Wall-clock time to the stop time at the pace so far.
+  double eta = sim > 0 ? std::max ((m_stopTime - Simulator::Now ()).GetSeconds (), 0.0) * wall / sim : 0.0;
+  m_lastWall = wall;
+  m_lastSim = Simulator::Now ();
+
+  std::vector<double> recent (m_recent.begin (), m_recent.end ());
+  std::sort (recent.begin (), recent.end ());
+  double quantiles[3] = { 0.0, 0.0, 0.0 };
+  double levels[3] = { 0.5, 0.9, 0.99 };
+  for (int i = 0; i != 3 && !recent.empty (); i++)
+    {
+      quantiles[i] = recent[std::min<size_t> (levels[i] * recent.size (), recent.size () - 1)];
+    }
+  uint64_t iterations = 0;
+  for (std::map<uint32_t, uint32_t>::const_iterator it = m_iterations.begin (); it != m_iterations.end (); ++it)
+    {
+      iterations += it->second;
+    }
+
+  m_csv << Simulator::Now ().GetSeconds () << "," << wall << "," << iterations << "," << quantiles[0] << ","
+        << quantiles[1] << "," << quantiles[2] << "," << events << "," << eventRate << "," << eta << std::endl;
+
+  // Readers only ever see a complete snapshot.
+  std::string filename = m_prefix + "-telemetry.json";
+  std::string partial = filename + ".tmp";
+  {
+    std::ofstream json (partial.c_str ());
+    json << "{" << std::endl
+         << "  \"sim_time\": " << Simulator::Now ().GetSeconds () << "," << std::endl
+         << "  \"stop_time\": " << m_stopTime.GetSeconds () << "," << std::endl
+         << "  \"wall_time\": " << wall << "," << std::endl
+         << "  \"iterations\": " << iterations << "," << std::endl
+         << "  \"server_iterations\": {";
+    for (std::map<uint32_t, uint32_t>::const_iterator it = m_iterations.begin (); it != m_iterations.end (); ++it)
+      {
+        json << (it != m_iterations.begin () ? ", " : "") << "\"" << it->first << "\": " << it->second;
+      }
+    json << "}," << std::endl
+         << "  \"recent_iterations\": " << recent.size () << "," << std::endl
+         << "  \"p50_iteration_time\": " << quantiles[0] << "," << std::endl
+         << "  \"p90_iteration_time\": " << quantiles[1] << "," << std::endl
+         << "  \"p99_iteration_time\": " << quantiles[2] << "," << std::endl
+         << "  \"events\": " << events << "," << std::endl
+         << "  \"events_per_wall_second\": " << eventRate << "," << std::endl
+         << "  \"eta\": " << eta << std::endl
+         << "}" << std::endl;
+  }
+  if (std::rename (partial.c_str (), filename.c_str ()) != 0)
+    {
+      NS_LOG_WARN ("Failed to replace " << filename);
+    }
+}
+
+void
+Telemetry::Stop ()
+{
+  Simulator::Cancel (m_pollEvent);
+  Write ();
+  m_csv.close ();
+}
+
+} // namespace ns3
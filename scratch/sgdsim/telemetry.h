@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief Periodically writes a snapshot of the progress of a running
+ *        simulation.
+ *
+ * A snapshot holds the simulated and wall-clock time, the iterations of
+ * every server, the p50, p90 and p99 of their last RECENT iteration
+ * times, the events per wall-clock second and the wall-clock time left
+ * until the stop time at the rate so far.  Each one replaces
+ * "<prefix>-telemetry.json", atomically, and is appended to
+ * "<prefix>-telemetry.csv", so a sweep can watch its runs and kill the
+ * hopeless ones early.
+ *
+ * Snapshots are taken every interval of simulated time, or of wall-clock
+ * time with the wall clock, and whenever the process receives SIGUSR1.
+ * Both are checked by a poll event every POLL of simulated time, and
+ * with simulated time also at every interval boundary.  The event count
+ * comes from ProfilingSimulatorImpl, which has to be the simulator
+ * implementation; the polls themselves are not counted.
+ */
+class Telemetry
+{
+public:
+  /**
+   * \param interval time between two snapshots
+   * \param wallClock whether the interval is wall-clock instead of
+   *                  simulated time
+   * \param stopTime simulated time the run stops at
+   * \param prefix prefix of the output files
+   */
+  Telemetry (Time interval, bool wallClock, Time stopTime, std::string prefix);
+
+  /**
+   * Connect to the Broadcast trace source of all installed
+   * ParameterServer applications, and to the Iteration trace source of
+   * all GossipWorker and PipelineStage applications, each of which
+   * counts as a server, install the SIGUSR1 handler and schedule the
+   * first poll.
+   */
+  void Start ();
+
+  /**
+   * Take the last snapshot and stop polling.  Must be called after
+   * Simulator::Run ().
+   */
+  void Stop ();
+
+private:
+  void Broadcast (uint32_t serverNum, uint32_t iteration);
+
+  void Poll ();
+
+  /// Schedule the next poll.
+  void SchedulePoll ();
+
+  void Write ();
+
+  static void HandleSignal (int number);
+
+  static const uint32_t RECENT = 200;
+
+  static const uint32_t POLL = 10; //!< Milliseconds of simulated time between two polls
+
+  static volatile std::sig_atomic_t s_dumpRequested;
+
+  Time m_interval;
+  bool m_wallClock;
+  Time m_stopTime;
+  std::string m_prefix;
+  std::ofstream m_csv;
+  EventId m_pollEvent;
+
+  std::chrono::steady_clock::time_point m_wallStart;
+  Time m_simStart;
+  uint64_t m_eventsStart;
+  uint64_t m_polls; //!< Poll events run so far
+  double m_lastWall; //!< Wall-clock time of the last snapshot
+  Time m_lastSim; //!< Simulated time of the last snapshot
+
+  std::map<uint32_t, uint32_t> m_iterations; //!< Iterations per server
+  std::map<uint32_t, Time> m_lastBroadcast;
+  std::deque<double> m_recent; //!< Last iteration times of all servers
+};
+
+} // namespace ns3
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,253 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "topology-file.h"
+#include <fstream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TopologyFile");
+
+TopologyFile::TopologyFile (std::string filename)
+{
+  std::ifstream input (filename.c_str ());
+  if (!input.is_open ())
+    {
+      NS_FATAL_ERROR ("Failed to open topology " << filename);
+    }
+
+  std::string line;
+  int number = 0;
+  while (std::getline (input, line))
+    {
+      number++;
+      std::istringstream fields (line.substr (0, line.find ('#')));
+      std::string kind;
+      if (!(fields >> kind))
+        {
+          continue;
+        }
+      if (kind == "node")
+        {
+          Node node;
+          std::string role;
+          if (!(fields >> node.name >> role))
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": expected node <name> <role>");
+            }
+          if (role == "host")
+            {
+              node.role = HOST;
+            }
+          else if (role == "tor")
+            {
+              node.role = TOR;
+            }
+          else if (role == "switch")
+            {
+              node.role = SWITCH;
+            }
+          else
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": unknown role " << role << ", expected host, tor or switch");
+            }
+          if (m_names.count (node.name) > 0)
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": node " << node.name << " declared twice");
+            }
+          m_names[node.name] = m_nodes.size ();
+          m_nodes.push_back (node);
+        }
+      else if (kind == "link")
+        {
+          std::string a, b;
+          if (!(fields >> a >> b))
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": expected link <name> <name> [rate=..] [delay=..] [queue=..]");
+            }
+          Link link;
+          link.a = Find (a, filename, number);
+          link.b = Find (b, filename, number);
+          link.rate = "10Mbps";
+          link.delay = NanoSeconds (15);
+          std::string option;
+          while (fields >> option)
+            {
+              size_t equals = option.find ('=');
+              std::string name = option.substr (0, equals);
+              std::string value = equals == std::string::npos ? "" : option.substr (equals + 1);
+              if (name == "rate" && !value.empty ())
+                {
+                  link.rate = value;
+                }
+              else if (name == "delay" && !value.empty ())
+                {
+                  link.delay = Time (value);
+                }
+              else if (name == "queue" && !value.empty ())
+                {
+                  link.queue = value;
+                }
+              else
+                {
+                  NS_FATAL_ERROR (filename << ":" << number << ": unknown link option " << option);
+                }
+            }
+
+          // Keep the tor first on host links, and the switch first on uplinks.
+          Role ra = m_nodes[link.a].role;
+          Role rb = m_nodes[link.b].role;
+          if (ra == HOST || (ra == TOR && rb == SWITCH))
+            {
+              std::swap (link.a, link.b);
+              std::swap (ra, rb);
+            }
+          if (rb == HOST && ra != TOR)
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": host " << m_nodes[link.b].name << " must link to a tor");
+            }
+          if (ra == TOR && rb == TOR)
+            {
+              NS_FATAL_ERROR (filename << ":" << number << ": tors " << a << " and " << b << " are bridges and cannot be linked");
+            }
+          m_links.push_back (link);
+        }
+      else
+        {
+          NS_FATAL_ERROR (filename << ":" << number << ": expected node or link, got " << kind);
+        }
+    }
+
+  std::vector<uint32_t> links (m_nodes.size (), 0);
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      links[m_links[i].a]++;
+      links[m_links[i].b]++;
+    }
+  for (size_t i = 0; i != m_nodes.size (); i++)
+    {
+      if (m_nodes[i].role == HOST && links[i] != 1)
+        {
+          NS_FATAL_ERROR ("Host " << m_nodes[i].name << " of " << filename << " needs exactly one link");
+        }
+      if (m_nodes[i].role == TOR && GetHostLinks (i).empty ())
+        {
+          NS_FATAL_ERROR ("Tor " << m_nodes[i].name << " of " << filename << " needs hosts");
+        }
+      if (m_nodes[i].role == TOR && GetUplinks (i).empty ())
+        {
+          NS_FATAL_ERROR ("Tor " << m_nodes[i].name << " of " << filename << " needs an uplink to a switch");
+        }
+    }
+
+  // The simulator needs a rack and a switch to route between racks.
+  if (GetTors ().empty ())
+    {
+      NS_FATAL_ERROR ("Topology " << filename << " has no tor");
+    }
+  bool hasSwitch = false;
+  for (size_t i = 0; i != m_nodes.size (); i++)
+    {
+      hasSwitch = hasSwitch || m_nodes[i].role == SWITCH;
+    }
+  if (!hasSwitch)
+    {
+      NS_FATAL_ERROR ("Topology " << filename << " has no switch");
+    }
+}
+
+uint32_t
+TopologyFile::Find (std::string name, std::string filename, int number) const
+{
+  std::map<std::string, uint32_t>::const_iterator it = m_names.find (name);
+  if (it == m_names.end ())
+    {
+      NS_FATAL_ERROR (filename << ":" << number << ": unknown node " << name);
+    }
+  return it->second;
+}
+
+const std::vector<TopologyFile::Node>&
+TopologyFile::GetNodes (void) const
+{
+  return m_nodes;
+}
+
+const std::vector<TopologyFile::Link>&
+TopologyFile::GetLinks (void) const
+{
+  return m_links;
+}
+
+std::vector<uint32_t>
+TopologyFile::GetTors (void) const
+{
+  std::vector<uint32_t> tors;
+  for (size_t i = 0; i != m_nodes.size (); i++)
+    {
+      if (m_nodes[i].role == TOR)
+        {
+          tors.push_back (i);
+        }
+    }
+  return tors;
+}
+
+std::vector<uint32_t>
+TopologyFile::GetHostLinks (uint32_t tor) const
+{
+  std::vector<uint32_t> links;
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      if (m_links[i].a == tor && m_nodes[m_links[i].b].role == HOST)
+        {
+          links.push_back (i);
+        }
+    }
+  return links;
+}
+
+std::vector<uint32_t>
+TopologyFile::GetUplinks (uint32_t tor) const
+{
+  std::vector<uint32_t> links;
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      if (m_links[i].b == tor && m_nodes[m_links[i].a].role == SWITCH)
+        {
+          links.push_back (i);
+        }
+    }
+  return links;
+}
+
+std::vector<uint32_t>
+TopologyFile::GetCoreLinks (void) const
+{
+  std::vector<uint32_t> links;
+  for (size_t i = 0; i != m_links.size (); i++)
+    {
+      if (m_nodes[m_links[i].a].role == SWITCH && m_nodes[m_links[i].b].role == SWITCH)
+        {
+          links.push_back (i);
+        }
+    }
+  return links;
+}
+
+} // namespace ns3
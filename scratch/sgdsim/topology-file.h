@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TOPOLOGY_FILE_H
+#define TOPOLOGY_FILE_H
+
+#include "ns3/nstime.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Description of a cluster fabric read from a file.
+ *
+ * Lines are either "node <name> <role>", with the role host, tor or
+ * switch, or "link <name> <name> [rate=<rate>] [delay=<delay>]
+ * [queue=<size>]", e.g. "link r0h0 r0 rate=10Mbps delay=15ns queue=100p";
+ * '#' starts a comment.  Links default to the rate and delay of the
+ * generated topologies, and to the default device queue size.
+ *
+ * The fabric has to fit the rack abstraction of the simulator: every
+ * host has a single link, to its top of rack, the tor nodes are bridges
+ * with one or more uplinks to switches, and switches are routers linked
+ * to tors and to each other, e.g. across pods.  Tors are not linked to
+ * each other, since bridges would loop.  There has to be at least one
+ * tor and one switch.  Racks are numbered in the order of their tor
+ * nodes, and the hosts of a rack in the order of their links.
+ */
+class TopologyFile
+{
+public:
+  enum Role
+  {
+    HOST,
+    TOR,
+    SWITCH
+  };
+
+  struct Node
+  {
+    std::string name;
+    Role role;
+  };
+
+  struct Link
+  {
+    uint32_t a; //!< Index of a node
+    uint32_t b; //!< Index of a node
+    std::string rate;
+    Time delay;
+    std::string queue; //!< Queue size, empty for the default
+  };
+
+  /**
+   * Read and check a description, failing on any error.
+   */
+  explicit TopologyFile (std::string filename);
+
+  const std::vector<Node>& GetNodes (void) const;
+  const std::vector<Link>& GetLinks (void) const;
+
+  /**
+   * \return the tor nodes, in file order
+   */
+  std::vector<uint32_t> GetTors (void) const;
+
+  /**
+   * \return the links from a tor to its hosts, in file order
+   */
+  std::vector<uint32_t> GetHostLinks (uint32_t tor) const;
+
+  /**
+   * \return the links from a tor to switches, in file order
+   */
+  std::vector<uint32_t> GetUplinks (uint32_t tor) const;
+
+  /**
+   * \return the links between two switches, in file order
+   */
+  std::vector<uint32_t> GetCoreLinks (void) const;
+
+private:
+  uint32_t Find (std::string name, std::string filename, int number) const;
+
+  std::vector<Node> m_nodes;
+  std::vector<Link> m_links;
+  std::map<std::string, uint32_t> m_names;
+};
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_FILE_H */
@@ -0,0 +1,206 @@
+# -*- coding: utf-8 -*-
+"""Validation of sgdsim against the recorded runs in norm*/.
+
+Every norm<a>-<b>/ directory holds the logs of an 8x8 cluster run with
+the colocate, cluster, stride and random placements (the latter with
+RngRun 1 to 10), with the mean of the normally distributed compute time
+divided by a and its standard deviation by b (norm1 is norm1-1, and the
+attribute defaults are norm4-4); aggregation times are the defaults.
+This script replays each scenario with the same seeds, pools the
+iteration times of all servers (and, for random, all runs), and compares the distribution against the reference with the
+two-sample Kolmogorov-Smirnov statistic and the relative error of the
+mean and the p50, p90 and p99.
+
+  python3 validate.py --ns3-dir ~/ns-3.29
+  python3 validate.py --binary ./sgdsim --cases 'norm1-4/.*' --jobs 8
+  python3 validate.py --reference-only
+
+It exits with status 1 if any scenario drifts beyond --max-ks or
+--max-quantile-error, so changes to the performance model cannot
+silently change its predictions.
+"""
+
+import argparse
+import bisect
+import json
+import multiprocessing
+import multiprocessing.pool
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, os.pardir)
+sys.path.insert(0, os.path.join(ROOT, 'benchmark'))
+sys.path.insert(0, os.path.join(ROOT, 'plotter'))
+
+from run_benchmark import run_sgdsim
+import decode_trace
+
+# Compute time of the recorded model before the divisors of norm<a>-<b>.
+COMPUTE_TIME_MEAN = 0.6383
+COMPUTE_TIME_STDDEV = 0.2673
+
+BROADCAST = re.compile(r'^(?P<time>[0-9]+(?:\.[0-9]+)?):\s+Server #(?P<server>[0-9]+) broadcasts parameter update$',
+                       re.MULTILINE)
+REFERENCE = re.compile(r'^(?P<placement>[a-z]+)_norm(?P<run>[0-9]*)_[0-9]+_[0-9]+\.out$')
+QUANTILES = [0.5, 0.9, 0.99]
+
+
+def iteration_times(broadcasts):
+  """Time between consecutive broadcasts of every server, pooled."""
+  by_server = {}
+  for server, time in broadcasts:
+    by_server.setdefault(server, []).append(time)
+  samples = []
+  for times in by_server.values():
+    times.sort()
+    samples.extend(b - a for a, b in zip(times, times[1:]))
+  return samples
+
+
+def read_reference(fname):
+  with open(fname) as f:
+    return [(int(m.group('server')), float(m.group('time'))) for m in BROADCAST.finditer(f.read())]
+
+
+def read_trace(prefix):
+  broadcasts = []
+  for record in decode_trace.read_records(prefix + '-events.bin'):
+    time, server, _, event = decode_trace.decode(record)[:4]
+    if event == 'server_broadcast':
+      broadcasts.append((server, time))
+  return broadcasts
+
+
+def find_cases(pattern):
+  """{case: {'divisors': (a, b), 'placement': p, 'runs': {RngRun: reference file}}}"""
+  cases = {}
+  for directory in sorted(os.listdir(ROOT)):
+    m = re.match(r'^norm([0-9]+)(?:-([0-9]+))?$', directory)
+    if not m or not os.path.isdir(os.path.join(ROOT, directory)):
+      continue
+    divisors = (float(m.group(1)), float(m.group(2) or 1))
+    for fname in sorted(os.listdir(os.path.join(ROOT, directory))):
+      r = REFERENCE.match(fname)
+      if not r:
+        continue
+      case = '%s/%s' % (directory, r.group('placement'))
+      if pattern and not re.match(pattern, case):
+        continue
+      entry = cases.setdefault(case, {'divisors': divisors, 'placement': r.group('placement'), 'runs': {}})
+      entry['runs'][int(r.group('run') or 1)] = os.path.join(ROOT, directory, fname)
+  return cases
+
+
+def quantile(sorted_samples, q):
+  if not sorted_samples:
+    return 0.0
+  return sorted_samples[min(len(sorted_samples) - 1, int(q * len(sorted_samples)))]
+
+
+def ks_statistic(a, b):
+  """Largest distance between the empirical CDFs of two sorted samples."""
+  if not a or not b:
+    return 1.0
+  distance = 0.0
+  for x in a + b:
+    distance = max(distance, abs(bisect.bisect_right(a, x) / float(len(a)) - bisect.bisect_right(b, x) / float(len(b))))
+  return distance
+
+
+def summarize(samples):
+  samples = sorted(samples)
+  stats = {'count': len(samples), 'mean': sum(samples) / len(samples) if samples else 0.0}
+  for q in QUANTILES:
+    stats['p%g' % (100 * q)] = quantile(samples, q)
+  return stats
+
+
+def compare(simulated, reference):
+  simulated, reference = sorted(simulated), sorted(reference)
+  sim, ref = summarize(simulated), summarize(reference)
+  errors = {}
+  for key in ['mean'] + ['p%g' % (100 * q) for q in QUANTILES]:
+    errors[key] = sim[key] / ref[key] - 1.0 if ref[key] else 0.0
+  return {'ks': ks_statistic(simulated, reference), 'errors': errors, 'simulated': sim, 'reference': ref}
+
+
+def simulate(args, case, entry, run):
+  sim_args = [
+    '--numRacks=8',
+    '--rackSize=8',
+    '--placement=%s' % entry['placement'],
+    '--stopTime=%g' % args.stop_time,
+    '--RngRun=%d' % run,
+    '--trace=true',
+    '--ns3::ParameterClient::ComputeTimeMean=%g' % (COMPUTE_TIME_MEAN / entry['divisors'][0]),
+    '--ns3::ParameterClient::ComputeTimeStdDev=%g' % (COMPUTE_TIME_STDDEV / entry['divisors'][1]),
+  ]
+  _, broadcasts = run_sgdsim(sim_args, args.binary, args.ns3_dir, '%s run %d' % (case, run), collect=read_trace)
+  return case, run, broadcasts
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--ns3-dir', default='.', help='top of the ns-3 tree (runs through ./waf)')
+  parser.add_argument('--binary', help='run this sgdsim binary directly instead of through waf')
+  parser.add_argument('--cases', help='only validate cases (e.g. norm1-4/random) matching this regular expression')
+  parser.add_argument('--stop-time', type=float, default=30.0, help='simulated seconds per run, as recorded')
+  parser.add_argument('--jobs', type=int, default=multiprocessing.cpu_count(), help='runs at the same time')
+  parser.add_argument('--max-ks', type=float, default=0.15, help='largest accepted KS statistic')
+  parser.add_argument('--max-quantile-error', type=float, default=0.15,
+                      help='largest accepted relative error of the mean, p50, p90 and p99')
+  parser.add_argument('--reference-only', action='store_true', help='only print the reference distributions')
+  parser.add_argument('--output', help='write the comparison of every case to this JSON file')
+  args = parser.parse_args()
+
+  cases = find_cases(args.cases)
+  if not cases:
+    print('no reference runs found')
+    return 1
+  references = {}
+  for case, entry in cases.items():
+    references[case] = []
+    for run in sorted(entry['runs']):
+      references[case].extend(iteration_times(read_reference(entry['runs'][run])))
+
+  if args.reference_only:
+    for case in sorted(cases):
+      print('%s: %s' % (case, json.dumps(summarize(references[case]), sort_keys=True)))
+    return 0
+
+  simulated = dict((case, []) for case in cases)
+  tasks = [(case, entry, run) for case, entry in sorted(cases.items()) for run in sorted(entry['runs'])]
+  pool = multiprocessing.pool.ThreadPool(max(1, args.jobs))
+  try:
+    for case, run, broadcasts in pool.imap_unordered(lambda task: simulate(args, *task), tasks):
+      simulated[case].extend(iteration_times(broadcasts))
+  finally:
+    pool.close()
+
+  failures = 0
+  results = {}
+  for case in sorted(cases):
+    result = compare(simulated[case], references[case])
+    results[case] = result
+    notes = []
+    if result['ks'] > args.max_ks:
+      notes.append('KS %.3f > %g' % (result['ks'], args.max_ks))
+    for key, error in sorted(result['errors'].items()):
+      if abs(error) > args.max_quantile_error:
+        notes.append('%s off by %+.1f%%' % (key, 100 * error))
+    failures += 1 if notes else 0
+    print('%s: KS %.3f, mean %+.1f%%, p50 %+.1f%%, p90 %+.1f%%, p99 %+.1f%%: %s' % (
+      case, result['ks'], 100 * result['errors']['mean'], 100 * result['errors']['p50'],
+      100 * result['errors']['p90'], 100 * result['errors']['p99'], '; '.join(notes) if notes else 'ok'))
+
+  if args.output:
+    with open(args.output, 'w') as f:
+      json.dump(results, f, indent=2, sort_keys=True)
+  print('%d of %d case(s) drifted' % (failures, len(cases)))
+  return 1 if failures else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())